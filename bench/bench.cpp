@@ -0,0 +1,12 @@
+// bench.cpp - benchmarks run during static initialization like the tests
+#include <fstream>
+#include "bench.h"
+
+// bench [results.json]
+int main(int argc, char** argv)
+{
+	std::ofstream os(argc > 1 ? argv[1] : "bench.json");
+	bench::write_json(os);
+
+	return os ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+// bench.h - minimal benchmark harness
+#pragma once
+#include <intrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+	using clock = std::chrono::steady_clock;
+
+	// summary of one benchmark, times are per operation
+	struct result {
+		std::string name;
+		size_t n;     // operations per repetition
+		size_t reps;
+		double mean, stddev, min, median; // nanoseconds
+		double cycles; // median TSC cycles
+	};
+	// every result, written as JSON by main
+	inline std::vector<result>& results()
+	{
+		static std::vector<result> r;
+
+		return r;
+	}
+	// s as a JSON string literal
+	inline std::string json_string(const std::string& s)
+	{
+		std::string out = "\"";
+		for (char c : s) {
+			switch (c) {
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					char u[8];
+					snprintf(u, sizeof(u), "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(c)));
+					out += u;
+				}
+				else {
+					out += c;
+				}
+			}
+		}
+		out += '"';
+
+		return out;
+	}
+	inline void write_json(std::ostream& os)
+	{
+		os << "[";
+		for (size_t i = 0; i < results().size(); ++i) {
+			const result& r = results()[i];
+			os << (i ? ",\n" : "\n")
+				<< "{\"name\":" << json_string(r.name) << ",\"n\":" << r.n << ",\"reps\":" << r.reps
+				<< ",\"mean_ns\":" << r.mean << ",\"stddev_ns\":" << r.stddev
+				<< ",\"min_ns\":" << r.min << ",\"median_ns\":" << r.median
+				<< ",\"cycles\":" << r.cycles << "}";
+		}
+		os << "\n]\n";
+	}
+
+	// Keep the optimizer from discarding a result.
+	template<class T>
+	inline void keep(const T& t)
+	{
+		static volatile T sink;
+		sink = t;
+	}
+
+	/// Time f() doing n operations and report nanoseconds per operation.
+	template<class F>
+	inline double measure(const char* name, size_t n, F f)
+	{
+		auto t0 = clock::now();
+		uint64_t c0 = __rdtsc();
+		f();
+		uint64_t c1 = __rdtsc();
+		auto t1 = clock::now();
+		double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / static_cast<double>(n);
+		double cycles = static_cast<double>(c1 - c0) / static_cast<double>(n);
+
+		printf("%-40s %12zu ops %10.2f ns/op\n", name, n, ns);
+		results().push_back(result{ name, n, 1, ns, 0, ns, ns, cycles });
+
+		return ns;
+	}
+
+	/// <summary>
+	/// Run f() doing n operations warmup times untimed then reps times timed.
+	/// </summary>
+	/// <returns>median nanoseconds per operation</returns>
+	/// Prints the median, spread, and TSC cycles per operation and keeps the result for JSON output.
+	template<class F>
+	inline double run(const char* name, size_t n, F f, size_t warmup = 2, size_t reps = 10)
+	{
+		std::vector<double> ns, cycles;
+
+		for (size_t i = 0; i < warmup; ++i) {
+			f();
+		}
+		for (size_t i = 0; i < reps; ++i) {
+			auto t0 = clock::now();
+			uint64_t c0 = __rdtsc();
+			f();
+			uint64_t c1 = __rdtsc();
+			auto t1 = clock::now();
+			ns.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count() / static_cast<double>(n));
+			cycles.push_back(static_cast<double>(c1 - c0) / static_cast<double>(n));
+		}
+
+		result r{ name, n, reps, 0, 0, 0, 0, 0 };
+		for (double x : ns) {
+			r.mean += x;
+		}
+		r.mean /= static_cast<double>(reps);
+		for (double x : ns) {
+			r.stddev += (x - r.mean) * (x - r.mean);
+		}
+		r.stddev = reps > 1 ? std::sqrt(r.stddev / static_cast<double>(reps - 1)) : 0;
+		std::sort(ns.begin(), ns.end());
+		std::sort(cycles.begin(), cycles.end());
+		r.min = ns.front();
+		r.median = ns[reps / 2];
+		r.cycles = cycles[reps / 2];
+
+		printf("%-40s %12zu ops %10.2f ns/op %8.2f%% sd %10.2f min %10.1f cycles/op\n",
+			name, n, r.median, r.mean > 0 ? 100 * r.stddev / r.mean : 0, r.min, r.cycles);
+		results().push_back(r);
+
+		return r.median;
+	}
+
+	// sample at quantile q of sorted samples
+	inline double quantile(const std::vector<double>& sorted, double q)
+	{
+		if (sorted.empty()) {
+			return 0;
+		}
+
+		return sorted[static_cast<size_t>(q * static_cast<double>(sorted.size() - 1))];
+	}
+
+	/// Report median and tail of latency samples in nanoseconds.
+	inline void report(const char* name, std::vector<double>& ns)
+	{
+		std::sort(ns.begin(), ns.end());
+		printf("%-40s %12zu ops %10.0f p50 %10.0f p99 %10.0f p99.9 %10.0f max ns\n", name, ns.size(),
+			quantile(ns, 0.5), quantile(ns, 0.99), quantile(ns, 0.999), ns.empty() ? 0 : ns.back());
+	}
+
+}
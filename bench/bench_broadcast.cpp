@@ -0,0 +1,75 @@
+// bench_broadcast.cpp - fan out to 10k loopback subscribers
+#include <memory>
+#include <vector>
+#include "bench.h"
+#include "../winsock_broadcast.h"
+#include "../winsock_write.h"
+
+using namespace winsock;
+
+int bench_broadcast(size_t subscribers = 10'000, size_t n = 100)
+{
+	tcp::server::socket<> srv("localhost", "6818");
+	srv.listen();
+	std::vector<std::unique_ptr<tcp::client::socket<>>> clis;
+	std::vector<winsock::socket<>> subs;
+	for (size_t i = 0; i < subscribers; ++i) {
+		clis.push_back(std::make_unique<tcp::client::socket<>>("localhost", "6818"));
+		subs.push_back(srv.accept());
+		subs.back().nonblocking();
+	}
+
+	char msg[64] = {};
+	const int len = static_cast<int>(sizeof(msg));
+	std::vector<char> buf(n * len);
+	// receivers read what was sent so buffers never fill
+	auto drain = [&]() {
+		for (auto& c : clis) {
+			c->recv(buf.data(), static_cast<int>(buf.size()), RCV_MSG::WAITALL);
+		}
+	};
+
+	{
+		// copy into each connection's queue and send per socket
+		std::vector<std::unique_ptr<write_queue>> qs;
+		for (auto& s : subs) {
+			qs.push_back(std::make_unique<write_queue>(s));
+		}
+		bench::measure("write_queue per subscriber", n * subscribers, [&]() {
+			for (size_t i = 0; i < n; ++i) {
+				for (auto& q : qs) {
+					q->write(msg, len);
+					q->flush();
+				}
+			}
+		});
+		drain();
+	}
+	{
+		broadcast b;
+		for (auto& s : subs) {
+			b.subscribe(s);
+		}
+		bench::measure("broadcast", n * subscribers, [&]() {
+			for (size_t i = 0; i < n; ++i) {
+				b.publish(msg, len);
+			}
+		});
+		drain();
+
+		bench::measure("broadcast corked 10 messages", n * subscribers, [&]() {
+			for (size_t i = 0; i < n; i += 10) {
+				b.cork();
+				for (size_t j = 0; j < 10; ++j) {
+					b.publish(msg, len);
+				}
+				b.uncork();
+			}
+		});
+		printf("%-40s sends %zu lagging %zu\n", "broadcast", b.sends, b.lagging());
+		drain();
+	}
+
+	return 0;
+}
+int bench_broadcast_ = bench_broadcast();
@@ -0,0 +1,43 @@
+// bench_buffer.cpp - TLB cost of default and large pages for buffer memory
+#include <cstdint>
+#include "bench.h"
+#include "../winsock_buffer.h"
+
+using namespace winsock;
+
+// random reads spread over the whole region
+double random_reads(const char* name, const map_policy& policy)
+{
+	const DWORD len = 1u << 30;
+	const size_t n = 20'000'000;
+	iobuffer<char> b(len, policy);
+	if (!b.buf) {
+		printf("%-40s mapping failed\n", name);
+
+		return 0;
+	}
+	if (policy.large && !b.large_pages()) {
+		printf("%-40s large pages unavailable, using default pages\n", name);
+	}
+
+	return bench::measure(name, n, [&]() {
+		uint64_t x = 88172645463325252ull, sum = 0;
+		for (size_t i = 0; i < n; ++i) {
+			x ^= x << 13;
+			x ^= x >> 7;
+			x ^= x << 17;
+			sum += b.buf[x & (len - 1)];
+		}
+		bench::keep(sum);
+	});
+}
+
+int bench_buffer()
+{
+	random_reads("iobuffer default pages", map_policy{ .prefault = true });
+	random_reads("iobuffer large pages", map_policy{ .large = true, .prefault = true });
+	random_reads("iobuffer large pages local node", map_policy{ .large = true, .prefault = true, .node = current_node() });
+
+	return 0;
+}
+int bench_buffer_ = bench_buffer();
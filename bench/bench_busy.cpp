@@ -0,0 +1,70 @@
+// bench_busy.cpp - loopback ping-pong latency blocking versus busy poll
+#include <thread>
+#include "bench.h"
+#include "../winsock_socket.h"
+
+using namespace winsock;
+
+template<class Recv>
+void ping_pong(const char* name, const char* port, size_t n, bool nonblocking, Recv recv)
+{
+	tcp::server::socket<> srv("localhost", port);
+	srv.listen();
+	tcp::client::socket<> cli("localhost", port);
+	winsock::socket<> t = srv.accept();
+	const int len = 32;
+
+	cli.tune(tcp::PROFILE::LOW_LATENCY);
+	if (nonblocking) {
+		cli.nonblocking();
+		t.nonblocking();
+	}
+
+	std::thread pong([&]() {
+		char buf[len];
+		for (size_t i = 0; i < n; ++i) {
+			if (len != recv(t, buf, len)) {
+				break;
+			}
+			t.send(buf, len);
+		}
+	});
+
+	char buf[len] = {};
+	std::vector<double> ns;
+	ns.reserve(n);
+	for (size_t i = 0; i < n; ++i) {
+		auto t0 = bench::clock::now();
+		cli.send(buf, len);
+		if (len != recv(cli, buf, len)) {
+			break;
+		}
+		ns.push_back(std::chrono::duration<double, std::nano>(bench::clock::now() - t0).count());
+	}
+	pong.join();
+
+	bench::report(name, ns);
+}
+
+int bench_busy_poll(size_t n = 100'000)
+{
+	ping_pong("ping-pong blocking recv", "6793", n, false, [](const auto& s, char* buf, int len) {
+		return s.recv(buf, len, RCV_MSG::WAITALL);
+	});
+	ping_pong("ping-pong busy poll recv", "6794", n, true, [](const auto& s, char* buf, int len) {
+		// a stream may return part of a message, keep going until all of it is here
+		int got = 0;
+		while (got < len) {
+			int ret = s.recv(buf + got, len - got, busy_poll{ std::chrono::microseconds(200) });
+			if (ret <= 0) {
+				return ret;
+			}
+			got += ret;
+		}
+
+		return got;
+	});
+
+	return 0;
+}
+int bench_busy_poll_ = bench_busy_poll();
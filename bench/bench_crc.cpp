@@ -0,0 +1,45 @@
+// bench_crc.cpp - CRC-32C throughput
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "../winsock_crc.h"
+
+using namespace winsock;
+
+int bench_crc(size_t total = 1 << 30)
+{
+	std::vector<char> data(1 << 20);
+	uint32_t x = 1;
+	for (auto& c : data) {
+		x = x * 1664525 + 1013904223;
+		c = static_cast<char>(x >> 24);
+	}
+
+	printf("%-40s %s\n", "crc32c", crc::hardware() ? "sse4.2 and pclmulqdq" : "portable");
+	for (size_t len : { 64, 1024, 0x10000, 1 << 20 }) {
+		size_t n = total / len;
+		std::string name = "crc32c " + std::to_string(len) + " bytes";
+		double ns = bench::run(name.c_str(), n, [&]() {
+			uint32_t crc = 0;
+			for (size_t i = 0; i < n; ++i) {
+				crc = crc32c(crc, data.data(), len);
+			}
+			bench::keep(crc);
+		}, 1, 5);
+		printf("%-40s %8.2f GB/s\n", name.c_str(), static_cast<double>(len) / ns);
+
+		name = "crc::portable " + std::to_string(len) + " bytes";
+		n /= 8;
+		ns = bench::run(name.c_str(), n, [&]() {
+			uint32_t crc = 0;
+			for (size_t i = 0; i < n; ++i) {
+				crc = crc::portable(crc, data.data(), len);
+			}
+			bench::keep(crc);
+		}, 1, 5);
+		printf("%-40s %8.2f GB/s\n", name.c_str(), static_cast<double>(len) / ns);
+	}
+
+	return 0;
+}
+int bench_crc_ = bench_crc();
@@ -0,0 +1,72 @@
+// bench_http.cpp - wrk style load of the HTTP server on loopback
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "../winsock_http.h"
+
+using namespace winsock;
+
+// connections each keeping depth requests in flight
+static void load(const char* name, size_t n, size_t connections, size_t depth)
+{
+	double ns = bench::measure(name, n, [=]() {
+		std::vector<std::thread> clients;
+		for (size_t c = 0; c < connections; ++c) {
+			clients.emplace_back([=]() {
+				http::client<> cli("localhost", "6808");
+				http::response r;
+				for (size_t i = 0; i < n / connections; i += depth) {
+					for (size_t j = 0; j < depth; ++j) {
+						cli.request("GET", "/health");
+					}
+					cli.flush();
+					for (size_t j = 0; j < depth; ++j) {
+						cli.response(r);
+					}
+				}
+			});
+		}
+		for (auto& t : clients) {
+			t.join();
+		}
+	});
+	printf("%-40s %12.0f requests/s\n", name, 1e9 / ns);
+}
+
+int bench_http(size_t n = 400'000)
+{
+	// parser alone
+	std::string req = "GET /health HTTP/1.1\r\nHost: localhost\r\nUser-Agent: bench\r\nAccept: */*\r\n\r\n";
+	bench::run("http::parse request", n, [&]() {
+		http::request r;
+		for (size_t i = 0; i < n; ++i) {
+			bench::keep(http::parse(req.data(), req.size(), r));
+		}
+	});
+
+	tcp::server::socket<> srv("localhost", "6808");
+	srv.listen();
+	srv.nonblocking();
+	std::atomic<bool> stop = false;
+	std::thread server([&]() {
+		event_loop loop;
+		http::server<> s(loop, srv, [](const http::request&, http::reply& rep) {
+			rep.send(200, "ok");
+		});
+		while (!stop) {
+			loop.run_once(10);
+		}
+	});
+
+	load("http 1 connection depth 1", n / 10, 1, 1);
+	load("http 1 connection depth 16", n, 1, 16);
+	load("http 4 connections depth 16", n, 4, 16);
+
+	stop = true;
+	server.join();
+
+	return 0;
+}
+int bench_http_ = bench_http();
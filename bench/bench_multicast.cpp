@@ -0,0 +1,58 @@
+// bench_multicast.cpp - fan-in of many multicast groups to one socket
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "../winsock_multicast.h"
+
+using namespace winsock;
+
+int bench_multicast(size_t groups = 16, size_t n = 1'000'000)
+{
+	const IN_ADDR lo = inaddr<>::loopback;
+	std::vector<winsock::sockaddr<>> g;
+	for (size_t i = 0; i < groups; ++i) {
+		g.emplace_back(("239.255.1." + std::to_string(i + 1)).c_str(), 6801);
+	}
+
+	udp::multicast::receiver<> r(6801, 8 << 20);
+	for (const auto& sa : g) {
+		r.join(sa.addr(), lo);
+	}
+	r.nonblocking();
+
+	std::atomic<bool> done = false;
+	std::thread feed([&]() {
+		udp::multicast::sender<> s;
+		s.iface(lo);
+		char msg[64] = {};
+		for (size_t i = 0; i < n; ++i) {
+			s.sendto(g[i % groups], msg, sizeof(msg));
+		}
+		done = true;
+	});
+
+	size_t received = 0;
+	char buf[1500];
+	winsock::sockaddr<> from;
+	IN_ADDR group;
+	auto t0 = bench::clock::now();
+	while (true) {
+		if (SOCKET_ERROR != r.recv(buf, sizeof(buf), from, group)) {
+			++received;
+		}
+		else if (done) {
+			break; // loopback delivers during sendto
+		}
+	}
+	auto t1 = bench::clock::now();
+	feed.join();
+
+	double secs = std::chrono::duration<double>(t1 - t0).count();
+	printf("%-40s %12zu groups %12.0f msgs/s %zu of %zu received %lu host drops\n", "multicast fan-in",
+		groups, static_cast<double>(received) / secs, received, n, r.drops());
+
+	return 0;
+}
+int bench_multicast_ = bench_multicast();
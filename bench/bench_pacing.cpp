@@ -0,0 +1,51 @@
+// bench_pacing.cpp - precision of paced udp sends
+#include <string>
+#include <thread>
+#include "bench.h"
+#include "../winsock_pacing.h"
+#include "../winsock_timestamp.h"
+
+using namespace winsock;
+
+int bench_pacing()
+{
+	winsock::sockaddr<> sa(inaddr<>::loopback, 6810);
+	udp::server::socket<> r(sa);
+	sockopt<SET_SO::RCVBUF>(r, 8 << 20);
+	std::thread sink([&r]() {
+		char buf[1500];
+		winsock::sockaddr<> from;
+		while (0 < r.recvfrom(from, buf, sizeof(buf))) {
+			;
+		}
+	});
+
+	udp::client::socket<> s;
+	char msg[1200] = {};
+	const int len = static_cast<int>(sizeof(msg));
+	for (double rate : { 10e6, 100e6, 1e9 }) {
+		const size_t n = static_cast<size_t>(rate / len / 2); // half a second
+		udp::pacer<> p(s, rate, 4 * len);
+		bool shaped = p.shape(sa);
+		timestamp::histogram gaps; // time between sends
+		std::string name = "pacer " + std::to_string(static_cast<int>(rate / 1e6)) + " MB/s";
+		bench::measure(name.c_str(), n, [&]() {
+			uint64_t prev = timestamp::now();
+			for (size_t i = 0; i < n; ++i) {
+				p.sendto(sa, msg, len);
+				uint64_t now = timestamp::now();
+				gaps.add(timestamp::ns(now - prev));
+				prev = now;
+			}
+		});
+		printf("%-40s achieved %.1f MB/s max burst %zu bytes waits %zu\n", name.c_str(), p.achieved() / 1e6, p.max_burst, p.waits);
+		printf("%-40s target gap %.0f ns, qWAVE shaping %s\n", name.c_str(), 1e9 * len / rate, shaped ? "on" : "unavailable");
+		gaps.print("time between sends");
+	}
+
+	s.sendto(sa, msg, 0); // done
+	sink.join();
+
+	return 0;
+}
+int bench_pacing_ = bench_pacing();
@@ -0,0 +1,154 @@
+// bench_primitives.cpp - hot paths of buffers, addresses, queues, and timers
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "../winsock_socket.h"
+#include "../winsock_queue.h"
+#include "../winsock_timer.h"
+#include "../winsock_timestamp.h"
+
+using namespace winsock;
+
+int bench_buffer_chunks()
+{
+	static char data[1 << 20];
+	const size_t mss = 1460;
+	const size_t chunks = (sizeof(data) + mss - 1) / mss;
+	buffer<char> b(data, sizeof(data));
+
+	bench::run("buffer::operator() 1460 byte chunks", chunks, [&]() {
+		int len = 0;
+		while (auto v = b(mss)) {
+			len += v.len;
+		}
+		bench::keep(len);
+	});
+
+	return 0;
+}
+int bench_buffer_chunks_ = bench_buffer_chunks();
+
+int bench_sockaddr(size_t n = 100'000)
+{
+	std::mt19937 rng(0);
+	std::vector<winsock::sockaddr<>> sa;
+	for (size_t i = 0; i < 1024; ++i) {
+		IN_ADDR a;
+		a.S_un.S_addr = rng() & 0x0000FFFF; // collide often
+		sa.emplace_back(a, static_cast<unsigned short>(rng() & 3));
+	}
+	std::vector<winsock::sockaddr<AF::INET6>> sa6(1024);
+
+	bench::run("sockaddr<INET> ==", n, [&]() {
+		size_t eq = 0;
+		for (size_t i = 0; i < n; ++i) {
+			eq += sa[i & 1023] == sa[(i * 7) & 1023];
+		}
+		bench::keep(eq);
+	});
+	bench::run("sockaddr<INET> <=>", n, [&]() {
+		size_t lt = 0;
+		for (size_t i = 0; i < n; ++i) {
+			lt += sa[i & 1023] < sa[(i * 7) & 1023];
+		}
+		bench::keep(lt);
+	});
+	bench::run("sockaddr<INET6> ==", n, [&]() {
+		size_t eq = 0;
+		for (size_t i = 0; i < n; ++i) {
+			eq += sa6[i & 1023] == sa6[(i * 7) & 1023];
+		}
+		bench::keep(eq);
+	});
+	bench::run("sockaddr<INET>::ntop", n / 10, [&]() {
+		size_t len = 0;
+		for (size_t i = 0; i < n / 10; ++i) {
+			len += sa[i & 1023].ntop().size();
+		}
+		bench::keep(len);
+	});
+	bench::run("sockaddr<INET>(\"127.0.0.1\", port)", n / 10, [&]() {
+		unsigned short port = 0;
+		for (size_t i = 0; i < n / 10; ++i) {
+			port += winsock::sockaddr<>("127.0.0.1", static_cast<unsigned short>(i)).port();
+		}
+		bench::keep(port);
+	});
+
+	return 0;
+}
+int bench_sockaddr_ = bench_sockaddr();
+
+int bench_addrinfo(size_t n = 1'000'000)
+{
+	addrinfo<> ai("localhost", "80", addrinfo<>::hints(SOCK::STREAM, IPPROTO::TCP, AI::DEFAULT));
+
+	bench::run("addrinfo_iter traversal", n, [&]() {
+		int len = 0;
+		for (size_t i = 0; i < n; ++i) {
+			for (const auto [addr, alen] : ai) {
+				len += alen;
+			}
+		}
+		bench::keep(len);
+	});
+	bench::run("getaddrinfo localhost", 100, []() {
+		for (size_t i = 0; i < 100; ++i) {
+			addrinfo<> a("localhost", "80", addrinfo<>::hints(SOCK::STREAM, IPPROTO::TCP, AI::DEFAULT));
+			bench::keep(a.addrlen());
+		}
+	}, 1, 5);
+
+	return 0;
+}
+int bench_addrinfo_ = bench_addrinfo();
+
+// fast paths added to the library, single threaded cost
+int bench_fast_paths(size_t n = 1'000'000)
+{
+	spsc_queue<size_t> spsc(1024);
+	bench::run("spsc_queue push and pop", n, [&]() {
+		size_t sum = 0;
+		for (size_t i = 0; i < n; ++i) {
+			spsc.push(i);
+			sum += *spsc.pop();
+		}
+		bench::keep(sum);
+	});
+
+	mpsc_queue<size_t> mpsc(1024);
+	bench::run("mpsc_queue push and pop", n, [&]() {
+		size_t sum = 0;
+		for (size_t i = 0; i < n; ++i) {
+			mpsc.push(i);
+			sum += *mpsc.pop();
+		}
+		bench::keep(sum);
+	});
+
+	timer_wheel w;
+	timer t;
+	bench::run("timer_wheel::schedule and cancel", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			w.schedule(t, static_cast<uint64_t>(i & 0xFFFF));
+			t.cancel();
+		}
+	});
+
+	timestamp::histogram h;
+	bench::run("timestamp::histogram::add", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			h.add(static_cast<uint64_t>(i));
+		}
+	});
+
+	buffer_pool<> pool(64);
+	bench::run("buffer_pool acquire and release", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			pool.release(pool.acquire());
+		}
+	});
+
+	return 0;
+}
+int bench_fast_paths_ = bench_fast_paths();
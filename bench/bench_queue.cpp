@@ -0,0 +1,59 @@
+// bench_queue.cpp - throughput of the queues between threads
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "../winsock_queue.h"
+
+using namespace winsock;
+
+// n items through q from producers threads to this thread
+template<class Q>
+double handoff(const char* name, Q& q, size_t producers, size_t n)
+{
+	size_t each = n / producers;
+	std::vector<std::thread> threads;
+
+	return bench::measure(name, each * producers, [&]() {
+		for (size_t p = 0; p < producers; ++p) {
+			threads.emplace_back([&q, each]() {
+				for (size_t i = 0; i < each; ) {
+					if (q.push(i)) {
+						++i;
+					}
+				}
+			});
+		}
+		size_t sum = 0;
+		for (size_t m = 0; m < each * producers; ) {
+			if (auto i = q.pop()) {
+				sum += *i;
+				++m;
+			}
+		}
+		bench::keep(sum);
+		for (auto& t : threads) {
+			t.join();
+		}
+	});
+}
+
+int bench_queue()
+{
+	const size_t n = 10'000'000;
+	char name[64];
+
+	{
+		spsc_queue<size_t> q(1024);
+		double ns = handoff("spsc 1p1c", q, 1, n);
+		printf("%-40s %12.0f ops/s\n", "spsc 1p1c", 1e9 / ns);
+	}
+	for (size_t p = 1; p <= 8; p *= 2) {
+		mpsc_queue<size_t> q(1024);
+		snprintf(name, sizeof(name), "mpsc %zup1c", p);
+		double ns = handoff(name, q, p, n);
+		printf("%-40s %12.0f ops/s\n", name, 1e9 / ns);
+	}
+
+	return 0;
+}
+int bench_queue_ = bench_queue();
@@ -0,0 +1,94 @@
+// bench_rudp.cpp - one way transfer over reliable udp with loss and over TCP
+#include <cstring>
+#include <thread>
+#include "bench.h"
+#include "../winsock_rudp.h"
+#include "../winsock_timestamp.h"
+
+using namespace winsock;
+
+static const int len = 1000;
+
+// n messages of len bytes on streams, each stamped with its send time
+static void transfer(const char* name, size_t n, uint16_t streams, double loss, std::chrono::microseconds delay)
+{
+	winsock::sockaddr<> sa(inaddr<>::loopback, 6813), sb(inaddr<>::loopback, 6814);
+	udp::server::socket<> ua(sa), ub(sb);
+	ua.nonblocking();
+	ub.nonblocking();
+	sockopt<SET_SO::RCVBUF>(ua, 8 << 20);
+	sockopt<SET_SO::RCVBUF>(ub, 8 << 20);
+
+	event_loop loop;
+	size_t received = 0;
+	timestamp::histogram latency;
+	rudp::options opt;
+	rudp::endpoint<> a(loop, ua, nullptr, opt);
+	rudp::endpoint<> b(loop, ub, [&](const winsock::sockaddr<>&, uint16_t, std::string_view msg) {
+		uint64_t sent;
+		memcpy(&sent, msg.data(), sizeof(sent));
+		latency.add(timestamp::ns(timestamp::now() - sent));
+		++received;
+	}, opt);
+	a.impair().set(loss, delay);
+	b.impair().set(loss, delay, std::chrono::microseconds(0), 2);
+
+	char msg[len] = {};
+	bench::measure(name, n, [&]() {
+		size_t i = 0;
+		while (received < n || !a.idle()) {
+			for (; i < n; ++i) {
+				uint64_t now = timestamp::now();
+				memcpy(msg, &now, sizeof(now));
+				if (!a.send(sb, static_cast<uint16_t>(i % streams), msg, len)) {
+					break;
+				}
+			}
+			loop.run_once(1);
+		}
+	});
+	const rudp::connection* c = a.find(sb);
+	printf("%-40s retransmits %zu timeouts %zu cwnd %zu srtt %lld us\n", name, c->retransmits, c->timeouts, c->cwnd(),
+		static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(c->srtt()).count()));
+	latency.print("send to delivery");
+}
+
+int bench_rudp(size_t n = 50'000)
+{
+	using namespace std::chrono_literals;
+
+	transfer("rudp loopback", n, 1, 0, 0us);
+	transfer("rudp 1% loss 1 ms delay", n / 10, 1, 0.01, 1000us);
+	transfer("rudp 1% loss 1 ms delay 8 streams", n / 10, 8, 0.01, 1000us);
+
+	// the same messages on a TCP stream, loss can only be injected outside the process
+	tcp::server::socket<> srv("localhost", "6815");
+	srv.listen();
+	tcp::client::socket<> cli("localhost", "6815");
+	winsock::socket<> s = srv.accept();
+	timestamp::histogram latency;
+	std::thread sink([&s, &latency, n]() {
+		char buf[len];
+		for (size_t i = 0; i < n; ++i) {
+			if (len != s.recv(buf, len, RCV_MSG::WAITALL)) {
+				break;
+			}
+			uint64_t sent;
+			memcpy(&sent, buf, sizeof(sent));
+			latency.add(timestamp::ns(timestamp::now() - sent));
+		}
+	});
+	char msg[len] = {};
+	bench::measure("TCP loopback", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			uint64_t now = timestamp::now();
+			memcpy(msg, &now, sizeof(now));
+			cli.send(msg, len);
+		}
+		sink.join();
+	});
+	latency.print("send to delivery");
+
+	return 0;
+}
+int bench_rudp_ = bench_rudp();
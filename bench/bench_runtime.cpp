@@ -0,0 +1,78 @@
+// bench_runtime.cpp - echo throughput of the thread per core runtime by core count
+#include <atomic>
+#include <thread>
+#include "bench.h"
+#include "../winsock_runtime.h"
+
+using namespace winsock;
+
+// echo msgs/sec with workers cores and 2 * workers blocking clients
+double echo_throughput(size_t workers, std::chrono::milliseconds duration)
+{
+	tcp::server::socket<> srv("localhost", "6796");
+	srv.listen(SOMAXCONN);
+
+	std::vector<std::vector<winsock::socket<>>> conns(workers);
+	runtime<>::options o;
+	o.workers = workers;
+	runtime<> rt(srv, [&conns](runtime<>::worker& w, winsock::socket<>&& s, const winsock::sockaddr<>&) {
+		::SOCKET h = s;
+		w.loop().add(h, POLLRDNORM, [&w, h](SHORT) {
+			auto buf = w.pool().acquire();
+			int n = ::recv(h, buf.buf, buf.len, 0);
+			if (n > 0) {
+				::send(h, buf.buf, n, 0);
+			}
+			else if (0 == n || WSAEWOULDBLOCK != ::WSAGetLastError()) {
+				w.loop().remove(h);
+			}
+			w.pool().release(buf);
+		});
+		conns[w.index()].push_back(std::move(s));
+	}, o);
+	rt.start();
+
+	std::atomic<bool> done = false;
+	std::atomic<size_t> msgs = 0;
+	std::vector<std::thread> clients;
+	for (size_t i = 0; i < 2 * workers; ++i) {
+		clients.emplace_back([&]() {
+			tcp::client::socket<> s("localhost", "6796");
+			s.tune(tcp::PROFILE::LOW_LATENCY);
+			char buf[64] = {};
+			size_t n = 0;
+			while (!done) {
+				if (64 != s.send(buf, 64) || 64 != s.recv(buf, 64, RCV_MSG::WAITALL)) {
+					break;
+				}
+				++n;
+			}
+			msgs += n;
+		});
+	}
+	std::this_thread::sleep_for(duration);
+	done = true;
+	for (auto& c : clients) {
+		c.join();
+	}
+	rt.stop();
+
+	return static_cast<double>(msgs) * 1000 / static_cast<double>(duration.count());
+}
+
+int bench_runtime()
+{
+	size_t cores = std::max<size_t>(1, std::thread::hardware_concurrency() / 2); // leave room for clients
+	double base = 0;
+
+	for (size_t n = 1; n <= cores; n *= 2) {
+		double rate = echo_throughput(n, std::chrono::milliseconds(2000));
+		if (1 == n) {
+			base = rate;
+		}
+		printf("%-40s %12zu workers %12.0f msgs/s %6.2fx\n", "runtime echo", n, rate, rate / base);
+	}
+
+	return 0;
+}
+int bench_runtime_ = bench_runtime();
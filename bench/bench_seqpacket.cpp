@@ -0,0 +1,103 @@
+// bench_seqpacket.cpp - round trip of messages on seqpacket and framed TCP sockets
+#include <cstdint>
+#include <string>
+#include <thread>
+#include "bench.h"
+#include "../winsock_seqpacket.h"
+
+using namespace winsock;
+
+// length prefixed messages on a TCP stream, what callers write without seqpacket
+static bool send_framed(const tcp::client::socket<>& s, const char* msg, uint32_t len)
+{
+	char buf[4 + 256];
+	memcpy(buf, &len, 4);
+	memcpy(buf + 4, msg, len);
+
+	return static_cast<int>(4 + len) == s.send(buf, 4 + len);
+}
+static int recv_framed(const winsock::socket<>& s, char* buf)
+{
+	uint32_t len;
+	if (4 != s.recv(reinterpret_cast<char*>(&len), 4, RCV_MSG::WAITALL)) {
+		return 0;
+	}
+
+	int n = static_cast<int>(len);
+
+	return n == s.recv(buf, n, RCV_MSG::WAITALL) ? n : 0;
+}
+
+int bench_seqpacket(size_t n = 100'000)
+{
+	char msg[64];
+	memset(msg, 'x', sizeof(msg));
+	const int len = static_cast<int>(sizeof(msg));
+
+	std::string path = temp_path("bench_seqpacket.sock");
+	{
+		sockaddr<AF::UNIX> sa = unix_addr(path.c_str());
+		seqpacket::server::socket<> srv(sa);
+		seqpacket::client::socket<> cli(sa);
+		auto s = srv.accept();
+
+		std::thread echo([&s]() {
+			char buf[256];
+			buffer_view<char> b{ buf, sizeof(buf) };
+			while (0 < s.recv(b)) {
+				s.send(b.buf, b.len);
+				b.len = sizeof(buf);
+			}
+		});
+
+		char buf[256];
+		bench::run(cli.framed() ? "seqpacket AF_UNIX (framed) round trip" : "seqpacket AF_UNIX round trip", n, [&]() {
+			for (size_t i = 0; i < n; ++i) {
+				buffer_view<char> b{ buf, sizeof(buf) };
+				cli.send(msg, len);
+				cli.recv(b);
+			}
+		}, 1, 5);
+
+		::shutdown(cli, SD_SEND);
+		echo.join();
+	}
+	::DeleteFileA(path.c_str());
+
+	{
+		tcp::server::socket<> srv("localhost", "6805");
+		srv.tune(tcp::PROFILE::LOW_LATENCY);
+		srv.listen();
+		tcp::client::socket<> cli("localhost", "6805");
+		cli.tune(tcp::PROFILE::LOW_LATENCY);
+		winsock::socket<> s = srv.accept();
+
+		std::thread echo([&s]() {
+			char buf[256];
+			int m;
+			while (0 < (m = recv_framed(s, buf))) {
+				uint32_t l = static_cast<uint32_t>(m);
+				char out[4 + 256];
+				memcpy(out, &l, 4);
+				memcpy(out + 4, buf, l);
+				s.send(out, 4 + m);
+			}
+		});
+
+		char buf[256];
+		bench::run("framed TCP loopback round trip", n, [&]() {
+			for (size_t i = 0; i < n; ++i) {
+				send_framed(cli, msg, len);
+				uint32_t l;
+				cli.recv(reinterpret_cast<char*>(&l), 4, RCV_MSG::WAITALL);
+				cli.recv(buf, static_cast<int>(l), RCV_MSG::WAITALL);
+			}
+		}, 1, 5);
+
+		::shutdown(cli, SD_SEND);
+		echo.join();
+	}
+
+	return 0;
+}
+int bench_seqpacket_ = bench_seqpacket();
@@ -0,0 +1,77 @@
+// bench_shm.cpp - round trip over shared memory and loopback TCP
+#include <thread>
+#include "bench.h"
+#include "../winsock_shm.h"
+
+using namespace winsock;
+
+// echo len bytes at a time until the peer closes
+template<class S>
+static void echo(S& s, int len)
+{
+	char buf[256];
+	while (len == s.recv(buf, len, RCV_MSG::WAITALL)) {
+		s.send(buf, len);
+	}
+}
+
+int bench_shm(size_t n = 1'000'000)
+{
+	char msg[64] = {};
+	const int len = static_cast<int>(sizeof(msg));
+	char buf[sizeof(msg)];
+
+	{
+		shm::server::socket srv("bench_shm");
+		shm::client::socket cli("bench_shm");
+		std::thread peer([&srv, len]() { echo(srv, len); });
+
+		bench::run("shm round trip 64 bytes", n, [&]() {
+			for (size_t i = 0; i < n; ++i) {
+				cli.send(msg, len);
+				cli.recv(buf, len, RCV_MSG::WAITALL);
+			}
+		}, 1, 5);
+		cli.shutdown();
+		peer.join();
+	}
+
+	{
+		shm::server::socket srv("bench_shm");
+		shm::client::socket cli("bench_shm");
+		srv.spin(busy_poll{ std::chrono::nanoseconds(0) });
+		cli.spin(busy_poll{ std::chrono::nanoseconds(0) });
+		std::thread peer([&srv, len]() { echo(srv, len); });
+
+		bench::run("shm round trip 64 bytes no spinning", n / 20, [&]() {
+			for (size_t i = 0; i < n / 20; ++i) {
+				cli.send(msg, len);
+				cli.recv(buf, len, RCV_MSG::WAITALL);
+			}
+		}, 1, 5);
+		cli.shutdown();
+		peer.join();
+	}
+
+	{
+		tcp::server::socket<> srv("localhost", "6816");
+		srv.tune(tcp::PROFILE::LOW_LATENCY);
+		srv.listen();
+		tcp::client::socket<> cli("localhost", "6816");
+		cli.tune(tcp::PROFILE::LOW_LATENCY);
+		winsock::socket<> s = srv.accept();
+		std::thread peer([&s, len]() { echo(s, len); });
+
+		bench::run("TCP loopback round trip 64 bytes", n / 20, [&]() {
+			for (size_t i = 0; i < n / 20; ++i) {
+				cli.send(msg, len);
+				cli.recv(buf, len, RCV_MSG::WAITALL);
+			}
+		}, 1, 5);
+		::shutdown(cli, SD_SEND);
+		peer.join();
+	}
+
+	return 0;
+}
+int bench_shm_ = bench_shm();
@@ -0,0 +1,67 @@
+// bench_stream.cpp - socket_stream against raw send and recv
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "../winsock_stream.h"
+
+using namespace winsock;
+
+int bench_stream(size_t n = 1'000'000)
+{
+	tcp::server::socket<> srv("localhost", "6799");
+	srv.listen();
+	tcp::client::socket<> cli("localhost", "6799");
+	winsock::socket<> t = srv.accept();
+
+	std::thread sink([&t]() {
+		char buf[0x10000];
+		while (0 < t.recv(buf, sizeof(buf))) {
+			;
+		}
+	});
+
+	char msg[64];
+	memset(msg, 'x', sizeof(msg));
+	const int len = static_cast<int>(sizeof(msg));
+
+	bench::measure("socket::send 64 bytes", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			cli.send(msg, len);
+		}
+	});
+
+	socket_stream os(cli);
+	bench::measure("socket_stream::write 64 bytes", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			os.write(msg, len);
+		}
+		os.flush();
+	});
+	printf("%-40s %12zu writes %zu sends\n", "socket_stream", n, os.streambuf().sends);
+
+	bench::measure("socket_stream << int", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			os << i << ' ';
+		}
+		os.flush();
+	});
+
+	std::vector<char> big(1 << 20, 'x');
+	const size_t m = 1000;
+	bench::measure("socket::send 1MB", m, [&]() {
+		for (size_t i = 0; i < m; ++i) {
+			cli.send(big.data(), static_cast<int>(big.size()));
+		}
+	});
+	bench::measure("socket_stream::write 1MB", m, [&]() {
+		for (size_t i = 0; i < m; ++i) {
+			os.write(big.data(), big.size());
+		}
+	});
+
+	::shutdown(cli, SD_SEND);
+	sink.join();
+
+	return 0;
+}
+int bench_stream_ = bench_stream();
@@ -0,0 +1,47 @@
+// bench_tcpinfo.cpp - cost of TCP_INFO snapshots across many connections
+#include <memory>
+#include <vector>
+#include "bench.h"
+#include "../winsock_tcpinfo.h"
+
+using namespace winsock;
+
+int bench_tcpinfo(size_t connections = 1000, size_t n = 100)
+{
+	tcp::server::socket<> srv("localhost", "6824");
+	srv.listen();
+	std::vector<std::unique_ptr<tcp::client::socket<>>> clis;
+	std::vector<winsock::socket<>> peers;
+	for (size_t i = 0; i < connections; ++i) {
+		clis.push_back(std::make_unique<tcp::client::socket<>>("localhost", "6824"));
+		peers.push_back(srv.accept());
+	}
+
+	tcp_info info;
+	bench::run("tcp::info", n * connections, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			for (auto& c : clis) {
+				bench::keep(c->info(info));
+			}
+		}
+	});
+
+	// the whole set and the slice a 64 connection tick takes
+	tcp::monitor m;
+	for (auto& c : clis) {
+		m.add(*c);
+	}
+	bench::run("monitor::sample all", n * connections, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			bench::keep(m.sample());
+		}
+	});
+	bench::run("monitor::sample 64", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			bench::keep(m.sample(64));
+		}
+	});
+
+	return 0;
+}
+int bench_tcpinfo_ = bench_tcpinfo();
@@ -0,0 +1,56 @@
+// bench_timer.cpp - timer wheel insert, cancel, and expire cost
+#include <memory>
+#include <random>
+#include "bench.h"
+#include "../winsock_timer.h"
+
+using namespace winsock;
+
+int bench_timer_wheel(size_t n = 1'000'000)
+{
+	std::unique_ptr<timer[]> timers(new timer[n]);
+	std::mt19937_64 rng(0);
+	std::unique_ptr<uint64_t[]> when(new uint64_t[n]);
+	size_t fired = 0;
+
+	for (size_t i = 0; i < n; ++i) {
+		when[i] = rng() % 600'000; // 10 minutes of millisecond ticks
+		timers[i].expire = [&fired](timer&) { ++fired; };
+	}
+
+	{
+		timer_wheel w;
+
+		bench::measure("timer_wheel::schedule", n, [&]() {
+			for (size_t i = 0; i < n; ++i) {
+				w.schedule(timers[i], when[i]);
+			}
+		});
+		bench::measure("timer_wheel::schedule (re-arm)", n, [&]() {
+			for (size_t i = 0; i < n; ++i) {
+				w.schedule(timers[i], when[i] + 1000);
+			}
+		});
+		bench::measure("timer::cancel", n, [&]() {
+			for (size_t i = 0; i < n; ++i) {
+				timers[i].cancel();
+			}
+		});
+	}
+	{
+		timer_wheel w;
+
+		for (size_t i = 0; i < n; ++i) {
+			w.schedule(timers[i], when[i]);
+		}
+		bench::measure("timer_wheel::advance (expire)", n, [&]() {
+			for (uint64_t t = 0; t < 600'000; ++t) {
+				w.advance(t);
+			}
+		});
+		bench::keep(fired);
+	}
+
+	return 0;
+}
+int bench_timer_wheel_ = bench_timer_wheel();
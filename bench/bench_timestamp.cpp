@@ -0,0 +1,48 @@
+// bench_timestamp.cpp - kernel to user delay of UDP datagrams on loopback
+#include <thread>
+#include "bench.h"
+#include "../winsock_timestamp.h"
+
+using namespace winsock;
+
+int bench_timestamp(size_t n = 100'000)
+{
+	winsock::sockaddr<> sa(inaddr<>::loopback, 6803);
+	udp::server::socket<> r(sa);
+	if (0 != timestamp::enable(r)) {
+		printf("%-40s SIO_TIMESTAMPING not supported\n", "timestamp");
+
+		return 0;
+	}
+
+	std::thread feed([&sa, n]() {
+		udp::client::socket<> s;
+		char msg[64] = {};
+		for (size_t i = 0; i < n; ++i) {
+			s.sendto(sa, msg, sizeof(msg));
+			std::this_thread::yield();
+		}
+		s.sendto(sa, msg, 0); // done
+	});
+
+	timestamp::histogram h;
+	char buf[1500];
+	winsock::sockaddr<> from;
+	while (true) {
+		buffer_view<char> b{ buf, sizeof(buf) };
+		uint64_t rx;
+		if (0 >= timestamp::recvfrom(r, b, from, rx)) {
+			break;
+		}
+		uint64_t now = timestamp::now();
+		if (rx) {
+			h.add(timestamp::ns(now - rx));
+		}
+	}
+	feed.join();
+
+	h.print("kernel to user delay");
+
+	return 0;
+}
+int bench_timestamp_ = bench_timestamp();
@@ -0,0 +1,24 @@
+// bench_trace.cpp - cost of recording a traced socket call
+#include "bench.h"
+#include "../winsock_trace.h"
+
+using namespace winsock;
+
+int bench_trace(size_t n = 10'000'000)
+{
+	bench::measure("trace::null_span", n, [n]() {
+		for (size_t i = 0; i < n; ++i) {
+			trace::null_span t(trace::OP::SEND, i);
+			bench::keep(t(static_cast<int>(i)));
+		}
+	});
+	bench::measure("trace::recording_span", n, [n]() {
+		for (size_t i = 0; i < n; ++i) {
+			trace::recording_span t(trace::OP::SEND, i);
+			bench::keep(t(static_cast<int>(i)));
+		}
+	});
+
+	return 0;
+}
+int bench_trace_ = bench_trace();
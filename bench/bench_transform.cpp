@@ -0,0 +1,94 @@
+// bench_transform.cpp - compression ratio and throughput of the transform stages
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "../winsock_transform.h"
+
+using namespace winsock;
+
+// MB/s on one core of size bytes taken ns_per_op per chunk
+static double mbps(size_t size, double ns)
+{
+	return static_cast<double>(size) / ns * 1e3;
+}
+
+static void bench_data(const char* name, const std::vector<char>& data, size_t reps)
+{
+	const int chunk = 0x10000;
+	const size_t chunks = data.size() / chunk;
+	std::string label;
+
+	transform::pipeline p(chunk);
+	auto& z = p.add<transform::compress>();
+	label = std::string("compress ") + name;
+	double ns = bench::run(label.c_str(), chunks * reps, [&]() {
+		buffer_view<const char> out;
+		for (size_t r = 0; r < reps; ++r) {
+			for (size_t i = 0; i < chunks; ++i) {
+				bench::keep(p.encode(buffer_view<const char>{ data.data() + i * chunk, chunk }, out));
+			}
+		}
+	}, 1, 5);
+	printf("%-40s ratio %.2f %8.0f MB/s skipped %llu\n", label.c_str(), z.ratio(), mbps(chunk, ns), z.skipped);
+
+	// encoded chunks to decode
+	std::vector<std::string> encoded;
+	transform::pipeline q(chunk);
+	q.add<transform::compress>();
+	for (size_t i = 0; i < chunks; ++i) {
+		buffer_view<const char> out;
+		q.encode(buffer_view<const char>{ data.data() + i * chunk, chunk }, out);
+		encoded.emplace_back(out.buf, out.len);
+	}
+	label = std::string("decompress ") + name;
+	ns = bench::run(label.c_str(), chunks * reps, [&]() {
+		buffer_view<const char> out;
+		for (size_t r = 0; r < reps; ++r) {
+			for (const auto& e : encoded) {
+				bench::keep(q.decode(buffer_view<const char>{ e.data(), static_cast<int>(e.size()) }, out));
+			}
+		}
+	}, 1, 5);
+	printf("%-40s %8.0f MB/s\n", label.c_str(), mbps(chunk, ns));
+}
+
+int bench_transform(size_t reps = 10)
+{
+	const size_t size = 64 << 20;
+
+	// log lines compress well
+	std::vector<char> text;
+	text.reserve(size);
+	for (size_t i = 0; text.size() < size; ++i) {
+		std::string line = "2024-01-01T00:00:" + std::to_string(i % 60) + " INFO order " + std::to_string(i)
+			+ " filled qty " + std::to_string(i % 1000) + " px " + std::to_string(100 + i % 37) + "\n";
+		text.insert(text.end(), line.begin(), line.end());
+	}
+	text.resize(size);
+	bench_data("text", text, reps);
+
+	// random data does not
+	std::vector<char> noise(size);
+	uint32_t x = 1;
+	for (auto& c : noise) {
+		x = x * 1664525 + 1013904223;
+		c = static_cast<char>(x >> 24);
+	}
+	bench_data("random", noise, reps);
+
+	transform::pipeline p(0x10000);
+	p.add<transform::checksum>();
+	const size_t chunks = size / 0x10000;
+	double ns = bench::run("checksum crc32c", chunks * reps, [&]() {
+		buffer_view<const char> out;
+		for (size_t r = 0; r < reps; ++r) {
+			for (size_t i = 0; i < chunks; ++i) {
+				bench::keep(p.encode(buffer_view<const char>{ text.data() + i * 0x10000, 0x10000 }, out));
+			}
+		}
+	}, 1, 5);
+	printf("%-40s %8.0f MB/s\n", "checksum crc32c", mbps(0x10000, ns));
+
+	return 0;
+}
+int bench_transform_ = bench_transform();
@@ -0,0 +1,89 @@
+// bench_wire.cpp - binary encoding against memcpy of a packed struct
+#include <string>
+#include "bench.h"
+#include "../winsock_wire.h"
+
+using namespace winsock;
+
+#pragma pack(push, 1)
+struct order {
+	uint64_t id;
+	double px;
+	uint32_t qty;
+	uint8_t side;
+	char symbol[8];
+};
+#pragma pack(pop)
+
+int bench_wire(size_t n = 10'000'000)
+{
+	char buf[64];
+	order o{ 42, 101.25, 300, 1, "MSFT" };
+
+	bench::run("memcpy struct encode", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			o.id = i;
+			memcpy(buf, &o, sizeof(o));
+			bench::keep(buf[0]);
+		}
+	});
+	bench::run("std::string encode and copy", n, [&]() {
+		std::string s;
+		for (size_t i = 0; i < n; ++i) {
+			s.clear();
+			o.id = i;
+			s.append(reinterpret_cast<const char*>(&o.id), sizeof(o.id));
+			s.append(reinterpret_cast<const char*>(&o.px), sizeof(o.px));
+			s.append(reinterpret_cast<const char*>(&o.qty), sizeof(o.qty));
+			s.append(reinterpret_cast<const char*>(&o.side), sizeof(o.side));
+			s.append("MSFT");
+			memcpy(buf, s.data(), s.size());
+			bench::keep(buf[0]);
+		}
+	});
+	bench::run("wire::writer encode", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			wire::writer<> w(buffer_view<char>{ buf, sizeof(buf) });
+			w.put<uint64_t>(i).put(o.px).put(o.qty).put(o.side).string("MSFT");
+			bench::keep(w.size());
+		}
+	});
+	bench::run("wire::net_writer encode", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			wire::net_writer w(buffer_view<char>{ buf, sizeof(buf) });
+			w.put<uint64_t>(i).put(o.px).put(o.qty).put(o.side).string("MSFT");
+			bench::keep(w.size());
+		}
+	});
+
+	memcpy(buf, &o, sizeof(o));
+	bench::run("memcpy struct decode", n, [&]() {
+		order p;
+		for (size_t i = 0; i < n; ++i) {
+			memcpy(&p, buf, sizeof(p));
+			bench::keep(p.qty);
+		}
+	});
+	wire::writer<> w(buffer_view<char>{ buf, sizeof(buf) });
+	w.put(o.id).put(o.px).put(o.qty).put(o.side).string("MSFT");
+	bench::run("wire::reader decode", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			wire::reader<> r(w.view());
+			uint64_t id = r.get<uint64_t>();
+			double px = r.get<double>();
+			uint32_t qty = r.get<uint32_t>();
+			uint8_t side = r.get<uint8_t>();
+			std::string_view symbol = r.string();
+			bench::keep(id + qty + side + symbol.size() + static_cast<uint64_t>(px));
+		}
+	});
+	using qty = wire::field<uint32_t, 16>;
+	bench::run("wire::field get", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			bench::keep(qty::get(buf));
+		}
+	});
+
+	return 0;
+}
+int bench_wire_ = bench_wire();
@@ -0,0 +1,53 @@
+// bench_write.cpp - send per write versus coalesced write queue
+#include <thread>
+#include "bench.h"
+#include "../winsock_write.h"
+
+using namespace winsock;
+
+int bench_write_queue(size_t n = 100'000)
+{
+	tcp::server::socket<> srv("localhost", "6792");
+	srv.listen();
+	tcp::client::socket<> cli("localhost", "6792");
+	winsock::socket<> t = srv.accept();
+
+	// drain the receiving side
+	std::thread sink([&t]() {
+		char buf[0x10000];
+		while (0 < t.recv(buf, sizeof(buf))) {
+			;
+		}
+	});
+
+	const char field[] = "field=value;"; // 12 bytes
+	const int len = static_cast<int>(sizeof(field) - 1);
+
+	bench::measure("socket::send per field", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			cli.send(field, len);
+		}
+	});
+
+	write_queue q(cli);
+	bench::measure("write_queue::write, flush per 100 fields", n, [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			q.write(field, len);
+			if (0 == i % 100) {
+				while (q.pending() && SOCKET_ERROR != q.flush()) {
+					;
+				}
+			}
+		}
+		while (q.pending() && SOCKET_ERROR != q.flush()) {
+			;
+		}
+	});
+	printf("%-40s %12zu writes %zu sends\n", "write_queue", q.writes, q.sends);
+
+	::shutdown(cli, SD_SEND);
+	sink.join();
+
+	return 0;
+}
+int bench_write_queue_ = bench_write_queue();
@@ -0,0 +1,103 @@
+// load.cpp - open loop load generator
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../winsock_load.h"
+
+using namespace winsock;
+
+static int usage()
+{
+	fprintf(stderr,
+		"usage: load [options] host port\n"
+		"  -u          udp, one datagram per request\n"
+		"  -r rate     requests per second over all threads (1000)\n"
+		"  -d seconds  duration including warmup (10)\n"
+		"  -w seconds  warmup not recorded (0)\n"
+		"  -t threads  (1)\n"
+		"  -c conns    connections per thread (1)\n"
+		"  -s file     requests separated by lines holding only %%%% (64 bytes)\n"
+		"  -n bytes    tcp reply size (size of the request)\n"
+		"  -o file     also write the report to file\n");
+
+	return 1;
+}
+
+static std::chrono::milliseconds seconds(const char* s)
+{
+	return std::chrono::milliseconds(static_cast<long long>(atof(s) * 1000));
+}
+
+int main(int argc, char** argv)
+{
+	load::options opt;
+	const char* file = nullptr;
+	const char* out = nullptr;
+	bool udp = false;
+
+	int i = 1;
+	for (; i < argc && '-' == argv[i][0]; ++i) {
+		if (0 == strcmp(argv[i], "-u")) {
+			udp = true;
+			continue;
+		}
+		if (2 != strlen(argv[i]) || i + 1 == argc) {
+			return usage();
+		}
+		const char* arg = argv[++i];
+		switch (argv[i - 1][1]) {
+		case 'r': opt.rate = atof(arg); break;
+		case 'd': opt.duration = seconds(arg); break;
+		case 'w': opt.warmup = seconds(arg); break;
+		case 't': opt.threads = static_cast<unsigned>(atoi(arg)); break;
+		case 'c': opt.connections = static_cast<unsigned>(atoi(arg)); break;
+		case 's': file = arg; break;
+		case 'n': opt.reply = static_cast<size_t>(atoll(arg)); break;
+		case 'o': out = arg; break;
+		default: return usage();
+		}
+	}
+	if (i + 2 != argc) {
+		return usage();
+	}
+	const char* host = argv[i];
+	const char* port = argv[i + 1];
+
+	try {
+		load::script s;
+		if (file) {
+			s = load::script::read(file);
+		}
+		else {
+			s.add(std::string(64, 'x'));
+		}
+
+		load::report r;
+		if (udp) {
+			addrinfo<> ai(host, port, addrinfo<>::hints(SOCK::DGRAM, IPPROTO::UDP, AI::DEFAULT));
+			winsock::sockaddr<> to;
+			memcpy(&to, &ai, std::min(static_cast<size_t>(to.len), static_cast<size_t>(ai.addrlen())));
+			r = load::run_udp(to, s, opt);
+		}
+		else {
+			r = load::run_tcp(host, port, s, opt);
+		}
+
+		r.print();
+		if (out) {
+			FILE* f = nullptr;
+			if (0 != fopen_s(&f, out, "w")) {
+				throw std::runtime_error("cannot open report file");
+			}
+			r.print(f);
+			fclose(f);
+		}
+	}
+	catch (const std::exception& ex) {
+		fprintf(stderr, "load: %s\n", ex.what());
+
+		return 1;
+	}
+
+	return 0;
+}
@@ -84,6 +84,51 @@ int test_hints()
 }
 int test_hints_ = test_hints();
 
+int test_sockopt()
+{
+	{
+		winsock::socket<> s(SOCK::STREAM, IPPROTO::TCP);
+		assert(0 == sockopt<TCP_OPT::NODELAY>(s, TRUE));
+		assert(TRUE == sockopt<TCP_OPT::NODELAY>(s));
+		assert(0 == sockopt<TCP_OPT::KEEPIDLE>(s, 30));
+		assert(30 == sockopt<TCP_OPT::KEEPIDLE>(s));
+		assert(0 == sockopt<IP_OPT::TTL>(s, 32));
+		assert(32 == sockopt<IP_OPT::TTL>(s));
+	}
+	{
+		winsock::socket<AF::INET6> s(SOCK::STREAM, IPPROTO::TCP);
+		assert(0 == sockopt<IPV6_OPT::V6ONLY>(s, 1));
+		assert(1 == sockopt<IPV6_OPT::V6ONLY>(s));
+	}
+	{
+		// echo server from test_tcp_server_echo
+		tcp::client::socket<> s("localhost", "6789");
+		assert(0 == s.tune(tcp::PROFILE::LOW_LATENCY));
+		assert(TRUE == sockopt<TCP_OPT::NODELAY>(s));
+		assert(0 == s.tune(tcp::PROFILE::BULK_THROUGHPUT));
+		assert(FALSE == sockopt<TCP_OPT::NODELAY>(s));
+		assert((4 << 20) == sockopt<GET_SO::RCVBUF>(s));
+	}
+
+	return 0;
+}
+int test_sockopt_ = test_sockopt();
+
+int test_busy_poll()
+{
+	// echo server from test_tcp_server_echo
+	tcp::client::socket<> s("localhost", "6789");
+	char buf[8];
+
+	assert(0 == s.nonblocking());
+	assert(3 == s.send("abc", 3));
+	assert(3 == s.recv(buf, sizeof(buf), busy_poll{ std::chrono::microseconds(10) }));
+	assert(0 == strncmp("abc", buf, 3));
+
+	return 0;
+}
+int test_busy_poll_ = test_busy_poll();
+
 template<AF af>
 int test_constructor()
 {
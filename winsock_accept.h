@@ -0,0 +1,158 @@
+// winsock_accept.h - batch accept and deferred accept
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <span>
+#include <vector>
+#include "winsock_loop.h"
+
+namespace winsock {
+
+	/// <summary>
+	/// Drain the pending connections of a listening socket on each readiness event.
+	/// </summary>
+	/// <remarks>
+	/// The listener must be non-blocking. Windows sockets returned by accept inherit the
+	/// non-blocking mode of the listener, so unlike accept4(SOCK_NONBLOCK) nothing
+	/// needs to be passed and no ioctl is needed before adding them to an event loop.
+	/// Each call to <c>accept</c> replaces the previous batch.
+	/// </remarks>
+	template<AF af = AF::INET>
+	class accept_batch {
+		std::vector<winsock::socket<af>> socks;
+		std::vector<sockaddr<af>> addrs;
+		size_t max;
+	public:
+		accept_batch(size_t _max = 64)
+			: max(_max)
+		{
+			socks.reserve(max);
+			addrs.reserve(max);
+		}
+
+		/// Accept up to max connections until the listener would block.
+		/// Returns the number accepted.
+		template<class L>
+		size_t accept(const L& listener)
+		{
+			socks.clear();
+			addrs.clear();
+			while (socks.size() < max) {
+				sockaddr<af> sa;
+				winsock::socket<af> s = listener.accept(sa);
+				if (INVALID_SOCKET == s) {
+					break; // WSAEWOULDBLOCK or error
+				}
+				socks.push_back(std::move(s));
+				addrs.push_back(sa);
+			}
+
+			return socks.size();
+		}
+
+		size_t size() const
+		{
+			return socks.size();
+		}
+		// accepted sockets, move them out to keep them
+		std::span<winsock::socket<af>> sockets()
+		{
+			return socks;
+		}
+		// peer of each accepted socket
+		std::span<const sockaddr<af>> peers() const
+		{
+			return addrs;
+		}
+	};
+
+	/// <summary>
+	/// Hand accepted connections to a handler only once the client has sent data.
+	/// </summary>
+	/// <remarks>
+	/// Windows has no TCP_DEFER_ACCEPT so deferral is done in the event loop.
+	/// Accepted sockets are polled for POLLRDNORM and passed to the handler when readable.
+	/// Like TCP_DEFER_ACCEPT, a connection that sends nothing for <c>timeout</c> is passed
+	/// on anyway so the handler can decide to close it.
+	/// </remarks>
+	template<AF af = AF::INET>
+	class deferred_accept {
+	public:
+		using handler = std::function<void(winsock::socket<af>&&, const sockaddr<af>&)>;
+	private:
+		struct waiting {
+			winsock::socket<af> s;
+			sockaddr<af> sa;
+			timer_wheel::clock::time_point expires;
+		};
+		event_loop& loop;
+		::SOCKET listener;
+		handler f;
+		timer_wheel::clock::duration timeout;
+		accept_batch<af> batch;
+		std::list<waiting> pending; // in order of arrival, so expiry order
+		timer sweep;
+
+		void ready(typename std::list<waiting>::iterator i)
+		{
+			loop.remove(i->s);
+			winsock::socket<af> s = std::move(i->s);
+			sockaddr<af> sa = i->sa;
+			pending.erase(i);
+			f(std::move(s), sa);
+		}
+		void arm()
+		{
+			if (!pending.empty() && !sweep.armed()) {
+				auto d = pending.front().expires - timer_wheel::clock::now();
+				loop.timers().schedule(sweep, std::max(d, timer_wheel::clock::duration::zero()));
+			}
+		}
+		void expire()
+		{
+			auto now = timer_wheel::clock::now();
+			while (!pending.empty() && pending.front().expires <= now) {
+				ready(pending.begin());
+			}
+			arm();
+		}
+	public:
+		/// Accept from listener, which must be non-blocking, listening, and outlive this.
+		template<class L>
+		deferred_accept(event_loop& _loop, const L& _listener, handler _f,
+			timer_wheel::clock::duration _timeout = std::chrono::seconds(5), size_t max = 64)
+			: loop(_loop), listener(_listener), f(std::move(_f)), timeout(_timeout), batch(max),
+			  sweep([this](timer&) { expire(); })
+		{
+			loop.add(listener, POLLRDNORM, [this, &_listener](SHORT) {
+				batch.accept(_listener);
+				auto peers = batch.peers();
+				size_t j = 0;
+				for (auto& s : batch.sockets()) {
+					pending.push_back(waiting{ std::move(s), peers[j++], timer_wheel::clock::now() + timeout });
+					auto i = std::prev(pending.end());
+					loop.add(i->s, POLLRDNORM, [this, i](SHORT) { ready(i); });
+				}
+				arm();
+			});
+		}
+		deferred_accept(const deferred_accept&) = delete;
+		deferred_accept& operator=(const deferred_accept&) = delete;
+		~deferred_accept()
+		{
+			loop.remove(listener);
+			for (auto& w : pending) {
+				loop.remove(w.s);
+			}
+		}
+
+		// connections accepted that have not sent data
+		size_t size() const
+		{
+			return pending.size();
+		}
+	};
+
+}
@@ -0,0 +1,75 @@
+// winsock_accept.t.cpp - test batch and deferred accept
+#include <cassert>
+#include <vector>
+#include "winsock_accept.h"
+
+using namespace winsock;
+
+int test_accept_batch()
+{
+	tcp::server::socket<> srv("localhost", "6804");
+	srv.listen();
+	srv.nonblocking();
+
+	accept_batch<> batch(2);
+	assert(0 == batch.accept(srv));
+
+	std::vector<tcp::client::socket<>> clients;
+	for (int i = 0; i < 3; ++i) {
+		clients.emplace_back("localhost", "6804");
+	}
+	::Sleep(50);
+
+	assert(2 == batch.accept(srv)); // at most max per call
+	assert(clients[0].sockname() == batch.peers()[0]);
+	// inherited non-blocking mode
+	char buf[8];
+	assert(SOCKET_ERROR == batch.sockets()[0].recv(buf, sizeof(buf)));
+	assert(WSAEWOULDBLOCK == ::WSAGetLastError());
+	winsock::socket<> kept = std::move(batch.sockets()[1]);
+
+	assert(1 == batch.accept(srv));
+	assert(0 == batch.accept(srv));
+
+	return 0;
+}
+int test_accept_batch_ = test_accept_batch();
+
+int test_deferred_accept()
+{
+	tcp::server::socket<> srv("localhost", "6804");
+	srv.listen();
+	srv.nonblocking();
+
+	event_loop loop;
+	std::vector<std::pair<winsock::socket<>, int>> got; // socket and bytes available
+	deferred_accept<> defer(loop, srv, [&got](winsock::socket<>&& s, const winsock::sockaddr<>&) {
+		char buf[8];
+		int n = s.recv(buf, sizeof(buf));
+		got.emplace_back(std::move(s), n);
+	}, std::chrono::milliseconds(100));
+
+	tcp::client::socket<> quiet("localhost", "6804");
+	tcp::client::socket<> talker("localhost", "6804");
+	for (int i = 0; i < 20 && 2 != defer.size(); ++i) {
+		loop.run_once(10);
+	}
+	assert(2 == defer.size());
+	assert(got.empty());
+
+	talker.send("abc", 3);
+	for (int i = 0; i < 20 && got.empty(); ++i) {
+		loop.run_once(10);
+	}
+	assert(1 == got.size() && 3 == got[0].second);
+
+	// passed on without data after the timeout
+	for (int i = 0; i < 50 && 1 == got.size(); ++i) {
+		loop.run_once(10);
+	}
+	assert(2 == got.size() && SOCKET_ERROR == got[1].second);
+	assert(0 == defer.size());
+
+	return 0;
+}
+int test_deferred_accept_ = test_deferred_accept();
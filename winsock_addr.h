@@ -3,6 +3,7 @@
 #include <array>
 #include <compare>
 #include <stdexcept>
+#include <string>
 #include "winsock_enum.h"
 
 namespace winsock {
@@ -127,6 +128,27 @@ namespace winsock {
 
 	};
 
+	// AF_UNIX address of the socket file at path
+	inline sockaddr<AF::UNIX> unix_addr(const char* path)
+	{
+		sockaddr<AF::UNIX> sa;
+
+		if (0 != strcpy_s(sa.in().sun_path, path)) {
+			throw std::runtime_error("winsock::unix_addr path too long");
+		}
+
+		return sa;
+	}
+
+	// name in the temporary directory, e.g. for an AF_UNIX socket file
+	inline std::string temp_path(const char* name)
+	{
+		char dir[MAX_PATH];
+		DWORD n = ::GetTempPathA(MAX_PATH, dir);
+
+		return std::string(dir, n) + name;
+	}
+
 	/// <summary>
 	/// The addrinfo class is used by the getaddrinfo function to hold host address information.
 	/// </summary>
@@ -0,0 +1,340 @@
+// winsock_broadcast.h - send one message to many connections by reference
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "winsock_socket.h"
+
+namespace winsock {
+
+	/// <summary>
+	/// Immutable reference counted payload, copied once however many connections it goes to.
+	/// </summary>
+	/// <remarks>
+	/// The memory is freed when the last copy of the message is destroyed, which for a
+	/// broadcast is when the last connection has finished sending it.
+	/// <c>key</c> identifies what the message updates, e.g. a symbol, for conflation.
+	/// </remarks>
+	class message {
+		std::shared_ptr<char[]> p;
+		int len;
+		uint64_t key_;
+	public:
+		message(const char* buf, int _len, uint64_t _key = 0)
+			: p(std::make_shared_for_overwrite<char[]>(static_cast<size_t>(_len))), len(_len), key_(_key)
+		{
+			memcpy(p.get(), buf, static_cast<size_t>(len));
+		}
+
+		const char* data() const
+		{
+			return p.get();
+		}
+		int size() const
+		{
+			return len;
+		}
+		uint64_t key() const
+		{
+			return key_;
+		}
+		// references held by this and the queues of connections it is waiting on
+		long use_count() const
+		{
+			return p.use_count();
+		}
+	};
+
+	// what to do when a subscriber falls more than the high water mark behind
+	enum class SLOW {
+		DROP,       // drop new messages until it catches up
+		DISCONNECT, // close it
+		CONFLATE,   // replace unsent messages with the same key as soon as there is a backlog, drop new keys
+	};
+
+	/// <summary>
+	/// Fan out messages to many non-blocking connections.
+	/// </summary>
+	/// <remarks>
+	/// A published message is copied once into a <c>message</c> and queued by reference.
+	/// Subscribers that are keeping up get it with a direct <c>send</c> and nothing is queued.
+	/// Subscribers with a backlog are sent up to <c>max_iov</c> messages with one
+	/// <c>WSASend</c> by <c>flush</c>, typically called from an <c>event_loop::idle</c>
+	/// handler. While corked nothing is sent, so a burst of messages goes out as one
+	/// vectored send per subscriber when uncorked.
+	/// A subscriber whose send fails, or that is too far behind with <c>SLOW::DISCONNECT</c>,
+	/// is removed and passed to the <c>closed</c> handler. Sockets are not owned.
+	/// </remarks>
+	class broadcast {
+	public:
+		using handler = std::function<void(::SOCKET)>;
+	private:
+		struct entry {
+			message msg;
+			size_t off; // bytes already sent
+		};
+		struct subscriber {
+			::SOCKET s;
+			std::deque<entry> q;
+			size_t queued;  // bytes not yet sent
+			uint64_t popped; // entries sent, the position of q.front()
+			std::unordered_map<uint64_t, uint64_t> latest; // key to position, for conflation
+			bool dead;
+		};
+
+		SLOW policy;
+		size_t high_water;
+		handler closed;
+		ULONG max_iov;
+		std::vector<subscriber> subs;
+		std::unordered_map<::SOCKET, size_t> index;
+		std::vector<WSABUF> iov;
+		size_t behind; // subscribers with a backlog
+		int corks;
+
+		void enqueue(subscriber& sub, const message& m, size_t off)
+		{
+			if (sub.q.empty()) {
+				++behind;
+			}
+			if (SLOW::CONFLATE == policy) {
+				sub.latest[m.key()] = sub.popped + sub.q.size();
+			}
+			sub.q.push_back(entry{ m, off });
+			sub.queued += static_cast<size_t>(m.size()) - off;
+		}
+		// replace the unsent message with the key of m
+		bool conflate(subscriber& sub, const message& m)
+		{
+			auto i = sub.latest.find(m.key());
+			if (i == sub.latest.end() || i->second < sub.popped) {
+				return false;
+			}
+			entry& e = sub.q[static_cast<size_t>(i->second - sub.popped)];
+			if (e.off) {
+				return false; // partly sent
+			}
+			sub.queued += static_cast<size_t>(m.size());
+			sub.queued -= static_cast<size_t>(e.msg.size());
+			e.msg = m;
+
+			return true;
+		}
+		void fail(subscriber& sub)
+		{
+			if (!sub.dead) {
+				sub.dead = true;
+				++disconnected;
+				if (!sub.q.empty()) {
+					--behind;
+				}
+			}
+		}
+		// remove dead subscribers and tell the owner
+		void reap()
+		{
+			for (size_t i = 0; i < subs.size(); ) {
+				if (subs[i].dead) {
+					::SOCKET s = subs[i].s;
+					remove(i);
+					if (closed) {
+						closed(s);
+					}
+				}
+				else {
+					++i;
+				}
+			}
+		}
+		void remove(size_t i)
+		{
+			index.erase(subs[i].s);
+			if (i + 1 != subs.size()) {
+				subs[i] = std::move(subs.back());
+				index[subs[i].s] = i;
+			}
+			subs.pop_back();
+		}
+		void deliver(subscriber& sub, const message& m)
+		{
+			if (sub.q.empty() && !corked()) {
+				int n = ::send(sub.s, m.data(), m.size(), 0);
+				++sends;
+				if (n == m.size()) {
+					return;
+				}
+				if (SOCKET_ERROR == n) {
+					if (WSAEWOULDBLOCK != ::WSAGetLastError()) {
+						fail(sub);
+						return;
+					}
+					n = 0;
+				}
+				enqueue(sub, m, static_cast<size_t>(n));
+				return;
+			}
+			if (SLOW::CONFLATE == policy && conflate(sub, m)) {
+				++conflated;
+				return;
+			}
+			if (sub.queued + static_cast<size_t>(m.size()) > high_water) {
+				if (SLOW::DISCONNECT == policy) {
+					fail(sub);
+				}
+				else {
+					++dropped;
+				}
+				return;
+			}
+			enqueue(sub, m, 0);
+		}
+		// one vectored send of the backlog
+		void drain(subscriber& sub)
+		{
+			iov.clear();
+			for (const auto& e : sub.q) {
+				if (iov.size() == max_iov) {
+					break;
+				}
+				iov.push_back(WSABUF{ static_cast<ULONG>(static_cast<size_t>(e.msg.size()) - e.off), const_cast<char*>(e.msg.data()) + e.off });
+			}
+
+			DWORD sent = 0;
+			++sends;
+			if (SOCKET_ERROR == ::WSASend(sub.s, iov.data(), static_cast<DWORD>(iov.size()), &sent, 0, nullptr, nullptr)) {
+				if (WSAEWOULDBLOCK != ::WSAGetLastError()) {
+					fail(sub);
+				}
+				return;
+			}
+
+			size_t n = sent;
+			sub.queued -= n;
+			while (n) {
+				entry& e = sub.q.front();
+				size_t m = std::min(n, static_cast<size_t>(e.msg.size()) - e.off);
+				e.off += m;
+				n -= m;
+				if (e.off == static_cast<size_t>(e.msg.size())) {
+					if (SLOW::CONFLATE == policy) {
+						auto i = sub.latest.find(e.msg.key());
+						if (i != sub.latest.end() && i->second == sub.popped) {
+							sub.latest.erase(i);
+						}
+					}
+					sub.q.pop_front(); // releases the message when it was the last
+					++sub.popped;
+				}
+			}
+			if (sub.q.empty()) {
+				--behind;
+			}
+		}
+	public:
+		// counters for reporting
+		size_t published, sends, dropped, conflated, disconnected;
+
+		broadcast(SLOW _policy = SLOW::DROP, size_t _high_water = 1 << 20, handler _closed = nullptr, ULONG _max_iov = 64)
+			: policy(_policy), high_water(_high_water), closed(std::move(_closed)), max_iov(_max_iov), behind(0), corks(0),
+			  published(0), sends(0), dropped(0), conflated(0), disconnected(0)
+		{
+			iov.reserve(max_iov);
+		}
+		broadcast(const broadcast&) = delete;
+		broadcast& operator=(const broadcast&) = delete;
+		~broadcast()
+		{ }
+
+		/// Add a non-blocking connected socket.
+		void subscribe(::SOCKET s)
+		{
+			if (!index.contains(s)) {
+				index[s] = subs.size();
+				subs.push_back(subscriber{ s, {}, 0, 0, {}, false });
+			}
+		}
+		/// Remove s and drop its backlog.
+		void unsubscribe(::SOCKET s)
+		{
+			auto i = index.find(s);
+			if (i != index.end()) {
+				const subscriber& sub = subs[i->second];
+				if (!sub.dead && !sub.q.empty()) {
+					--behind;
+				}
+				remove(i->second);
+			}
+		}
+		size_t size() const
+		{
+			return subs.size();
+		}
+		// bytes queued for s
+		size_t backlog(::SOCKET s) const
+		{
+			auto i = index.find(s);
+
+			return i == index.end() ? 0 : subs[i->second].queued;
+		}
+		// subscribers with a backlog
+		size_t lagging() const
+		{
+			return behind;
+		}
+
+		/// Send or queue m to every subscriber.
+		void publish(const message& m)
+		{
+			++published;
+			for (auto& sub : subs) {
+				if (!sub.dead) {
+					deliver(sub, m);
+				}
+			}
+			reap();
+		}
+		void publish(const char* buf, int len, uint64_t key = 0)
+		{
+			publish(message(buf, len, key));
+		}
+
+		/// Send backlogs. Returns the number of subscribers still behind.
+		size_t flush()
+		{
+			if (behind && !corked()) {
+				for (auto& sub : subs) {
+					if (!sub.dead && !sub.q.empty()) {
+						drain(sub);
+					}
+				}
+				reap();
+			}
+
+			return behind;
+		}
+
+		/// Queue without sending until uncork. Corks nest.
+		void cork()
+		{
+			++corks;
+		}
+		/// Release one cork and flush when the last one is released.
+		size_t uncork()
+		{
+			if (corks > 0 && 0 == --corks) {
+				return flush();
+			}
+
+			return behind;
+		}
+		bool corked() const
+		{
+			return corks > 0;
+		}
+	};
+
+}
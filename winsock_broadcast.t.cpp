@@ -0,0 +1,94 @@
+// winsock_broadcast.t.cpp - test fan out of shared messages
+#include <cassert>
+#include <memory>
+#include <vector>
+#include "winsock_broadcast.h"
+
+using namespace winsock;
+
+int test_broadcast()
+{
+	tcp::server::socket<> srv("localhost", "6817");
+	srv.listen();
+	std::vector<std::unique_ptr<tcp::client::socket<>>> clis;
+	std::vector<winsock::socket<>> subs;
+	auto connect = [&]() {
+		clis.push_back(std::make_unique<tcp::client::socket<>>("localhost", "6817"));
+		subs.push_back(srv.accept());
+		subs.back().nonblocking();
+		return static_cast<::SOCKET>(subs.back());
+	};
+	char buf[64];
+
+	{
+		broadcast b;
+		for (int i = 0; i < 3; ++i) {
+			b.subscribe(connect());
+		}
+		assert(3 == b.size());
+
+		// keeping up, nothing is queued
+		message m("hello", 5);
+		b.publish(m);
+		assert(1 == m.use_count() && 0 == b.lagging());
+		for (auto& c : clis) {
+			assert(5 == c->recv(buf, 5, RCV_MSG::WAITALL) && 0 == memcmp(buf, "hello", 5));
+		}
+
+		// corked messages are queued by reference and sent together
+		b.cork();
+		b.publish(m);
+		b.publish("abc", 3);
+		assert(4 == m.use_count() && 3 == b.lagging());
+		assert(8 == b.backlog(subs[0]));
+		size_t sends = b.sends;
+		assert(0 == b.uncork());
+		assert(sends + 3 == b.sends);
+		assert(1 == m.use_count());
+		for (auto& c : clis) {
+			assert(8 == c->recv(buf, 8, RCV_MSG::WAITALL) && 0 == memcmp(buf, "helloabc", 8));
+		}
+
+		b.unsubscribe(subs[2]);
+		assert(2 == b.size());
+	}
+	{
+		// latest value per key
+		broadcast b(SLOW::CONFLATE);
+		b.subscribe(subs[0]);
+		b.cork();
+		b.publish("a1", 2, 1);
+		b.publish("b1", 2, 2);
+		b.publish("a2", 2, 1);
+		assert(1 == b.conflated && 4 == b.backlog(subs[0]));
+		b.uncork();
+		assert(4 == clis[0]->recv(buf, 4, RCV_MSG::WAITALL) && 0 == memcmp(buf, "a2b1", 4));
+	}
+	{
+		// a subscriber that does not read
+		::SOCKET slow = connect();
+		sockopt<SET_SO::SNDBUF>(slow, 4096);
+		sockopt<SET_SO::RCVBUF>(*clis.back(), 4096);
+		std::vector<char> big(4096, 'x');
+
+		broadcast b(SLOW::DROP, 64 * 1024);
+		b.subscribe(slow);
+		for (int i = 0; i < 10000 && 0 == b.dropped; ++i) {
+			b.publish(big.data(), static_cast<int>(big.size()));
+		}
+		assert(0 < b.dropped && b.backlog(slow) <= 64 * 1024);
+		assert(1 == b.size());
+
+		std::vector<::SOCKET> closed;
+		broadcast d(SLOW::DISCONNECT, 64 * 1024, [&closed](::SOCKET s) { closed.push_back(s); });
+		d.subscribe(slow);
+		for (int i = 0; i < 10000 && 0 == d.disconnected; ++i) {
+			d.publish(big.data(), static_cast<int>(big.size()));
+		}
+		assert(1 == closed.size() && slow == closed[0]);
+		assert(0 == d.size() && 0 == d.lagging());
+	}
+
+	return 0;
+}
+int test_broadcast_ = test_broadcast();
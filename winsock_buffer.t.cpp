@@ -88,4 +88,60 @@ int test_buffer()
 	return 0;
 }
 
-int test_buffer_ = test_buffer();
\ No newline at end of file
+int test_buffer_ = test_buffer();
+
+int test_buffer_pool()
+{
+	buffer_pool<0x100> pool(2);
+	assert(2 == pool.available());
+
+	auto a = pool.acquire();
+	auto b = pool.acquire();
+	assert(0x100 == a.len && 0x100 == b.len);
+	assert(a.buf + 0x100 == b.buf);
+	auto c = pool.acquire();
+	assert(!c.buf && 0 == c.len); // exhausted
+
+	memcpy_s(a.buf, a.len, "abc", 3);
+	pool.release(a);
+	auto d = pool.acquire();
+	assert(d.buf == a.buf);
+	pool.release(b);
+	pool.release(d);
+	assert(2 == pool.available());
+
+	return 0;
+}
+int test_buffer_pool_ = test_buffer_pool();
+
+int test_map_policy()
+{
+	{
+		// falls back to default pages without "Lock pages in memory"
+		iobuffer<char> b(1 << 20, map_policy{ .large = true, .prefault = true });
+		assert(b.buf);
+		assert(b.len == 1 << 20);
+		memcpy_s(b.buf + b.len - 3, 3, "abc", 3);
+		assert(0 == strncmp("abc", b.buf + b.len - 3, 3));
+	}
+	{
+		iobuffer<char> b(1 << 16, map_policy{ .prefault = true, .node = current_node() });
+		assert(b.buf);
+		assert(!b.large_pages());
+	}
+	{
+		// flat processor numbers across groups
+		const auto& all = processors();
+		assert(!all.empty());
+		assert(all.size() - 1 == processor_index(all.back()));
+		assert(SIZE_MAX == processor_index(PROCESSOR_NUMBER{ 0xFFFF, 0, 0 }));
+	}
+	{
+		buffer_pool<0x100> pool(4, map_policy{ .node = processor_node(0) });
+		assert(4 == pool.available());
+		assert(pool.memory().buf);
+	}
+
+	return 0;
+}
+int test_map_policy_ = test_map_policy();
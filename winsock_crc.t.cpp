@@ -0,0 +1,38 @@
+// winsock_crc.t.cpp - test CRC-32C
+#include <cassert>
+#include <vector>
+#include "winsock_crc.h"
+
+using namespace winsock;
+
+int test_crc32c()
+{
+	assert(0xE3069283 == crc32c(0, "123456789", 9));
+	assert(0xE3069283 == crc::portable(0, "123456789", 9));
+
+	// hardware and portable agree on every length and alignment
+	std::vector<char> data(70000);
+	uint32_t x = 1;
+	for (auto& c : data) {
+		x = x * 1664525 + 1013904223;
+		c = static_cast<char>(x >> 24);
+	}
+	for (size_t n : { 0, 1, 7, 8, 255, 768, 769, 24575, 24576, 24577, 69000 }) {
+		for (size_t off = 0; off < 8; ++off) {
+			uint32_t crc = crc::portable(0, data.data() + off, n);
+			assert(crc == crc32c(0, data.data() + off, n));
+			// in pieces
+			size_t k = n / 3;
+			assert(crc == crc32c(crc32c(0, data.data() + off, k), data.data() + off + k, n - k));
+		}
+	}
+
+	char msg[16] = "hello";
+	assert(9 == crc32c_trailer::seal(msg, 5));
+	assert(5 == crc32c_trailer::open(msg, 9));
+	msg[1] ^= 1;
+	assert(-1 == crc32c_trailer::open(msg, 9));
+
+	return 0;
+}
+int test_crc32c_ = test_crc32c();
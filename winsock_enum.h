@@ -3,6 +3,7 @@
 #define WIN32_LEAN_AND_MEAN
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <afunix.h>
 
 namespace winsock {
 
@@ -119,6 +120,20 @@ namespace winsock {
 		inline static const IN6_ADDR teredoprefix_old = in6addr_teredoprefix_old;
 	};
 
+	template<>
+	struct inaddr<AF::UNIX> {
+		typedef SOCKADDR_UN sockaddr_type;
+		typedef char addr_type[UNIX_PATH_MAX]; // file name
+		static ADDRESS_FAMILY& family(sockaddr_type& addr)
+		{
+			return addr.sun_family;
+		}
+		static addr_type& addr(sockaddr_type& addr)
+		{
+			return addr.sun_path;
+		}
+	};
+
 	// addrinfo ai_flags for getaddrinfo
 #define AI_ENUM(X) \
 	X(PASSIVE, "Setting the AI_PASSIVE flag indicates the caller intends to use the returned socket address structure in a call to the bind function. When the AI_PASSIVE flag is set and pNodeName is a NULL pointer, the IP address portion of the socket address structure is set to INADDR_ANY for IPv4 addresses and IN6ADDR_ANY_INIT for IPv6 addresses.") \
@@ -151,6 +166,7 @@ namespace winsock {
 
 	/// socket protocol
 	enum class IPPROTO : int {
+		DEFAULT = 0, // only protocol of the address family and type, e.g. AF::UNIX
 		HOPOPTS = IPPROTO_HOPOPTS,
 		ICMP = IPPROTO_ICMP,
 		IGMP = IPPROTO_IGMP,
@@ -340,4 +356,132 @@ namespace winsock {
 
 	//!!! inline ... linger(SOCKET s, ...)
 
+	/// Protocol level socket options getsockopt/setsockopt(IPPROTO_TCP, ...)
+#define IPPROTO_TCP_OPT(X) \
+	X(NODELAY, BOOL, "Disables the Nagle algorithm for send coalescing.") \
+	X(EXPEDITED_1122, BOOL, "Urgent data is handled as specified in RFC 1122 instead of the BSD way.") \
+	X(KEEPIDLE, DWORD, "The number of seconds a TCP connection will remain idle before keepalive probes are sent.") \
+	X(KEEPINTVL, DWORD, "The number of seconds a TCP connection will wait for a keepalive response before sending another keepalive probe.") \
+	X(KEEPCNT, DWORD, "The number of TCP keep alive probes that will be sent before the connection is terminated.") \
+	X(MAXSEG, DWORD, "The maximum segment size for outgoing TCP packets.") \
+	X(MAXRT, DWORD, "The number of seconds a TCP connection will wait for an acknowledgement before aborting. Similar to TCP_USER_TIMEOUT on Linux.") \
+	X(MAXRTMS, DWORD, "The number of milliseconds a TCP connection will wait for an acknowledgement before aborting.") \
+	X(TIMESTAMPS, BOOL, "Enables RFC 1323 timestamps.") \
+	X(FASTOPEN, BOOL, "Enables TCP Fast Open on a client socket before connect or a listening socket before listen.") \
+
+	/// getsockopt/setsockopt(IPPROTO_IP, ...)
+#define IPPROTO_IP_OPT(X) \
+	X(TOS, DWORD, "Type of service. Ignored by Windows unless allowed by QoS policy.") \
+	X(TTL, DWORD, "Time to live of unicast packets.") \
+	X(MULTICAST_IF, DWORD, "Outgoing interface for IPv4 multicast traffic in network byte order, or an interface index in host byte order of the form 0.0.0.x.") \
+	X(MULTICAST_TTL, DWORD, "Time to live of multicast packets.") \
+	X(MULTICAST_LOOP, DWORD, "Multicast packets sent are looped back to receivers on the local host.") \
+	X(DONTFRAGMENT, DWORD, "Sets the do not fragment flag on outgoing packets.") \
+	X(PKTINFO, DWORD, "Return the destination address and arrival interface of datagrams using WSARecvMsg.") \
+	X(RECVTTL, DWORD, "Return the time to live of datagrams using WSARecvMsg.") \
+	X(UNICAST_IF, DWORD, "Outgoing interface index for unicast traffic in network byte order.") \
+	X(MTU, DWORD, "The path MTU of a connected socket.") \
+	X(ADD_MEMBERSHIP, ip_mreq, "Join a multicast group on an interface. Set only.") \
+	X(DROP_MEMBERSHIP, ip_mreq, "Leave a multicast group on an interface. Set only.") \
+	X(ADD_SOURCE_MEMBERSHIP, ip_mreq_source, "Join a multicast group receiving only from one source. Set only.") \
+	X(DROP_SOURCE_MEMBERSHIP, ip_mreq_source, "Stop receiving from a source in a multicast group. Set only.") \
+	X(BLOCK_SOURCE, ip_mreq_source, "Stop receiving from a source in a joined multicast group. Set only.") \
+	X(UNBLOCK_SOURCE, ip_mreq_source, "Receive again from a blocked source. Set only.") \
+
+	/// getsockopt/setsockopt(IPPROTO_IPV6, ...)
+#define IPPROTO_IPV6_OPT(X) \
+	X(V6ONLY, DWORD, "Restrict the socket to IPv6 communications only. Must be set before bind.") \
+	X(UNICAST_HOPS, DWORD, "Hop limit of unicast packets.") \
+	X(MULTICAST_IF, DWORD, "Interface index for outgoing IPv6 multicast traffic.") \
+	X(MULTICAST_HOPS, DWORD, "Hop limit of multicast packets.") \
+	X(MULTICAST_LOOP, DWORD, "Multicast packets sent are looped back to receivers on the local host.") \
+	X(DONTFRAG, DWORD, "Do not fragment outgoing packets.") \
+	X(PKTINFO, DWORD, "Return the destination address and arrival interface of datagrams using WSARecvMsg.") \
+	X(TCLASS, DWORD, "Traffic class of outgoing packets.") \
+	X(UNICAST_IF, DWORD, "Outgoing interface index for unicast traffic.") \
+	X(MTU, DWORD, "The path MTU of a connected socket.") \
+	X(ADD_MEMBERSHIP, ipv6_mreq, "Join a multicast group on an interface index. Set only.") \
+	X(DROP_MEMBERSHIP, ipv6_mreq, "Leave a multicast group on an interface index. Set only.") \
+
+#define TCP_OPT_ENUM(name, type, desc) name = (TCP_ ## name),
+	enum class TCP_OPT : int {
+		IPPROTO_TCP_OPT(TCP_OPT_ENUM)
+	};
+#undef TCP_OPT_ENUM
+#define IP_OPT_ENUM(name, type, desc) name = (IP_ ## name),
+	enum class IP_OPT : int {
+		IPPROTO_IP_OPT(IP_OPT_ENUM)
+	};
+#undef IP_OPT_ENUM
+#define IPV6_OPT_ENUM(name, type, desc) name = (IPV6_ ## name),
+	enum class IPV6_OPT : int {
+		IPPROTO_IPV6_OPT(IPV6_OPT_ENUM)
+	};
+#undef IPV6_OPT_ENUM
+
+	/// <summary>
+	///  Protocol level socket option types.
+	/// </summary>
+	template<enum TCP_OPT T> struct tcp_opt_type { };
+	template<enum IP_OPT T> struct ip_opt_type { };
+	template<enum IPV6_OPT T> struct ipv6_opt_type { };
+#define TCP_OPT_TYPE(name, T, desc) template<> struct tcp_opt_type<TCP_OPT::##name> { typedef T type; };
+	IPPROTO_TCP_OPT(TCP_OPT_TYPE)
+#undef TCP_OPT_TYPE
+#define IP_OPT_TYPE(name, T, desc) template<> struct ip_opt_type<IP_OPT::##name> { typedef T type; };
+	IPPROTO_IP_OPT(IP_OPT_TYPE)
+#undef IP_OPT_TYPE
+#define IPV6_OPT_TYPE(name, T, desc) template<> struct ipv6_opt_type<IPV6_OPT::##name> { typedef T type; };
+	IPPROTO_IPV6_OPT(IPV6_OPT_TYPE)
+#undef IPV6_OPT_TYPE
+
+	/// Get protocol level option. Value initialized if getsockopt fails.
+	template<class T>
+	inline T sockopt(SOCKET s, int level, int name)
+	{
+		T t{};
+		int len(sizeof(t));
+
+		::getsockopt(s, level, name, (char*)&t, &len);
+
+		return t;
+	}
+	/// Set protocol level option.
+	template<class T>
+	inline int sockopt(SOCKET s, int level, int name, const T& t)
+	{
+		return ::setsockopt(s, level, name, (const char*)&t, sizeof(t));
+	}
+
+	template<enum TCP_OPT opt>
+	inline typename tcp_opt_type<opt>::type sockopt(SOCKET s)
+	{
+		return sockopt<typename tcp_opt_type<opt>::type>(s, IPPROTO_TCP, static_cast<int>(opt));
+	}
+	template<enum TCP_OPT opt>
+	inline int sockopt(SOCKET s, typename tcp_opt_type<opt>::type t)
+	{
+		return sockopt(s, IPPROTO_TCP, static_cast<int>(opt), t);
+	}
+	template<enum IP_OPT opt>
+	inline typename ip_opt_type<opt>::type sockopt(SOCKET s)
+	{
+		return sockopt<typename ip_opt_type<opt>::type>(s, IPPROTO_IP, static_cast<int>(opt));
+	}
+	template<enum IP_OPT opt>
+	inline int sockopt(SOCKET s, typename ip_opt_type<opt>::type t)
+	{
+		return sockopt(s, IPPROTO_IP, static_cast<int>(opt), t);
+	}
+	template<enum IPV6_OPT opt>
+	inline typename ipv6_opt_type<opt>::type sockopt(SOCKET s)
+	{
+		return sockopt<typename ipv6_opt_type<opt>::type>(s, IPPROTO_IPV6, static_cast<int>(opt));
+	}
+	template<enum IPV6_OPT opt>
+	inline int sockopt(SOCKET s, typename ipv6_opt_type<opt>::type t)
+	{
+		return sockopt(s, IPPROTO_IPV6, static_cast<int>(opt), t);
+	}
+
 }
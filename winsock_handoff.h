@@ -0,0 +1,184 @@
+// winsock_handoff.h - pass listening and connected sockets to a successor process
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "winsock_socket.h"
+
+namespace winsock::handoff {
+
+	// last byte of a handoff from the successor
+	enum class ACK : char {
+		FAILED = 0, // the sender keeps its sockets
+		OK = 1,     // every socket was created, the sender can close its own
+	};
+
+	// send or receive exactly len bytes
+	inline bool send_all(const socket<AF::UNIX>& s, const void* buf, int len)
+	{
+		const char* p = static_cast<const char*>(buf);
+
+		while (len > 0) {
+			int n = s.send(p, len);
+			if (n <= 0) {
+				return false;
+			}
+			p += n;
+			len -= n;
+		}
+
+		return true;
+	}
+	inline bool recv_all(const socket<AF::UNIX>& s, void* buf, int len)
+	{
+		return len == s.recv(static_cast<char*>(buf), len, RCV_MSG::WAITALL);
+	}
+
+	/// <summary>
+	/// Running process that hands its sockets to the process replacing it.
+	/// </summary>
+	/// <remarks>
+	/// Windows has no SCM_RIGHTS so sockets can not be sent over an AF_UNIX socket.
+	/// Instead the successor connects to <c>path</c> and sends its process id,
+	/// each socket is duplicated into the successor with <c>WSADuplicateSocket</c>,
+	/// and the resulting <c>WSAPROTOCOL_INFO</c> structures are sent in order.
+	/// <c>send</c> returns after the successor has created all of its sockets, so the caller
+	/// can close its own. If anything failed it returns SOCKET_ERROR and the caller must keep
+	/// serving with its sockets. A listening socket stays open while either process holds it
+	/// and connections waiting in its backlog are accepted by the successor.
+	/// </remarks>
+	class sender {
+		socket<AF::UNIX> s;
+		std::string path;
+	public:
+		sender(const char* _path)
+			: s(SOCK::STREAM, IPPROTO::DEFAULT), path(_path)
+		{
+			::DeleteFileA(path.c_str()); // left over from a crash
+			if (0 != s.bind(unix_addr(path.c_str())) || 0 != s.listen(1)) {
+				throw std::runtime_error("winsock::handoff::sender failed");
+			}
+		}
+		sender(const sender&) = delete;
+		sender& operator=(const sender&) = delete;
+		~sender()
+		{
+			::DeleteFileA(path.c_str());
+		}
+
+		/// Readable when a successor is waiting, e.g. in an event_loop.
+		operator ::SOCKET() const
+		{
+			return s;
+		}
+
+		/// <summary>
+		/// Wait for a successor and hand it sockets.
+		/// </summary>
+		/// <returns>number of sockets handed off or SOCKET_ERROR</returns>
+		int send(const std::vector<::SOCKET>& sockets) const
+		{
+			socket<AF::UNIX> c = s.accept();
+			if (INVALID_SOCKET == c) {
+				return SOCKET_ERROR;
+			}
+
+			DWORD pid;
+			if (!recv_all(c, &pid, sizeof(pid))) {
+				return SOCKET_ERROR;
+			}
+
+			uint32_t n = static_cast<uint32_t>(sockets.size());
+			if (!send_all(c, &n, sizeof(n))) {
+				return SOCKET_ERROR;
+			}
+			for (::SOCKET h : sockets) {
+				WSAPROTOCOL_INFO info;
+				if (0 != ::WSADuplicateSocket(h, pid, &info)) {
+					return SOCKET_ERROR;
+				}
+				if (!send_all(c, &info, sizeof(info))) {
+					return SOCKET_ERROR;
+				}
+			}
+
+			// successor has its sockets
+			ACK ack = ACK::FAILED;
+			if (!recv_all(c, &ack, 1) || ACK::OK != ack) {
+				return SOCKET_ERROR;
+			}
+
+			return static_cast<int>(n);
+		}
+	};
+
+	/// <summary>
+	/// New process that takes over the sockets of the process it replaces.
+	/// </summary>
+	/// <remarks>
+	/// If nothing is listening on <c>path</c> this is the first process and
+	/// <c>receive</c> returns no sockets, so the caller creates its own.
+	/// </remarks>
+	class receiver {
+		socket<AF::UNIX> s;
+		bool connected;
+
+		// protocol info of each socket in the order they were sent, false if any is missing
+		bool protocol_info(std::vector<WSAPROTOCOL_INFO>& infos)
+		{
+			DWORD pid = ::GetCurrentProcessId();
+			uint32_t n;
+			if (!send_all(s, &pid, sizeof(pid)) || !recv_all(s, &n, sizeof(n))) {
+				return false;
+			}
+			infos.resize(n);
+			for (auto& info : infos) {
+				if (!recv_all(s, &info, sizeof(info))) {
+					return false;
+				}
+			}
+
+			return true;
+		}
+	public:
+		receiver(const char* path)
+			: s(SOCK::STREAM, IPPROTO::DEFAULT), connected(false)
+		{
+			connected = 0 == s.connect(unix_addr(path));
+		}
+		receiver(const receiver&) = delete;
+		receiver& operator=(const receiver&) = delete;
+		~receiver()
+		{ }
+
+		/// Create sockets of type S, e.g. <c>tcp::server::socket&lt;af&gt;</c>, then
+		/// tell the sender it can close its own. Only when every socket was created,
+		/// otherwise none are returned and the sender is told to keep its sockets.
+		template<class S = winsock::socket<>>
+		std::vector<S> receive()
+		{
+			std::vector<S> sockets;
+
+			if (!connected) {
+				return sockets;
+			}
+			connected = false; // only once
+
+			std::vector<WSAPROTOCOL_INFO> infos;
+			bool ok = protocol_info(infos);
+			for (size_t i = 0; ok && i < infos.size(); ++i) {
+				sockets.emplace_back(infos[i]);
+				ok = INVALID_SOCKET != static_cast<::SOCKET>(sockets.back());
+			}
+			ok = ok && sockets.size() == infos.size();
+
+			ACK ack = ok ? ACK::OK : ACK::FAILED;
+			if (!send_all(s, &ack, 1) || !ok) {
+				sockets.clear();
+			}
+
+			return sockets;
+		}
+	};
+
+}
@@ -0,0 +1,143 @@
+// winsock_handoff.t.cpp - test passing sockets to a successor
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <optional>
+#include <thread>
+#include "winsock_handoff.h"
+
+using namespace winsock;
+
+// run before the tests of other files so a successor only does its part
+#pragma warning(disable: 4073)
+#pragma init_seg(lib)
+
+static const char* successor_arg = "--handoff-successor";
+
+// Successor process started by test_handoff. Takes over the listener, accepts every
+// connection made during the restart, and exits with how many there were.
+int handoff_successor()
+{
+	if (nullptr == strstr(::GetCommandLineA(), successor_arg)) {
+		return 0;
+	}
+
+	handoff::receiver r(temp_path("winsock_handoff.t.sock").c_str());
+	std::vector<tcp::server::socket<>> got = r.receive<tcp::server::socket<>>();
+	if (1 != got.size()) {
+		::ExitProcess(~0u);
+	}
+	DWORD accepted = 0;
+	while (true) {
+		winsock::socket<> s = got[0].accept();
+		char c;
+		if (INVALID_SOCKET == s || 1 != s.recv(&c, 1)) {
+			::ExitProcess(~0u);
+		}
+		if ('q' == c) {
+			break;
+		}
+		++accepted;
+	}
+	::ExitProcess(accepted);
+}
+int handoff_successor_ = handoff_successor();
+
+int test_handoff()
+{
+	std::string path = temp_path("winsock_handoff.t.sock");
+
+	{
+		// first process has no predecessor
+		handoff::receiver r(path.c_str());
+		assert(r.receive<tcp::server::socket<>>().empty());
+	}
+	{
+		// the successor is this program run again, see handoff_successor
+		std::optional<tcp::server::socket<>> old;
+		old.emplace("localhost", "6797");
+		assert(0 == old->listen());
+		handoff::sender snd(path.c_str());
+
+		// connect throughout the restart, nobody accepts until the successor takes over
+		std::atomic<bool> done = false;
+		int connects = 0, refused = 0;
+		std::thread client([&]() {
+			while (!done) {
+				tcp::client::socket<> c(SOCK::STREAM, IPPROTO::TCP);
+				if (0 == c.connect(winsock::sockaddr<>(inaddr<>::loopback, 6797)) && 1 == c.send("x", 1)) {
+					++connects;
+				}
+				else {
+					++refused;
+				}
+				::Sleep(5);
+			}
+		});
+
+		char exe[MAX_PATH];
+		::GetModuleFileNameA(nullptr, exe, MAX_PATH);
+		std::string cmd = std::string("\"") + exe + "\" " + successor_arg;
+		STARTUPINFOA si{ sizeof(si) };
+		PROCESS_INFORMATION pi;
+		assert(::CreateProcessA(nullptr, cmd.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &si, &pi));
+		handle process(pi.hProcess), thread(pi.hThread);
+
+		assert(1 == snd.send({ *old }));
+		old.reset(); // predecessor exits
+		::Sleep(200); // only the successor is listening
+
+		done = true;
+		client.join();
+		tcp::client::socket<> quit(winsock::sockaddr<>(inaddr<>::loopback, 6797));
+		assert(1 == quit.send("q", 1));
+		assert(WAIT_OBJECT_0 == ::WaitForSingleObject(process, 10'000));
+		DWORD accepted = 0;
+		assert(::GetExitCodeProcess(process, &accepted));
+		assert(0 == refused && 0 < connects);
+		assert(static_cast<DWORD>(connects) == accepted);
+	}
+
+	{
+		// a successor that can not create a socket tells the sender to keep it
+		std::optional<tcp::server::socket<>> old;
+		old.emplace("localhost", "6797");
+		handoff::sender snd(path.c_str());
+		std::thread successor([&]() {
+			winsock::socket<AF::UNIX> c(SOCK::STREAM, IPPROTO::DEFAULT);
+			assert(0 == c.connect(unix_addr(path.c_str())));
+			DWORD pid = ::GetCurrentProcessId();
+			uint32_t n;
+			WSAPROTOCOL_INFO info;
+			assert(handoff::send_all(c, &pid, sizeof(pid)) && handoff::recv_all(c, &n, sizeof(n)) && 1 == n);
+			assert(handoff::recv_all(c, &info, sizeof(info)));
+			handoff::ACK ack = handoff::ACK::FAILED;
+			assert(handoff::send_all(c, &ack, 1));
+		});
+		assert(SOCKET_ERROR == snd.send({ *old }));
+		successor.join();
+	}
+	{
+		// a sender with a bad socket, the receiver creates nothing and says so
+		::DeleteFileA(path.c_str());
+		winsock::socket<AF::UNIX> l(SOCK::STREAM, IPPROTO::DEFAULT);
+		assert(0 == l.bind(unix_addr(path.c_str())) && 0 == l.listen(1));
+		std::thread predecessor([&]() {
+			winsock::socket<AF::UNIX> c = l.accept();
+			DWORD pid;
+			uint32_t n = 1;
+			WSAPROTOCOL_INFO info{};
+			assert(handoff::recv_all(c, &pid, sizeof(pid)));
+			assert(handoff::send_all(c, &n, sizeof(n)) && handoff::send_all(c, &info, sizeof(info)));
+			handoff::ACK ack = handoff::ACK::OK;
+			assert(handoff::recv_all(c, &ack, 1) && handoff::ACK::FAILED == ack);
+		});
+		handoff::receiver r(path.c_str());
+		assert(r.receive<tcp::server::socket<>>().empty());
+		predecessor.join();
+		::DeleteFileA(path.c_str());
+	}
+
+	return 0;
+}
+int test_handoff_ = test_handoff();
@@ -0,0 +1,545 @@
+// winsock_http.h - minimal HTTP/1.1 server and client with pipelining
+#pragma once
+#include <emmintrin.h>
+#include <intrin.h>
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <string_view>
+#include <vector>
+#include "winsock_accept.h"
+#include "winsock_write.h"
+
+namespace winsock::http {
+
+	struct header {
+		std::string_view name, value;
+	};
+
+	// fields common to requests and responses, views into the receive buffer
+	struct message {
+		static constexpr size_t max_headers = 32;
+		int minor;             // HTTP/1.minor
+		header headers[max_headers];
+		size_t count;          // of headers
+		size_t content_length;
+		bool keep_alive;
+		std::string_view body;
+
+		// value of header name or empty
+		std::string_view operator[](std::string_view name) const;
+	};
+	struct request : message {
+		std::string_view method, target;
+	};
+	struct response : message {
+		int status;
+		std::string_view reason;
+	};
+
+	// ASCII case insensitive equality
+	inline bool iequals(std::string_view a, std::string_view b)
+	{
+		if (a.size() != b.size()) {
+			return false;
+		}
+		auto lower = [](char c) {
+			return c >= 'A' && c <= 'Z' ? static_cast<char>(c | 0x20) : c;
+		};
+		for (size_t i = 0; i < a.size(); ++i) {
+			if (lower(a[i]) != lower(b[i])) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+	inline std::string_view message::operator[](std::string_view name) const
+	{
+		for (size_t i = 0; i < count; ++i) {
+			if (iequals(headers[i].name, name)) {
+				return headers[i].value;
+			}
+		}
+
+		return {};
+	}
+
+	/// <summary>
+	/// First carriage return in [p, end) or end, 16 bytes at a time with SSE2.
+	/// </summary>
+	inline const char* find_cr(const char* p, const char* end)
+	{
+		const __m128i cr = _mm_set1_epi8('\r');
+
+		for (; end - p >= 16; p += 16) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, cr));
+			if (mask) {
+				unsigned long i;
+				_BitScanForward(&i, static_cast<unsigned long>(mask));
+
+				return p + i;
+			}
+		}
+		while (p < end && *p != '\r') {
+			++p;
+		}
+
+		return p;
+	}
+
+	/// <summary>
+	/// Split the head of a message into lines and parse the header fields.
+	/// </summary>
+	/// <returns>bytes of the message including its body, 0 if incomplete, -1 if malformed</returns>
+	/// The start line is returned in <c>start</c> for the caller to parse.
+	/// Transfer-Encoding is not supported, bodies must have a Content-Length.
+	inline int parse_head(const char* buf, size_t len, std::string_view& start, message& m)
+	{
+		const char* p = buf;
+		const char* end = buf + len;
+		bool close = false, keep = false;
+
+		m.count = 0;
+		m.content_length = 0;
+		for (bool first = true; ; first = false) {
+			const char* eol = find_cr(p, end);
+			if (end - eol < 2) {
+				return 0; // no complete line yet
+			}
+			if (eol[1] != '\n') {
+				return -1;
+			}
+			std::string_view line(p, eol - p);
+			p = eol + 2;
+			if (first) {
+				start = line;
+				continue;
+			}
+			if (line.empty()) {
+				break; // end of head
+			}
+			size_t colon = line.find(':');
+			if (colon == std::string_view::npos || colon == 0 || m.count == message::max_headers) {
+				return -1;
+			}
+			std::string_view name = line.substr(0, colon);
+			std::string_view value = line.substr(colon + 1);
+			while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+				value.remove_prefix(1);
+			}
+			while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+				value.remove_suffix(1);
+			}
+			m.headers[m.count++] = header{ name, value };
+
+			if (iequals(name, "content-length")) {
+				size_t n = 0;
+				if (value.empty() || value.size() > 9) {
+					return -1;
+				}
+				for (char c : value) {
+					if (c < '0' || c > '9') {
+						return -1;
+					}
+					n = 10 * n + static_cast<size_t>(c - '0');
+				}
+				m.content_length = n;
+			}
+			else if (iequals(name, "connection")) {
+				close = iequals(value, "close");
+				keep = iequals(value, "keep-alive");
+			}
+			else if (iequals(name, "transfer-encoding")) {
+				return -1;
+			}
+		}
+		m.keep_alive = m.minor >= 1 ? !close : keep;
+
+		size_t head = static_cast<size_t>(p - buf);
+		if (len - head < m.content_length) {
+			return 0;
+		}
+		m.body = std::string_view(p, m.content_length);
+
+		return static_cast<int>(head + m.content_length);
+	}
+	// parse "HTTP/1.x" at the start of v
+	inline bool parse_version(std::string_view v, int& minor)
+	{
+		if (v.size() != 8 || v.substr(0, 7) != "HTTP/1." || v[7] < '0' || v[7] > '9') {
+			return false;
+		}
+		minor = v[7] - '0';
+
+		return true;
+	}
+
+	/// <summary>
+	/// Parse a request at the start of buf. Strings in r point into buf.
+	/// </summary>
+	/// <returns>bytes of the request, 0 if incomplete, -1 if malformed</returns>
+	inline int parse(const char* buf, size_t len, request& r)
+	{
+		std::string_view start;
+
+		// the version decides keep-alive so peek at the request line first
+		const char* eol = find_cr(buf, buf + len);
+		if (eol == buf + len) {
+			return 0;
+		}
+		start = std::string_view(buf, eol - buf);
+		size_t sp1 = start.find(' ');
+		size_t sp2 = start.rfind(' ');
+		if (sp1 == std::string_view::npos || sp1 == sp2 || sp1 == 0 || sp2 == sp1 + 1) {
+			return -1;
+		}
+		r.method = start.substr(0, sp1);
+		r.target = start.substr(sp1 + 1, sp2 - sp1 - 1);
+		if (!parse_version(start.substr(sp2 + 1), r.minor)) {
+			return -1;
+		}
+
+		return parse_head(buf, len, start, r);
+	}
+	/// Parse a response at the start of buf. Strings in r point into buf.
+	inline int parse(const char* buf, size_t len, response& r)
+	{
+		std::string_view start;
+
+		const char* eol = find_cr(buf, buf + len);
+		if (eol == buf + len) {
+			return 0;
+		}
+		start = std::string_view(buf, eol - buf);
+		// HTTP/1.1 200 OK
+		if (start.size() < 12 || start[8] != ' ' || !parse_version(start.substr(0, 8), r.minor)) {
+			return -1;
+		}
+		r.status = 0;
+		for (char c : start.substr(9, 3)) {
+			if (c < '0' || c > '9') {
+				return -1;
+			}
+			r.status = 10 * r.status + (c - '0');
+		}
+		r.reason = start.size() > 13 ? start.substr(13) : std::string_view{};
+
+		return parse_head(buf, len, start, r);
+	}
+
+	inline const char* reason(int status)
+	{
+		switch (status) {
+		case 200: return "OK";
+		case 204: return "No Content";
+		case 400: return "Bad Request";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 413: return "Content Too Large";
+		case 500: return "Internal Server Error";
+		case 503: return "Service Unavailable";
+		default: return "";
+		}
+	}
+
+	/// Response to one request, written to the connection's write queue.
+	class reply {
+		write_queue& out;
+		bool close;
+		bool sent;
+	public:
+		reply(write_queue& _out, bool _close)
+			: out(_out), close(_close), sent(false)
+		{ }
+
+		bool done() const
+		{
+			return sent;
+		}
+		void send(int status, std::string_view body = {}, std::string_view type = "text/plain")
+		{
+			char head[256];
+			int n = snprintf(head, sizeof(head),
+				"HTTP/1.1 %d %s\r\nContent-Length: %zu\r\nContent-Type: %.*s\r\n%s\r\n",
+				status, reason(status), body.size(), static_cast<int>(type.size()), type.data(),
+				close ? "Connection: close\r\n" : "");
+			if (n < 0 || n >= static_cast<int>(sizeof(head))) {
+				throw std::runtime_error("winsock::http::reply header too long");
+			}
+			out.write(head, n);
+			out.write(body.data(), static_cast<int>(body.size()));
+			sent = true;
+		}
+	};
+
+	/// <summary>
+	/// HTTP/1.1 server on an event loop.
+	/// </summary>
+	/// <remarks>
+	/// Requests are parsed in place in each connection's receive buffer and passed to the
+	/// handler in order, so views in the request are only valid during the call.
+	/// Every complete request in a read is answered before the replies are sent,
+	/// so pipelined requests get their responses in one send.
+	/// Connections stay open unless the client asks to close or sends HTTP/1.0
+	/// without keep-alive. Requests larger than <c>max_request</c> get 413 and are closed.
+	/// </remarks>
+	template<AF af = AF::INET>
+	class server {
+	public:
+		using handler = std::function<void(const request&, reply&)>;
+	private:
+		struct connection {
+			winsock::socket<af> s;
+			std::vector<char> in;
+			size_t head, tail; // unparsed bytes
+			write_queue out;
+			bool closing;
+
+			connection(winsock::socket<af>&& _s, size_t size)
+				: s(std::move(_s)), in(size), head(0), tail(0), out(s), closing(false)
+			{ }
+		};
+		using iterator = typename std::list<connection>::iterator;
+
+		event_loop& loop;
+		::SOCKET listener;
+		handler f;
+		size_t max_request;
+		accept_batch<af> batch;
+		std::list<connection> conns;
+
+		void close(iterator i)
+		{
+			loop.remove(i->s);
+			conns.erase(i);
+		}
+		// answer complete requests
+		void process(connection& c)
+		{
+			c.out.cork();
+			while (!c.closing && c.head < c.tail) {
+				request r;
+				int n = parse(c.in.data() + c.head, c.tail - c.head, r);
+				if (0 == n) {
+					if (c.head == 0 && c.tail == c.in.size() && c.in.size() >= max_request) {
+						reply(c.out, true).send(413);
+						c.closing = true;
+					}
+					break;
+				}
+				if (n < 0) {
+					reply(c.out, true).send(400);
+					c.closing = true;
+					break;
+				}
+				c.head += n;
+				c.closing = !r.keep_alive;
+				reply rep(c.out, c.closing);
+				f(r, rep);
+				if (!rep.done()) {
+					rep.send(500);
+				}
+			}
+			c.out.uncork();
+			if (c.head == c.tail) {
+				c.head = c.tail = 0;
+			}
+		}
+		// false if the connection was closed
+		bool read(iterator i)
+		{
+			connection& c = *i;
+
+			if (c.tail == c.in.size()) {
+				if (c.head > 0) {
+					memmove(c.in.data(), c.in.data() + c.head, c.tail - c.head);
+					c.tail -= c.head;
+					c.head = 0;
+				}
+				else {
+					c.in.resize(std::min(2 * c.in.size(), max_request));
+				}
+			}
+			int n = ::recv(c.s, c.in.data() + c.tail, static_cast<int>(c.in.size() - c.tail), 0);
+			if (0 == n || (SOCKET_ERROR == n && WSAEWOULDBLOCK != ::WSAGetLastError())) {
+				close(i);
+				return false;
+			}
+			if (n > 0) {
+				c.tail += n;
+				process(c);
+			}
+
+			return true;
+		}
+		bool write(iterator i)
+		{
+			if (SOCKET_ERROR == i->out.flush()) {
+				close(i);
+				return false;
+			}
+
+			return true;
+		}
+		// poll for writable only while replies are waiting and stop reading once closing
+		void update(iterator i)
+		{
+			if (i->out.pending()) {
+				loop.modify(i->s, i->closing ? POLLWRNORM : POLLRDNORM | POLLWRNORM);
+			}
+			else if (i->closing) {
+				close(i);
+			}
+			else {
+				loop.modify(i->s, POLLRDNORM);
+			}
+		}
+	public:
+		/// Serve connections accepted from listener, which must be non-blocking, listening, and outlive this.
+		template<class L>
+		server(event_loop& _loop, const L& _listener, handler _f, size_t _max_request = 1 << 20)
+			: loop(_loop), listener(_listener), f(std::move(_f)), max_request(_max_request)
+		{
+			loop.add(listener, POLLRDNORM, [this, &_listener](SHORT) {
+				batch.accept(_listener);
+				for (auto& s : batch.sockets()) {
+					conns.emplace_back(std::move(s), std::min<size_t>(0x4000, max_request));
+					iterator i = std::prev(conns.end());
+					loop.add(i->s, POLLRDNORM, [this, i](SHORT revents) {
+						if (revents & (POLLERR | POLLHUP | POLLNVAL) && !(revents & POLLRDNORM)) {
+							close(i);
+							return;
+						}
+						if (revents & POLLWRNORM && !write(i)) {
+							return;
+						}
+						if (revents & POLLRDNORM && !i->closing && !read(i)) {
+							return;
+						}
+						update(i);
+					});
+				}
+			});
+		}
+		server(const server&) = delete;
+		server& operator=(const server&) = delete;
+		~server()
+		{
+			loop.remove(listener);
+			for (auto& c : conns) {
+				loop.remove(c.s);
+			}
+		}
+
+		// open connections
+		size_t size() const
+		{
+			return conns.size();
+		}
+	};
+
+	/// <summary>
+	/// Blocking HTTP/1.1 client on one keep-alive connection.
+	/// </summary>
+	/// <remarks>
+	/// Queue any number of requests with <c>request</c>, send them together with <c>flush</c>,
+	/// then read the responses in order with <c>response</c>. Views in a response are
+	/// valid until the next call to <c>response</c>.
+	/// </remarks>
+	template<AF af = AF::INET>
+	class client {
+		tcp::client::socket<af> s;
+		std::string host;
+		std::vector<char> in;
+		size_t head, tail, last; // last is the size of the previous response
+		write_queue out;
+	public:
+		client(const char* _host, const char* port, size_t size = 0x4000)
+			: s(_host, port), host(_host), in(size), head(0), tail(0), last(0), out(s)
+		{
+			tcp::tune(s, tcp::PROFILE::LOW_LATENCY);
+		}
+		client(const client&) = delete;
+		client& operator=(const client&) = delete;
+
+		operator ::SOCKET() const
+		{
+			return s;
+		}
+
+		/// Queue a request.
+		void request(std::string_view method, std::string_view target, std::string_view body = {})
+		{
+			char head_[512];
+			int n = snprintf(head_, sizeof(head_), "%.*s %.*s HTTP/1.1\r\nHost: %s\r\n",
+				static_cast<int>(method.size()), method.data(), static_cast<int>(target.size()), target.data(), host.c_str());
+			if (n < 0 || n >= static_cast<int>(sizeof(head_))) {
+				throw std::runtime_error("winsock::http::client request line too long");
+			}
+			out.write(head_, n);
+			if (!body.empty()) {
+				n = snprintf(head_, sizeof(head_), "Content-Length: %zu\r\n", body.size());
+				out.write(head_, n);
+			}
+			out.write("\r\n", 2);
+			out.write(body.data(), static_cast<int>(body.size()));
+		}
+		/// Send queued requests. Returns false on error.
+		bool flush()
+		{
+			while (out.pending()) {
+				if (SOCKET_ERROR == out.flush()) {
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		/// <summary>
+		/// Receive the next response.
+		/// </summary>
+		/// <returns>false if the connection closed or the response is malformed</returns>
+		bool response(http::response& r)
+		{
+			head += last;
+			last = 0;
+			while (true) {
+				int n = parse(in.data() + head, tail - head, r);
+				if (n > 0) {
+					last = static_cast<size_t>(n);
+					return true;
+				}
+				if (n < 0) {
+					return false;
+				}
+				if (tail == in.size()) {
+					if (head > 0) {
+						memmove(in.data(), in.data() + head, tail - head);
+						tail -= head;
+						head = 0;
+					}
+					else {
+						in.resize(2 * in.size());
+					}
+				}
+				int m = s.recv(in.data() + tail, static_cast<int>(in.size() - tail));
+				if (m <= 0) {
+					return false;
+				}
+				tail += m;
+			}
+		}
+
+		/// Send one request and wait for its response.
+		bool get(std::string_view target, http::response& r)
+		{
+			request("GET", target);
+
+			return flush() && response(r);
+		}
+	};
+
+}
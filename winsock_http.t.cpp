@@ -0,0 +1,102 @@
+// winsock_http.t.cpp - test HTTP parsing, keep-alive, and pipelining
+#include <cassert>
+#include <atomic>
+#include <string>
+#include <thread>
+#include "winsock_http.h"
+
+using namespace winsock;
+
+int test_http_parse()
+{
+	std::string two = "GET /health HTTP/1.1\r\nHost: localhost\r\nX-Request-Id: 42 \r\n\r\n"
+		"POST /metrics HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello";
+	http::request r;
+
+	int n = http::parse(two.data(), two.size(), r);
+	assert(0 < n);
+	assert("GET" == r.method && "/health" == r.target && 1 == r.minor && r.keep_alive);
+	assert(2 == r.count && "42" == r["x-request-id"]);
+	int m = http::parse(two.data() + n, two.size() - n, r);
+	assert(n + m == static_cast<int>(two.size()));
+	assert("POST" == r.method && "hello" == r.body);
+	// points into the buffer
+	assert(two.data() + n + m - 5 == r.body.data());
+
+	// incomplete
+	assert(0 == http::parse(two.data(), 10, r));
+	assert(0 == http::parse(two.data() + n, two.size() - n - 1, r));
+	// malformed
+	std::string bad = "GET / HTTP/1.1\r\nno colon\r\n\r\n";
+	assert(-1 == http::parse(bad.data(), bad.size(), r));
+	// HTTP/1.0 closes unless asked not to
+	std::string old = "GET / HTTP/1.0\r\n\r\n";
+	assert(0 < http::parse(old.data(), old.size(), r) && !r.keep_alive);
+
+	std::string resp = "HTTP/1.1 404 Not Found\r\nContent-Length: 3\r\n\r\nabc";
+	http::response s;
+	assert(static_cast<int>(resp.size()) == http::parse(resp.data(), resp.size(), s));
+	assert(404 == s.status && "Not Found" == s.reason && "abc" == s.body);
+
+	return 0;
+}
+int test_http_parse_ = test_http_parse();
+
+int test_http_server()
+{
+	tcp::server::socket<> srv("localhost", "6807");
+	srv.listen();
+	srv.nonblocking();
+
+	event_loop loop;
+	size_t requests = 0;
+	http::server<> server(loop, srv, [&requests](const http::request& r, http::reply& rep) {
+		++requests;
+		if ("/health" == r.target) {
+			rep.send(200, "ok");
+		}
+		else if ("POST" == r.method) {
+			rep.send(200, r.body);
+		}
+		else {
+			rep.send(404);
+		}
+	});
+
+	std::atomic<bool> done = false;
+	std::thread client([&done]() {
+		http::client<> c("localhost", "6807");
+		http::response r;
+
+		assert(c.get("/health", r));
+		assert(200 == r.status && "ok" == r.body);
+
+		// pipelined on the same connection, answered in order
+		c.request("GET", "/health");
+		c.request("GET", "/missing");
+		c.request("POST", "/echo", "abc");
+		assert(c.flush());
+		assert(c.response(r) && 200 == r.status);
+		assert(c.response(r) && 404 == r.status);
+		assert(c.response(r) && 200 == r.status && "abc" == r.body);
+
+		// malformed request gets 400 and the connection is closed
+		::send(c, "BAD\r\n\r\n", 7, 0);
+		assert(c.response(r) && 400 == r.status && !r.keep_alive);
+		assert(!c.response(r));
+
+		done = true;
+	});
+	for (int i = 0; i < 500 && !done; ++i) {
+		loop.run_once(10);
+	}
+	client.join();
+	assert(4 == requests);
+	for (int i = 0; i < 10 && server.size(); ++i) {
+		loop.run_once(10);
+	}
+	assert(0 == server.size());
+
+	return 0;
+}
+int test_http_server_ = test_http_server();
@@ -0,0 +1,541 @@
+// winsock_load.h - open loop load generation with latency corrected for coordinated omission
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "winsock_loop.h"
+#include "winsock_timestamp.h"
+
+namespace winsock::load {
+
+	using clock = std::chrono::steady_clock;
+
+	/// <summary>
+	/// Request payloads sent in turn, request i is <c>script[i]</c>.
+	/// </summary>
+	class script {
+		std::vector<std::string> requests;
+	public:
+		script()
+		{ }
+		script(std::initializer_list<std::string_view> rs)
+		{
+			for (auto r : rs) {
+				add(r);
+			}
+		}
+
+		void add(std::string_view r)
+		{
+			requests.emplace_back(r);
+		}
+		size_t size() const
+		{
+			return requests.size();
+		}
+		const std::string& operator[](size_t i) const
+		{
+			return requests[i % requests.size()];
+		}
+
+		/// <summary>
+		/// Read requests separated by lines holding only <c>%%</c>.
+		/// </summary>
+		/// <remarks>
+		/// The bytes of each request are sent as they are in the file, including the line
+		/// ending before the separator, so an HTTP request saved with CRLF works as is.
+		/// </remarks>
+		static script read(const char* file)
+		{
+			std::ifstream in(file, std::ios::binary);
+			if (!in) {
+				throw std::runtime_error("winsock::load::script cannot open file");
+			}
+			std::string text{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+
+			script s;
+			std::string r;
+			for (size_t pos = 0; pos < text.size(); ) {
+				size_t eol = text.find('\n', pos);
+				size_t next = eol == std::string::npos ? text.size() : eol + 1;
+				std::string_view line(text.data() + pos, next - pos);
+				std::string_view body = line;
+				while (!body.empty() && ('\n' == body.back() || '\r' == body.back())) {
+					body.remove_suffix(1);
+				}
+				if ("%%" == body) {
+					if (!r.empty()) {
+						s.add(r);
+					}
+					r.clear();
+				}
+				else {
+					r.append(line);
+				}
+				pos = next;
+			}
+			if (!r.empty()) {
+				s.add(r);
+			}
+			if (0 == s.size()) {
+				throw std::runtime_error("winsock::load::script no requests");
+			}
+
+			return s;
+		}
+	};
+
+	struct options {
+		double rate = 1000; // requests per second over all threads
+		std::chrono::milliseconds duration = std::chrono::seconds(10);
+		std::chrono::milliseconds warmup = std::chrono::seconds(0); // not recorded, part of duration
+		unsigned threads = 1;
+		unsigned connections = 1; // per thread
+		size_t reply = 0; // tcp reply bytes, 0 for the size of the request as from an echo server
+		std::chrono::milliseconds timeout = std::chrono::seconds(1); // unanswered requests are lost
+	};
+
+	/// <summary>
+	/// Latencies and counts of a run.
+	/// </summary>
+	/// <remarks>
+	/// <c>corrected</c> measures from when the schedule said to send a request, so time a
+	/// request spent waiting behind a stalled connection or a slow generator is counted.
+	/// <c>uncorrected</c> measures from when it was sent, which is what a closed loop client
+	/// reports. If <c>lag</c> is large the generator, not the server, could not keep up.
+	/// </remarks>
+	struct report {
+		timestamp::histogram corrected, uncorrected; // nanoseconds
+		uint64_t sent = 0, received = 0, lost = 0, errors = 0;
+		clock::duration lag = clock::duration::zero(); // furthest behind schedule a request was issued
+		double rate = 0; // target
+		double seconds = 0; // recorded
+
+		report& operator+=(const report& r)
+		{
+			corrected += r.corrected;
+			uncorrected += r.uncorrected;
+			sent += r.sent;
+			received += r.received;
+			lost += r.lost;
+			errors += r.errors;
+			lag = std::max(lag, r.lag);
+
+			return *this;
+		}
+
+		/// Print the rates and the latency percentiles in microseconds.
+		void print(FILE* out = stdout) const
+		{
+			auto us = [](const timestamp::histogram& h, double q) {
+				return static_cast<double>(q < 1 ? h.quantile(q) : h.max()) / 1000;
+			};
+
+			fprintf(out, "target %.0f/s achieved %.0f/s sent %llu received %llu lost %llu errors %llu lag %.1f us\n",
+				rate, seconds > 0 ? static_cast<double>(received) / seconds : 0., sent, received, lost, errors,
+				std::chrono::duration<double, std::micro>(lag).count());
+			fprintf(out, "%10s %14s %14s\n", "percentile", "corrected us", "uncorrected us");
+			for (double q : { 0.5, 0.75, 0.9, 0.99, 0.999, 0.9999, 1.0 }) {
+				fprintf(out, "%10g %14.1f %14.1f\n", q * 100, us(corrected, q), us(uncorrected, q));
+			}
+		}
+	};
+
+	// a request waiting for its reply
+	struct pending {
+		clock::time_point scheduled; // when the schedule said to send it
+		clock::time_point sent;      // when its last byte was handed to the stack
+		size_t end;    // stream position after the request
+		size_t reply;  // bytes expected back
+		bool measured; // after the warmup
+	};
+
+	/// <summary>
+	/// Schedule and measurements of one thread.
+	/// </summary>
+	/// <remarks>
+	/// Request i is due at start + i / rate and is issued then whether or not earlier
+	/// requests have been answered. Threads are offset so their requests interleave.
+	/// </remarks>
+	class generator {
+		// Sleep and WSAPoll can overshoot by the default timer resolution
+		static constexpr auto slack = std::chrono::milliseconds(16);
+
+		clock::time_point start, measure, end;
+		double interval; // nanoseconds between requests of this thread
+		uint64_t i;
+	protected:
+		const script& requests;
+		const options& opt;
+		unsigned thread;
+		event_loop loop;
+		std::vector<char> buf;
+		report r;
+
+		generator(const script& _s, const options& _opt, unsigned _thread, clock::time_point _start)
+			: requests(_s), opt(_opt), thread(_thread), buf(64 * 1024)
+		{
+			interval = 1e9 * opt.threads / opt.rate;
+			start = _start + std::chrono::nanoseconds(static_cast<int64_t>(interval * thread / opt.threads));
+			measure = _start + opt.warmup;
+			end = _start + opt.duration;
+			i = 0;
+			r.rate = opt.rate;
+			r.seconds = std::chrono::duration<double>(opt.duration - opt.warmup).count();
+		}
+
+		clock::time_point next() const
+		{
+			return start + std::chrono::nanoseconds(static_cast<int64_t>(interval * static_cast<double>(i)));
+		}
+		/// Call f(payload, scheduled, measured) for every request that is due.
+		template<class F>
+		void issue(clock::time_point now, F f)
+		{
+			for (clock::time_point at; (at = next()) <= now && at < end; ++i) {
+				r.lag = std::max(r.lag, now - at);
+				bool measured = at >= measure;
+				if (measured) {
+					++r.sent;
+				}
+				f(requests[i * opt.threads + thread], at, measured);
+			}
+		}
+		void record(const pending& p, clock::time_point now)
+		{
+			if (p.measured) {
+				++r.received;
+				r.corrected.add(static_cast<uint64_t>(std::chrono::nanoseconds(now - p.scheduled).count()));
+				r.uncorrected.add(static_cast<uint64_t>(std::chrono::nanoseconds(now - p.sent).count()));
+			}
+		}
+		// every request has been issued and answered or timed out
+		bool finished(clock::time_point now, bool outstanding) const
+		{
+			return next() >= end && (!outstanding || now >= end + opt.timeout);
+		}
+		// milliseconds to wait for replies before the next request is due, spinning near it
+		int wait(clock::time_point now) const
+		{
+			auto until = next() < end ? next() : end + opt.timeout;
+			if (until - now <= 2 * slack) {
+				return 0;
+			}
+
+			return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(until - now - slack).count());
+		}
+	};
+
+	/// <summary>
+	/// Pipelined requests over tcp connections, replies are matched in order.
+	/// </summary>
+	template<AF af = AF::INET>
+	class tcp_generator : public generator {
+		struct conn {
+			tcp::client::socket<af> s;
+			std::string out;
+			size_t off;     // of out sent
+			size_t written; // bytes sent
+			size_t unsent;  // requests at the back of q not completely sent
+			size_t got;     // of the reply to q.front()
+			std::deque<pending> q;
+			bool dead;
+
+			conn(const char* host, const char* port)
+				: s(SOCK::STREAM, IPPROTO::TCP), off(0), written(0), unsent(0), got(0), dead(false)
+			{
+				if (SOCKET_ERROR == s.connect(host, port)) {
+					throw std::runtime_error("winsock::load::tcp_generator connect failed");
+				}
+				s.tune(tcp::PROFILE::LOW_LATENCY);
+				s.nonblocking();
+			}
+		};
+		std::deque<conn> conns;
+
+		void fail(conn& c)
+		{
+			c.dead = true;
+			c.unsent = 0;
+			loop.remove(c.s);
+			for (const auto& p : c.q) {
+				if (p.measured) {
+					++r.errors;
+				}
+			}
+			c.q.clear();
+		}
+		void flush(conn& c, clock::time_point now)
+		{
+			while (c.off < c.out.size()) {
+				int n = c.s.send(c.out.data() + c.off, static_cast<int>(std::min(c.out.size() - c.off, size_t(1) << 20)));
+				if (SOCKET_ERROR == n) {
+					if (WSAEWOULDBLOCK != ::WSAGetLastError()) {
+						fail(c);
+						return;
+					}
+					break;
+				}
+				c.off += static_cast<size_t>(n);
+				c.written += static_cast<size_t>(n);
+			}
+			for (size_t k = c.q.size() - c.unsent; c.unsent && c.q[k].end <= c.written; ++k, --c.unsent) {
+				c.q[k].sent = now;
+			}
+			bool more = c.off < c.out.size();
+			if (!more) {
+				c.out.clear();
+				c.off = 0;
+			}
+			loop.modify(c.s, more ? POLLRDNORM | POLLWRNORM : POLLRDNORM);
+		}
+		void read(conn& c, clock::time_point now)
+		{
+			while (true) {
+				int n = c.s.recv(buf.data(), static_cast<int>(buf.size()));
+				if (n <= 0) {
+					if (0 == n || WSAEWOULDBLOCK != ::WSAGetLastError()) {
+						fail(c);
+					}
+					return;
+				}
+				for (size_t m = static_cast<size_t>(n); m && !c.q.empty(); ) {
+					pending& p = c.q.front();
+					size_t take = std::min(m, p.reply - c.got);
+					c.got += take;
+					m -= take;
+					if (c.got == p.reply) {
+						record(p, now);
+						c.q.pop_front();
+						c.got = 0;
+						c.unsent = std::min(c.unsent, c.q.size());
+					}
+				}
+				if (static_cast<size_t>(n) < buf.size()) {
+					return;
+				}
+			}
+		}
+	public:
+		// connect before the run starts
+		tcp_generator(const char* host, const char* port, const script& _s, const options& _opt, unsigned _thread, clock::time_point _start)
+			: generator(_s, _opt, _thread, _start)
+		{
+			for (unsigned k = 0; k < opt.connections; ++k) {
+				conns.emplace_back(host, port);
+			}
+		}
+
+		report run()
+		{
+			for (auto& c : conns) {
+				loop.add(c.s, POLLRDNORM, [this, &c](SHORT revents) {
+					auto now = clock::now();
+					if (revents & ~POLLWRNORM) {
+						read(c, now);
+					}
+					if (!c.dead && (revents & POLLWRNORM)) {
+						flush(c, now);
+					}
+				});
+			}
+			std::this_thread::sleep_until(next());
+
+			for (size_t k = 0; ; ) {
+				auto now = clock::now();
+				issue(now, [this, &k](const std::string& req, clock::time_point at, bool measured) {
+					conn& c = conns[k++ % conns.size()];
+					if (c.dead) {
+						if (measured) {
+							++r.errors;
+						}
+						return;
+					}
+					c.out.append(req);
+					++c.unsent;
+					c.q.push_back(pending{ at, at, c.written + c.out.size() - c.off, opt.reply ? opt.reply : req.size(), measured });
+				});
+				bool outstanding = false;
+				for (auto& c : conns) {
+					if (!c.dead && c.off < c.out.size()) {
+						flush(c, now);
+					}
+					outstanding = outstanding || !c.q.empty();
+				}
+				if (finished(now, outstanding)) {
+					break;
+				}
+				loop.run_once(wait(now));
+			}
+
+			for (const auto& c : conns) {
+				for (const auto& p : c.q) {
+					if (p.measured) {
+						++r.lost;
+					}
+				}
+			}
+
+			return r;
+		}
+	};
+
+	/// <summary>
+	/// One datagram per request, any datagram received is the reply to the oldest request.
+	/// </summary>
+	/// <remarks>
+	/// Requests not answered within <c>timeout</c> are lost and no longer matched,
+	/// so a lost reply inflates latency only until then.
+	/// </remarks>
+	template<AF af = AF::INET>
+	class udp_generator : public generator {
+		struct conn {
+			udp::client::socket<af> s;
+			std::deque<pending> q;
+			bool bound; // by the first sendto, polled from then on
+
+			conn()
+				: bound(false)
+			{
+				s.nonblocking();
+			}
+		};
+		sockaddr<af> to;
+		std::deque<conn> conns;
+
+		void expire(conn& c, clock::time_point now)
+		{
+			while (!c.q.empty() && now - c.q.front().sent > opt.timeout) {
+				if (c.q.front().measured) {
+					++r.lost;
+				}
+				c.q.pop_front();
+			}
+		}
+		void read(conn& c, clock::time_point now)
+		{
+			sockaddr<af> from;
+			while (true) {
+				int n = c.s.recvfrom(from, buf.data(), static_cast<int>(buf.size()));
+				if (SOCKET_ERROR == n) {
+					// WSAECONNRESET is an ICMP port unreachable for an earlier datagram
+					if (WSAECONNRESET == ::WSAGetLastError()) {
+						++r.errors;
+						continue;
+					}
+					return;
+				}
+				expire(c, now);
+				if (!c.q.empty()) {
+					record(c.q.front(), now);
+					c.q.pop_front();
+				}
+			}
+		}
+	public:
+		udp_generator(const sockaddr<af>& _to, const script& _s, const options& _opt, unsigned _thread, clock::time_point _start)
+			: generator(_s, _opt, _thread, _start), to(_to), conns(_opt.connections)
+		{ }
+
+		report run()
+		{
+			std::this_thread::sleep_until(next());
+
+			for (size_t k = 0; ; ) {
+				auto now = clock::now();
+				issue(now, [this, &k, now](const std::string& req, clock::time_point at, bool measured) {
+					conn& c = conns[k++ % conns.size()];
+					if (SOCKET_ERROR == c.s.sendto(to, req.data(), static_cast<int>(req.size()))) {
+						if (measured) {
+							++r.errors;
+						}
+						return;
+					}
+					c.q.push_back(pending{ at, now, 0, 0, measured });
+					if (!c.bound) {
+						c.bound = true;
+						loop.add(c.s, POLLRDNORM, [this, &c](SHORT) {
+							read(c, clock::now());
+						});
+					}
+				});
+				bool outstanding = false;
+				for (auto& c : conns) {
+					expire(c, now);
+					outstanding = outstanding || !c.q.empty();
+				}
+				if (finished(now, outstanding)) {
+					break;
+				}
+				loop.run_once(wait(now));
+			}
+
+			for (const auto& c : conns) {
+				for (const auto& p : c.q) {
+					if (p.measured) {
+						++r.lost;
+					}
+				}
+			}
+
+			return r;
+		}
+	};
+
+	/// <summary>
+	/// Run opt.threads generators and combine their reports.
+	/// </summary>
+	/// <remarks>
+	/// Each generator is made on the calling thread, so connection failures throw from here,
+	/// and runs on its own thread from a common start time.
+	/// </remarks>
+	template<class G, class... Args>
+	inline report run(const script& s, const options& opt, const Args&... args)
+	{
+		if (0 == s.size() || opt.rate <= 0 || 0 == opt.threads || 0 == opt.connections) {
+			throw std::invalid_argument("winsock::load::run invalid options");
+		}
+		auto start = clock::now() + std::chrono::milliseconds(100);
+		std::deque<G> gens;
+		for (unsigned t = 0; t < opt.threads; ++t) {
+			gens.emplace_back(args..., s, opt, t, start);
+		}
+
+		std::vector<report> rs(opt.threads);
+		std::vector<std::thread> ts;
+		for (unsigned t = 0; t < opt.threads; ++t) {
+			ts.emplace_back([&rs, &gens, t]() { rs[t] = gens[t].run(); });
+		}
+		for (auto& t : ts) {
+			t.join();
+		}
+
+		report r = rs[0];
+		for (unsigned t = 1; t < opt.threads; ++t) {
+			r += rs[t];
+		}
+
+		return r;
+	}
+	template<AF af = AF::INET>
+	inline report run_tcp(const char* host, const char* port, const script& s, const options& opt)
+	{
+		return run<tcp_generator<af>>(s, opt, host, port);
+	}
+	template<AF af = AF::INET>
+	inline report run_udp(const sockaddr<af>& to, const script& s, const options& opt)
+	{
+		return run<udp_generator<af>>(s, opt, to);
+	}
+
+}
@@ -0,0 +1,133 @@
+// winsock_load.t.cpp - test open loop load generation
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include "winsock_load.h"
+
+using namespace winsock;
+using namespace std::chrono_literals;
+
+int test_load_script()
+{
+	const char* file = "winsock_load.t.txt";
+	std::ofstream(file, std::ios::binary) << "GET / HTTP/1.1\r\nHost: x\r\n\r\n%%\r\nabc\n%%\n%%\n";
+	load::script s = load::script::read(file);
+	std::remove(file);
+	assert(2 == s.size());
+	assert("GET / HTTP/1.1\r\nHost: x\r\n\r\n" == s[0]);
+	assert("abc\n" == s[1] && s[1] == s[3]);
+
+	try {
+		load::script::read(file);
+		assert(false);
+	}
+	catch (const std::runtime_error&) { }
+
+	return 0;
+}
+int test_load_script_ = test_load_script();
+
+// echo n connections, sleeping once for stall after stall_at bytes
+static std::thread tcp_echo(tcp::server::socket<>& srv, unsigned n, size_t stall_at = 0, std::chrono::milliseconds stall = 0ms)
+{
+	return std::thread([&srv, n, stall_at, stall]() {
+		std::vector<std::thread> ts;
+		for (unsigned i = 0; i < n; ++i) {
+			ts.emplace_back([s = srv.accept(), stall_at, stall]() {
+				char buf[4096];
+				size_t total = 0;
+				int len;
+				while (0 < (len = s.recv(buf, sizeof(buf)))) {
+					if (stall_at && total < stall_at && total + static_cast<size_t>(len) >= stall_at) {
+						std::this_thread::sleep_for(stall);
+					}
+					total += static_cast<size_t>(len);
+					s.send(buf, len);
+				}
+			});
+		}
+		for (auto& t : ts) {
+			t.join();
+		}
+	});
+}
+
+int test_load_tcp()
+{
+	tcp::server::socket<> srv("localhost", "6819");
+	srv.listen();
+	load::script s{ "hello", "world!" };
+
+	{
+		load::options opt;
+		opt.rate = 2000;
+		opt.duration = 500ms;
+		opt.warmup = 100ms;
+		opt.threads = 2;
+		opt.connections = 2;
+		std::thread echo = tcp_echo(srv, opt.threads * opt.connections);
+		load::report r = load::run_tcp("localhost", "6819", s, opt);
+		echo.join();
+
+		assert(798 <= r.sent && r.sent <= 802); // 2000/s for 400 ms
+		assert(r.sent == r.received && 0 == r.lost && 0 == r.errors);
+		assert(r.received == r.corrected.count());
+		assert(r.uncorrected.quantile(0.5) <= r.corrected.quantile(0.5));
+	}
+	{
+		// requests keep being scheduled while the server stalls, so they all see the stall
+		load::options opt;
+		opt.rate = 1000;
+		opt.duration = 1s;
+		std::thread echo = tcp_echo(srv, 1, 300 * 5, 200ms);
+		load::report r = load::run_tcp("localhost", "6819", s, opt);
+		echo.join();
+
+		assert(r.sent == r.received);
+		assert(r.corrected.quantile(0.9) > 50'000'000);
+		assert(r.corrected.max() >= 190'000'000);
+	}
+
+	return 0;
+}
+int test_load_tcp_ = test_load_tcp();
+
+int test_load_udp()
+{
+	winsock::sockaddr<> sa(inaddr<>::loopback, 6820);
+	udp::server::socket<> srv(sa);
+	std::thread echo([&srv]() {
+		char buf[1500];
+		winsock::sockaddr<> from;
+		int len;
+		while (0 < (len = srv.recvfrom(from, buf, sizeof(buf)))) {
+			if (4 == len && 0 == memcmp(buf, "quit", 4)) {
+				break;
+			}
+			srv.sendto(from, buf, len);
+		}
+	});
+	load::script s{ "ping" };
+	load::options opt;
+	opt.rate = 1000;
+	opt.duration = 300ms;
+	opt.connections = 2;
+	opt.timeout = 50ms;
+
+	load::report r = load::run_udp(sa, s, opt);
+	assert(299 <= r.sent && r.sent <= 301);
+	assert(r.sent == r.received && 0 == r.lost);
+
+	udp::client::socket<> quit;
+	quit.sendto(sa, "quit", 4);
+	echo.join();
+
+	// nobody listening, every request is lost
+	r = load::run_udp(winsock::sockaddr<>(inaddr<>::loopback, 6821), s, opt);
+	assert(0 < r.sent && 0 == r.received && r.sent == r.lost);
+
+	return 0;
+}
+int test_load_udp_ = test_load_udp();
@@ -0,0 +1,185 @@
+// winsock_loop.h - WSAPoll readiness loop with timers
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "winsock_timer.h"
+#include "winsock_socket.h"
+
+namespace winsock {
+
+	/// <summary>
+	/// Single threaded readiness loop over WSAPoll with a timer wheel for deadlines.
+	/// </summary>
+	/// <remarks>
+	/// Sockets should be put in non-blocking mode before they are added.
+	/// Each pass runs the idle handlers, waits for readiness no longer than the next
+	/// timer deadline, calls the handler of every ready socket, then expires timers.
+	/// Handlers may add and remove sockets and arm timers while the loop is dispatching.
+	/// </remarks>
+	class event_loop {
+	public:
+		using handler = std::function<void(SHORT revents)>;
+	private:
+		std::vector<WSAPOLLFD> fds;
+		std::vector<handler> handlers;
+		std::vector<std::pair<WSAPOLLFD, handler>> added; // while dispatching
+		std::vector<std::function<void()>> idlers;
+		timer_wheel wheel;
+		bool dispatching, removed, stopped;
+
+		size_t find(::SOCKET s) const
+		{
+			auto i = std::find_if(fds.begin(), fds.end(), [s](const WSAPOLLFD& fd) { return fd.fd == s; });
+
+			return static_cast<size_t>(i - fds.begin());
+		}
+		void compact()
+		{
+			size_t j = 0;
+			for (size_t i = 0; i < fds.size(); ++i) {
+				if (INVALID_SOCKET != fds[i].fd) {
+					if (i != j) {
+						fds[j] = fds[i];
+						handlers[j] = std::move(handlers[i]);
+					}
+					++j;
+				}
+			}
+			fds.resize(j);
+			handlers.resize(j);
+			removed = false;
+		}
+	public:
+		event_loop(timer_wheel::clock::duration resolution = std::chrono::milliseconds(1))
+			: wheel(resolution), dispatching(false), removed(false), stopped(false)
+		{ }
+		event_loop(const event_loop&) = delete;
+		event_loop& operator=(const event_loop&) = delete;
+		~event_loop()
+		{ }
+
+		timer_wheel& timers()
+		{
+			return wheel;
+		}
+		size_t size() const
+		{
+			return fds.size() + added.size();
+		}
+
+		/// Call f(revents) when s is ready for events (POLLRDNORM, POLLWRNORM, ...).
+		void add(::SOCKET s, SHORT events, handler f)
+		{
+			WSAPOLLFD fd{ s, events, 0 };
+
+			if (dispatching) {
+				added.emplace_back(fd, std::move(f));
+			}
+			else {
+				fds.push_back(fd);
+				handlers.push_back(std::move(f));
+			}
+		}
+		/// Change the events s is polled for.
+		void modify(::SOCKET s, SHORT events)
+		{
+			if (size_t i = find(s); i < fds.size()) {
+				fds[i].events = events;
+			}
+			for (auto& [fd, f] : added) {
+				if (fd.fd == s) {
+					fd.events = events;
+				}
+			}
+		}
+		/// Stop polling s. Does not close the socket.
+		void remove(::SOCKET s)
+		{
+			if (size_t i = find(s); i < fds.size()) {
+				fds[i].fd = INVALID_SOCKET; // ignored by WSAPoll
+				removed = true;
+				if (!dispatching) {
+					compact();
+				}
+			}
+			std::erase_if(added, [s](const auto& a) { return a.first.fd == s; });
+		}
+
+		/// Call f after each pass before waiting for readiness, e.g. to flush write queues.
+		void idle(std::function<void()> f)
+		{
+			idlers.push_back(std::move(f));
+		}
+
+		/// Wait at most timeout milliseconds (-1 for no limit) and dispatch.
+		/// Returns the number of sockets dispatched or SOCKET_ERROR.
+		int run_once(int timeout = -1)
+		{
+			for (auto& f : idlers) {
+				f();
+			}
+
+			int next = wheel.timeout();
+			if (next >= 0 && (timeout < 0 || next < timeout)) {
+				timeout = next;
+			}
+
+			int n = 0;
+			if (fds.empty()) {
+				// WSAPoll fails with WSAEINVAL on an empty set
+				if (timeout < 0) {
+					return 0;
+				}
+				::Sleep(static_cast<DWORD>(timeout));
+			}
+			else {
+				n = ::WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeout);
+				if (SOCKET_ERROR == n) {
+					return n;
+				}
+			}
+
+			dispatching = true;
+			int m = 0;
+			for (size_t i = 0; m < n && i < fds.size(); ++i) {
+				if (INVALID_SOCKET != fds[i].fd && fds[i].revents) {
+					++m;
+					handlers[i](std::exchange(fds[i].revents, SHORT(0)));
+				}
+			}
+			wheel.advance();
+			dispatching = false;
+
+			if (removed) {
+				compact();
+			}
+			for (auto& [fd, f] : added) {
+				fds.push_back(fd);
+				handlers.push_back(std::move(f));
+			}
+			added.clear();
+
+			return m;
+		}
+		/// Run until stop is called or polling fails.
+		int run()
+		{
+			int ret = 0;
+
+			stopped = false;
+			while (!stopped && SOCKET_ERROR != (ret = run_once())) {
+				if (fds.empty() && 0 == wheel.size()) {
+					break;
+				}
+			}
+
+			return ret;
+		}
+		void stop()
+		{
+			stopped = true;
+		}
+	};
+
+}
@@ -0,0 +1,214 @@
+// winsock_multicast.h - UDP multicast senders and receivers
+#pragma once
+#include "winsock_socket.h"
+#include <iphlpapi.h>
+
+#pragma comment(lib, "Iphlpapi.lib")
+
+namespace winsock::udp::multicast {
+
+	// How multicast interfaces are named: an address for IPv4, an index for IPv6.
+	template<AF af> struct traits { };
+	template<>
+	struct traits<AF::INET> {
+		typedef IN_ADDR interface_type;
+		inline static const IN_ADDR any = in4addr_any;
+	};
+	template<>
+	struct traits<AF::INET6> {
+		typedef ULONG interface_type;
+		inline static const ULONG any = 0;
+	};
+
+	/// Join group on iface.
+	inline int join(::SOCKET s, const IN_ADDR& group, const IN_ADDR& iface = in4addr_any)
+	{
+		return sockopt<IP_OPT::ADD_MEMBERSHIP>(s, ip_mreq{ group, iface });
+	}
+	inline int join(::SOCKET s, const IN6_ADDR& group, ULONG iface = 0)
+	{
+		return sockopt<IPV6_OPT::ADD_MEMBERSHIP>(s, ipv6_mreq{ group, iface });
+	}
+	inline int leave(::SOCKET s, const IN_ADDR& group, const IN_ADDR& iface = in4addr_any)
+	{
+		return sockopt<IP_OPT::DROP_MEMBERSHIP>(s, ip_mreq{ group, iface });
+	}
+	inline int leave(::SOCKET s, const IN6_ADDR& group, ULONG iface = 0)
+	{
+		return sockopt<IPV6_OPT::DROP_MEMBERSHIP>(s, ipv6_mreq{ group, iface });
+	}
+	/// Source specific multicast, IPv4 only.
+	inline int join_source(::SOCKET s, const IN_ADDR& group, const IN_ADDR& source, const IN_ADDR& iface = in4addr_any)
+	{
+		return sockopt<IP_OPT::ADD_SOURCE_MEMBERSHIP>(s, ip_mreq_source{ group, source, iface });
+	}
+	inline int leave_source(::SOCKET s, const IN_ADDR& group, const IN_ADDR& source, const IN_ADDR& iface = in4addr_any)
+	{
+		return sockopt<IP_OPT::DROP_SOURCE_MEMBERSHIP>(s, ip_mreq_source{ group, source, iface });
+	}
+
+	/// <summary>
+	/// Socket subscribed to any number of multicast groups on one port.
+	/// </summary>
+	/// <remarks>
+	/// The socket is bound to the wildcard address with SO_REUSEADDR so several processes
+	/// can receive the same groups. <c>recv</c> uses IP_PKTINFO to report the group each
+	/// datagram was sent to. Give it a large <c>rcvbuf</c> for high rate feeds.
+	/// Windows has no SO_RXQ_OVFL so <c>drops</c> is the increase in the UDP receive
+	/// errors of the address family since the socket was created. It counts datagrams
+	/// discarded because a receive buffer was full on any socket of the host.
+	/// </remarks>
+	template<AF af = AF::INET>
+	class receiver : private winsock::socket<af> {
+		using interface_type = typename traits<af>::interface_type;
+		using addr_type = typename inaddr<af>::addr_type;
+		DWORD errors;
+
+		static DWORD in_errors()
+		{
+			MIB_UDPSTATS stats;
+
+			if (NO_ERROR != ::GetUdpStatisticsEx(&stats, static_cast<ULONG>(af))) {
+				return 0;
+			}
+
+			return stats.dwInErrors;
+		}
+	public:
+		using winsock::socket<af>::operator ::SOCKET;
+		using winsock::socket<af>::nonblocking;
+		using winsock::socket<af>::recvfrom;
+		using winsock::socket<af>::recvmsg;
+
+		receiver(unsigned short port, int rcvbuf = 0)
+			: winsock::socket<af>(SOCK::DGRAM, IPPROTO::UDP), errors(in_errors())
+		{
+			sockopt<SET_SO::REUSEADDR>(*this, true);
+			if (rcvbuf) {
+				sockopt<SET_SO::RCVBUF>(*this, rcvbuf);
+			}
+			if constexpr (AF::INET == af) {
+				sockopt<IP_OPT::PKTINFO>(*this, TRUE);
+			}
+			else {
+				sockopt<IPV6_OPT::PKTINFO>(*this, TRUE);
+			}
+			if (0 != winsock::socket<af>::bind(sockaddr<af>(port))) {
+				throw std::runtime_error("winsock::udp::multicast::receiver bind failed");
+			}
+		}
+
+		int join(const addr_type& group, const interface_type& iface = traits<af>::any) const
+		{
+			return multicast::join(*this, group, iface);
+		}
+		int leave(const addr_type& group, const interface_type& iface = traits<af>::any) const
+		{
+			return multicast::leave(*this, group, iface);
+		}
+		int join_source(const IN_ADDR& group, const IN_ADDR& source, const IN_ADDR& iface = in4addr_any) const
+		{
+			return multicast::join_source(*this, group, source, iface);
+		}
+		int leave_source(const IN_ADDR& group, const IN_ADDR& source, const IN_ADDR& iface = in4addr_any) const
+		{
+			return multicast::leave_source(*this, group, source, iface);
+		}
+
+		/// Receive a datagram from any joined group. Returns bytes received or SOCKET_ERROR.
+		/// group is the unspecified address if the datagram carried no packet info.
+		int recv(char* buf, int len, sockaddr<af>& from, addr_type& group) const
+		{
+			char control[WSA_CMSG_SPACE(sizeof(IN6_PKTINFO))];
+			WSABUF data{ static_cast<ULONG>(len), buf };
+			WSAMSG msg;
+
+			memset(&msg, 0, sizeof(msg));
+			msg.name = &from;
+			msg.namelen = from.len;
+			msg.lpBuffers = &data;
+			msg.dwBufferCount = 1;
+			msg.Control = WSABUF{ sizeof(control), control };
+
+			int ret = recvmsg(msg);
+			if (SOCKET_ERROR == ret) {
+				return ret;
+			}
+			from.len = msg.namelen;
+			group = addr_type{};
+			for (WSACMSGHDR* c = WSA_CMSG_FIRSTHDR(&msg); c; c = WSA_CMSG_NXTHDR(&msg, c)) {
+				if constexpr (AF::INET == af) {
+					if (IPPROTO_IP == c->cmsg_level && IP_PKTINFO == c->cmsg_type) {
+						group = reinterpret_cast<IN_PKTINFO*>(WSA_CMSG_DATA(c))->ipi_addr;
+					}
+				}
+				else {
+					if (IPPROTO_IPV6 == c->cmsg_level && IPV6_PKTINFO == c->cmsg_type) {
+						group = reinterpret_cast<IN6_PKTINFO*>(WSA_CMSG_DATA(c))->ipi6_addr;
+					}
+				}
+			}
+
+			return ret;
+		}
+
+		/// Datagrams dropped by the host since the receiver was created.
+		DWORD drops() const
+		{
+			return in_errors() - errors;
+		}
+	};
+
+	/// <summary>
+	/// Socket for sending to multicast groups.
+	/// </summary>
+	/// <remarks>
+	/// By default packets do not leave the subnet (TTL 1) and are looped back to
+	/// receivers on the local host.
+	/// </remarks>
+	template<AF af = AF::INET>
+	class sender : private winsock::socket<af> {
+		using interface_type = typename traits<af>::interface_type;
+	public:
+		using winsock::socket<af>::operator ::SOCKET;
+		using winsock::socket<af>::nonblocking;
+		using winsock::socket<af>::sendto;
+
+		sender(DWORD _ttl = 1, bool _loop = true)
+			: winsock::socket<af>(SOCK::DGRAM, IPPROTO::UDP)
+		{
+			ttl(_ttl);
+			loop(_loop);
+		}
+
+		int ttl(DWORD hops) const
+		{
+			if constexpr (AF::INET == af) {
+				return sockopt<IP_OPT::MULTICAST_TTL>(*this, hops);
+			}
+			else {
+				return sockopt<IPV6_OPT::MULTICAST_HOPS>(*this, hops);
+			}
+		}
+		int loop(bool on) const
+		{
+			if constexpr (AF::INET == af) {
+				return sockopt<IP_OPT::MULTICAST_LOOP>(*this, on ? TRUE : FALSE);
+			}
+			else {
+				return sockopt<IPV6_OPT::MULTICAST_LOOP>(*this, on ? TRUE : FALSE);
+			}
+		}
+		/// Outgoing interface.
+		int iface(const interface_type& i) const
+		{
+			if constexpr (AF::INET == af) {
+				return sockopt<IP_OPT::MULTICAST_IF>(*this, i.S_un.S_addr);
+			}
+			else {
+				return sockopt<IPV6_OPT::MULTICAST_IF>(*this, i);
+			}
+		}
+	};
+
+}
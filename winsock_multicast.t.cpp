@@ -0,0 +1,59 @@
+// winsock_multicast.t.cpp - test multicast on the loopback interface
+#include <cassert>
+#include "winsock_multicast.h"
+
+using namespace winsock;
+
+int test_multicast()
+{
+	winsock::sockaddr<> g1("239.255.0.1", 6800), g2("239.255.0.2", 6800), g3("239.255.0.3", 6800);
+	const IN_ADDR lo = inaddr<>::loopback;
+
+	udp::multicast::receiver<> r(6800, 1 << 20);
+	assert(0 == r.join(g1.addr(), lo));
+	assert(0 == r.join(g2.addr(), lo));
+
+	udp::multicast::sender<> s;
+	assert(0 == s.iface(lo));
+	assert(1 == sockopt<IP_OPT::MULTICAST_TTL>(s));
+	assert(1 == sockopt<IP_OPT::MULTICAST_LOOP>(s));
+
+	assert(3 == s.sendto(g1, "abc", 3));
+	assert(3 == s.sendto(g2, "def", 3));
+
+	char buf[16];
+	winsock::sockaddr<> from;
+	IN_ADDR group;
+	// datagrams from both groups arrive on one socket, tagged with their group
+	for (int i = 0; i < 2; ++i) {
+		assert(3 == r.recv(buf, sizeof(buf), from, group));
+		if (0 == strncmp(buf, "abc", 3)) {
+			assert(group.S_un.S_addr == g1.addr().S_un.S_addr);
+		}
+		else {
+			assert(0 == strncmp(buf, "def", 3));
+			assert(group.S_un.S_addr == g2.addr().S_un.S_addr);
+		}
+	}
+	assert(from.addr().S_un.S_addr == lo.S_un.S_addr);
+	assert(static_cast<int>(sizeof(sockaddr_in)) == from.len);
+
+	// not joined, then left
+	assert(0 == r.leave(g2.addr(), lo));
+	r.nonblocking();
+	s.sendto(g2, "ghi", 3);
+	s.sendto(g3, "jkl", 3);
+	Sleep(50);
+	assert(SOCKET_ERROR == r.recv(buf, sizeof(buf), from, group));
+
+	// source specific
+	winsock::sockaddr<> ssm("232.1.1.1", 6800);
+	assert(0 == r.join_source(ssm.addr(), lo, lo));
+	assert(3 == s.sendto(ssm, "mno", 3));
+	Sleep(50);
+	assert(3 == r.recv(buf, sizeof(buf), from, group));
+	assert(0 == r.leave_source(ssm.addr(), lo, lo));
+
+	return 0;
+}
+int test_multicast_ = test_multicast();
@@ -0,0 +1,311 @@
+// winsock_pacing.h - token bucket pacing of udp sends
+#pragma once
+#include <qos2.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+#include "winsock_socket.h"
+
+#pragma comment(lib, "qwave.lib")
+
+namespace winsock {
+
+	/// <summary>
+	/// Token bucket of bytes filled at <c>rate</c> bytes per second up to <c>burst</c> bytes.
+	/// </summary>
+	class token_bucket {
+	public:
+		using clock = std::chrono::steady_clock;
+	private:
+		double rate_, burst_;
+		double tokens;
+		clock::time_point last;
+
+		void refill(clock::time_point now)
+		{
+			std::chrono::duration<double> dt = now - last;
+			tokens = std::min(burst_, tokens + dt.count() * rate_);
+			last = now;
+		}
+	public:
+		token_bucket(double _rate, double _burst)
+			: rate_(_rate), burst_(_burst), tokens(_burst), last(clock::now())
+		{ }
+
+		double rate() const
+		{
+			return rate_;
+		}
+		double burst() const
+		{
+			return burst_;
+		}
+
+		/// Time until n bytes are available, zero if they are now.
+		clock::duration wait(size_t n, clock::time_point now = clock::now())
+		{
+			refill(now);
+			double need = static_cast<double>(n) - tokens;
+			if (need <= 0) {
+				return clock::duration::zero();
+			}
+
+			return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(need / rate_));
+		}
+		/// Take n bytes if available.
+		bool take(size_t n, clock::time_point now = clock::now())
+		{
+			if (wait(n, now) > clock::duration::zero()) {
+				return false;
+			}
+			tokens -= static_cast<double>(n);
+
+			return true;
+		}
+		/// True if the bucket has refilled to a whole burst, like a new one.
+		bool full(clock::time_point now = clock::now())
+		{
+			refill(now);
+
+			return tokens >= burst_;
+		}
+		/// Take n bytes that were waited for, the bucket may go negative.
+		void spend(size_t n)
+		{
+			tokens -= static_cast<double>(n);
+		}
+	};
+
+	/// <summary>
+	/// Block the thread until a deadline with microsecond precision.
+	/// </summary>
+	/// <remarks>
+	/// Sleep has a resolution of the system timer tick, up to 15.6 ms. A high resolution
+	/// waitable timer sleeps until <c>spin</c> before the deadline and the rest is spun.
+	/// </remarks>
+	class precise_wait {
+		handle timer;
+		token_bucket::clock::duration spin;
+	public:
+		precise_wait(token_bucket::clock::duration _spin = std::chrono::microseconds(200))
+			: timer(::CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS)),
+			  spin(_spin)
+		{ }
+		precise_wait(const precise_wait&) = delete;
+		precise_wait& operator=(const precise_wait&) = delete;
+
+		void until(token_bucket::clock::time_point deadline)
+		{
+			auto sleep = deadline - token_bucket::clock::now() - spin;
+			if (sleep > token_bucket::clock::duration::zero()) {
+				// negative due time is relative in 100 ns units
+				LARGE_INTEGER due;
+				due.QuadPart = -std::chrono::duration_cast<std::chrono::duration<LONGLONG, std::ratio<1, 10'000'000>>>(sleep).count();
+				if (timer && ::SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE)) {
+					::WaitForSingleObject(timer, INFINITE);
+				}
+				else {
+					::Sleep(static_cast<DWORD>(std::chrono::duration_cast<std::chrono::milliseconds>(sleep).count()));
+				}
+			}
+			while (token_bucket::clock::now() < deadline) {
+				YieldProcessor();
+			}
+		}
+	};
+
+	namespace udp {
+
+		/// <summary>
+		/// Shape the outgoing rate of a socket to one destination in the stack.
+		/// </summary>
+		/// <remarks>
+		/// Windows has no SO_MAX_PACING_RATE or SO_TXTIME. The closest is the qWAVE flow rate,
+		/// which the packet scheduler enforces per destination without a userspace wait.
+		/// It is not available on every edition, <c>ok</c> tells if it took effect.
+		/// </remarks>
+		template<AF af = AF::INET>
+		class shaper {
+			HANDLE qos;
+			QOS_FLOWID flow;
+			::SOCKET s;
+			bool ok_;
+		public:
+			shaper(::SOCKET _s, const sockaddr<af>& to, uint64_t bytes_per_second)
+				: qos(nullptr), flow(0), s(_s), ok_(false)
+			{
+				QOS_VERSION version{ 1, 0 };
+				if (!::QOSCreateHandle(&version, &qos)) {
+					qos = nullptr;
+					return;
+				}
+				if (!::QOSAddSocketToFlow(qos, s, const_cast<::sockaddr*>(&to), QOSTrafficTypeBestEffort, QOS_NON_ADAPTIVE_FLOW, &flow)) {
+					return;
+				}
+				QOS_FLOWRATE_OUTGOING rate{ 8 * bytes_per_second, QOSShapeOnly, QOSFlowRateNotApplicable };
+				ok_ = ::QOSSetFlow(qos, flow, QOSSetOutgoingRate, sizeof(rate), &rate, 0, nullptr);
+			}
+			shaper(const shaper&) = delete;
+			shaper& operator=(const shaper&) = delete;
+			~shaper()
+			{
+				if (qos) {
+					if (flow) {
+						::QOSRemoveSocketFromFlow(qos, s, flow, 0);
+					}
+					::QOSCloseHandle(qos);
+				}
+			}
+
+			bool ok() const
+			{
+				return ok_;
+			}
+		};
+
+		/// <summary>
+		/// Send datagrams no faster than a token bucket allows.
+		/// </summary>
+		/// <remarks>
+		/// With <c>per_destination</c> each destination address gets its own bucket,
+		/// otherwise all sends from the socket share one. A bucket that has refilled is no
+		/// different from a new one, so full buckets are dropped whenever the number of
+		/// destinations doubles and only those sent to recently take memory.
+		/// <c>sendto</c> waits for tokens. <c>try_sendto</c> fails with WSAEWOULDBLOCK
+		/// instead and <c>ready_in</c> tells when to try again, e.g. to arm a timer in an event_loop.
+		/// A datagram larger than a burst goes out once the bucket is full and leaves it in debt.
+		/// <c>shape</c> also asks the packet scheduler to hold a destination to the rate.
+		/// The socket is not owned.
+		/// </remarks>
+		template<AF af = AF::INET>
+		class pacer {
+			using clock = token_bucket::clock;
+			::SOCKET s;
+			double rate, burst;
+			bool per_destination;
+			token_bucket shared;
+			std::map<sockaddr<af>, token_bucket> buckets;
+			size_t sweep; // destinations at which to drop full buckets
+			std::vector<std::unique_ptr<shaper<af>>> shapers;
+			precise_wait waiter;
+			clock::time_point first, last;
+			size_t run; // bytes sent without waiting
+
+			token_bucket& bucket(const sockaddr<af>& to)
+			{
+				if (!per_destination) {
+					return shared;
+				}
+				auto i = buckets.find(to);
+				if (i == buckets.end()) {
+					if (buckets.size() >= sweep) {
+						clock::time_point now = clock::now();
+						std::erase_if(buckets, [now](auto& b) { return b.second.full(now); });
+						sweep = std::max<size_t>(64, 2 * buckets.size());
+					}
+					i = buckets.emplace(to, token_bucket(rate, burst)).first;
+				}
+
+				return i->second;
+			}
+			// tokens to wait for, a bucket never holds more than a burst
+			size_t need(int len) const
+			{
+				return std::min(static_cast<size_t>(len), static_cast<size_t>(burst));
+			}
+			int send(const sockaddr<af>& to, const char* buf, int len, bool waited)
+			{
+				int ret = ::sendto(s, buf, len, 0, &to, to.len);
+				if (SOCKET_ERROR == ret) {
+					return ret;
+				}
+				clock::time_point now = clock::now();
+				if (0 == datagrams) {
+					first = now;
+				}
+				last = now;
+				++datagrams;
+				bytes += static_cast<size_t>(len);
+				run = waited ? static_cast<size_t>(len) : run + static_cast<size_t>(len);
+				max_burst = std::max(max_burst, run);
+
+				return ret;
+			}
+		public:
+			// counters for reporting
+			size_t datagrams, bytes, waits;
+			size_t max_burst; // most bytes sent back to back without waiting
+
+			/// Pace s to bytes_per_second with bursts of at most burst_bytes.
+			pacer(::SOCKET _s, double bytes_per_second, double burst_bytes, bool _per_destination = false)
+				: s(_s), rate(bytes_per_second), burst(burst_bytes), per_destination(_per_destination),
+				  shared(bytes_per_second, burst_bytes), sweep(64), run(0), datagrams(0), bytes(0), waits(0), max_burst(0)
+			{ }
+			pacer(const pacer&) = delete;
+			pacer& operator=(const pacer&) = delete;
+
+			/// Wait for tokens and send. Returns bytes sent or SOCKET_ERROR.
+			int sendto(const sockaddr<af>& to, const char* buf, int len)
+			{
+				token_bucket& b = bucket(to);
+				clock::time_point now = clock::now();
+				auto d = b.wait(static_cast<size_t>(len), now);
+				bool waited = d > clock::duration::zero();
+				if (waited) {
+					++waits;
+					waiter.until(now + d);
+				}
+				b.spend(static_cast<size_t>(len));
+
+				return send(to, buf, len, waited);
+			}
+			/// Send if tokens are available, otherwise fail with WSAEWOULDBLOCK.
+			int try_sendto(const sockaddr<af>& to, const char* buf, int len)
+			{
+				token_bucket& b = bucket(to);
+				if (b.wait(need(len)) > clock::duration::zero()) {
+					::WSASetLastError(WSAEWOULDBLOCK);
+					return SOCKET_ERROR;
+				}
+				b.spend(static_cast<size_t>(len));
+
+				return send(to, buf, len, false);
+			}
+			// destinations with a bucket
+			size_t destinations() const
+			{
+				return buckets.size();
+			}
+			/// Time until len bytes can be sent to to.
+			clock::duration ready_in(const sockaddr<af>& to, int len)
+			{
+				return bucket(to).wait(need(len));
+			}
+
+			/// Also shape sends to to in the packet scheduler where qWAVE is available.
+			/// Returns true if it took effect. The token bucket still applies.
+			bool shape(const sockaddr<af>& to)
+			{
+				auto sh = std::make_unique<shaper<af>>(s, to, static_cast<uint64_t>(rate));
+				if (!sh->ok()) {
+					return false;
+				}
+				shapers.push_back(std::move(sh));
+
+				return true;
+			}
+
+			/// Bytes per second achieved from the first send to the last.
+			double achieved() const
+			{
+				std::chrono::duration<double> dt = last - first;
+
+				return dt.count() > 0 ? static_cast<double>(bytes) / dt.count() : 0;
+			}
+		};
+
+	}
+
+}
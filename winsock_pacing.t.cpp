@@ -0,0 +1,103 @@
+// winsock_pacing.t.cpp - test token bucket pacing of udp sends
+#include <cassert>
+#include <thread>
+#include <vector>
+#include "winsock_pacing.h"
+
+using namespace winsock;
+
+int test_token_bucket()
+{
+	token_bucket b(1000, 100); // 1000 bytes per second, 100 byte bursts
+	auto now = token_bucket::clock::now();
+
+	assert(b.take(60, now));
+	assert(b.take(40, now));
+	assert(!b.take(10, now));
+	auto d = b.wait(10, now);
+	assert(std::chrono::milliseconds(9) < d && d <= std::chrono::milliseconds(10));
+	assert(b.take(10, now + std::chrono::milliseconds(10)));
+	// never more than a burst
+	assert(!b.take(101, now + std::chrono::seconds(10)));
+
+	return 0;
+}
+int test_token_bucket_ = test_token_bucket();
+
+int test_pacer()
+{
+	const double rate = 1'000'000; // bytes per second
+	const int len = 1000;
+	const size_t n = 300, burst = 10; // datagrams
+
+	winsock::sockaddr<> sa(inaddr<>::loopback, 6809);
+	udp::server::socket<> r(sa);
+	sockopt<SET_SO::RCVBUF>(r, 1 << 20);
+
+	std::vector<token_bucket::clock::time_point> arrived;
+	std::thread receiver([&]() {
+		char buf[1500];
+		winsock::sockaddr<> from;
+		while (arrived.size() < n) {
+			if (0 >= r.recvfrom(from, buf, sizeof(buf))) {
+				break;
+			}
+			arrived.push_back(token_bucket::clock::now());
+		}
+	});
+
+	udp::client::socket<> s;
+	udp::pacer<> p(s, rate, burst * len);
+	char msg[len] = {};
+	for (size_t i = 0; i < n; ++i) {
+		assert(len == p.sendto(sa, msg, len));
+	}
+	receiver.join();
+
+	assert(n == arrived.size());
+	// the first burst goes out at once, tokens refilled while sending may add a little
+	assert(burst * len <= p.max_burst && p.max_burst <= 2 * burst * len);
+	// most sends after it wait, oversleeping may let a few through
+	assert(n / 2 <= p.waits && p.waits <= n - burst);
+	// steady rate after the initial burst
+	std::chrono::duration<double> dt = arrived.back() - arrived[burst];
+	double achieved = static_cast<double>((n - burst - 1) * len) / dt.count();
+	assert(0.9 * rate < achieved && achieved < 1.1 * rate);
+	assert(0.9 * rate < p.achieved());
+
+	// non-blocking
+	assert(SOCKET_ERROR == p.try_sendto(sa, msg, len));
+	assert(WSAEWOULDBLOCK == ::WSAGetLastError());
+	assert(p.ready_in(sa, len) <= std::chrono::milliseconds(1));
+
+	// a datagram larger than a burst is sent from a full bucket
+	udp::pacer<> big(s, rate, len / 2);
+	assert(len == big.try_sendto(sa, msg, len));
+	assert(SOCKET_ERROR == big.try_sendto(sa, msg, len));
+	auto d = big.ready_in(sa, len);
+	assert(token_bucket::clock::duration::zero() < d && d <= std::chrono::milliseconds(2));
+
+	// the packet scheduler may or may not shape, sends work either way
+	{
+		udp::client::socket<> c;
+		bool shaped;
+		{
+			udp::shaper<> sh(c, sa, 1'000'000);
+			shaped = sh.ok();
+			assert(len == c.sendto(sa, msg, len));
+		}
+		udp::pacer<> q(c, rate, burst * len);
+		assert(shaped == q.shape(sa));
+		assert(len == q.sendto(sa, msg, len));
+	}
+
+	// buckets of idle destinations are dropped
+	udp::pacer<> q(s, rate, burst * len, true);
+	for (unsigned short port = 1; port <= 1000; ++port) {
+		assert(q.ready_in(winsock::sockaddr<>(inaddr<>::loopback, port), len) == token_bucket::clock::duration::zero());
+	}
+	assert(0 < q.destinations() && q.destinations() <= 128);
+
+	return 0;
+}
+int test_pacer_ = test_pacer();
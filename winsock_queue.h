@@ -0,0 +1,343 @@
+// winsock_queue.h - bounded queues for handing work between threads
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+#include "winsock_socket.h"
+
+namespace winsock {
+
+	// Keep indices written by different threads on different cache lines.
+	inline constexpr size_t cache_line = 64;
+
+	// uninitialized storage for one element
+	template<class T>
+	struct queue_slot {
+		alignas(T) unsigned char data[sizeof(T)];
+
+		T* get()
+		{
+			return std::launder(reinterpret_cast<T*>(data));
+		}
+	};
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+	/// <summary>
+	/// Bounded lock-free single producer single consumer queue.
+	/// </summary>
+	/// <remarks>
+	/// Capacity is rounded up to a power of two. Elements only need to be movable
+	/// so <c>socket&lt;af&gt;</c> can be handed from one thread to another.
+	/// The producer and consumer each keep a cached copy of the other index so
+	/// the shared cache line is only read when the queue looks full or empty.
+	/// </remarks>
+	template<class T>
+	class spsc_queue {
+		struct alignas(cache_line) producer {
+			std::atomic<size_t> tail{ 0 };
+			size_t head = 0; // cached
+		};
+		struct alignas(cache_line) consumer {
+			std::atomic<size_t> head{ 0 };
+			size_t tail = 0; // cached
+		};
+		producer p;
+		consumer c;
+		size_t mask;
+		std::unique_ptr<queue_slot<T>[]> slots;
+
+		static size_t round_up(size_t n)
+		{
+			size_t m = 2;
+			while (m < n) {
+				m <<= 1;
+			}
+
+			return m;
+		}
+	public:
+		spsc_queue(size_t capacity)
+			: mask(round_up(capacity) - 1), slots(new queue_slot<T>[mask + 1])
+		{ }
+		spsc_queue(const spsc_queue&) = delete;
+		spsc_queue& operator=(const spsc_queue&) = delete;
+		~spsc_queue()
+		{
+			for (size_t i = c.head.load(); i != p.tail.load(); ++i) {
+				slots[i & mask].get()->~T();
+			}
+		}
+
+		size_t capacity() const
+		{
+			return mask + 1;
+		}
+		// approximate when called concurrently
+		size_t size() const
+		{
+			return p.tail.load(std::memory_order_acquire) - c.head.load(std::memory_order_acquire);
+		}
+		bool empty() const
+		{
+			return 0 == size();
+		}
+
+		/// Producer only. Returns false if the queue is full.
+		template<class U>
+		bool push(U&& u)
+		{
+			size_t tail = p.tail.load(std::memory_order_relaxed);
+			if (tail - p.head > mask) {
+				p.head = c.head.load(std::memory_order_acquire);
+				if (tail - p.head > mask) {
+					return false;
+				}
+			}
+			new (slots[tail & mask].get()) T(std::forward<U>(u));
+			p.tail.store(tail + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		/// Consumer only. Returns false if the queue is empty.
+		bool pop(T& t)
+		{
+			size_t head = c.head.load(std::memory_order_relaxed);
+			if (head == c.tail) {
+				c.tail = p.tail.load(std::memory_order_acquire);
+				if (head == c.tail) {
+					return false;
+				}
+			}
+			T* u = slots[head & mask].get();
+			t = std::move(*u);
+			u->~T();
+			c.head.store(head + 1, std::memory_order_release);
+
+			return true;
+		}
+		std::optional<T> pop()
+		{
+			size_t head = c.head.load(std::memory_order_relaxed);
+			if (head == c.tail) {
+				c.tail = p.tail.load(std::memory_order_acquire);
+				if (head == c.tail) {
+					return std::nullopt;
+				}
+			}
+			T* u = slots[head & mask].get();
+			std::optional<T> t(std::move(*u));
+			u->~T();
+			c.head.store(head + 1, std::memory_order_release);
+
+			return t;
+		}
+	};
+
+	/// <summary>
+	/// Bounded lock-free multiple producer single consumer queue.
+	/// </summary>
+	/// <remarks>
+	/// Each slot carries a sequence number that tells producers when it is free
+	/// and the consumer when it is full, so producers only contend on the tail index.
+	/// Use it when an acceptor hands sockets to a worker or many threads queue
+	/// sends on one connection.
+	/// </remarks>
+	template<class T>
+	class mpsc_queue {
+		struct cell {
+			std::atomic<size_t> seq;
+			queue_slot<T> slot;
+		};
+		struct alignas(cache_line) producer {
+			std::atomic<size_t> tail{ 0 };
+		};
+		struct alignas(cache_line) consumer {
+			size_t head = 0;
+		};
+		producer p;
+		consumer c;
+		size_t mask;
+		std::unique_ptr<cell[]> cells;
+
+		static size_t round_up(size_t n)
+		{
+			size_t m = 2;
+			while (m < n) {
+				m <<= 1;
+			}
+
+			return m;
+		}
+	public:
+		mpsc_queue(size_t capacity)
+			: mask(round_up(capacity) - 1), cells(new cell[mask + 1])
+		{
+			for (size_t i = 0; i <= mask; ++i) {
+				cells[i].seq.store(i, std::memory_order_relaxed);
+			}
+		}
+		mpsc_queue(const mpsc_queue&) = delete;
+		mpsc_queue& operator=(const mpsc_queue&) = delete;
+		~mpsc_queue()
+		{
+			while (pop()) {
+				;
+			}
+		}
+
+		size_t capacity() const
+		{
+			return mask + 1;
+		}
+		// approximate when called concurrently
+		size_t size() const
+		{
+			return p.tail.load(std::memory_order_acquire) - c.head;
+		}
+		bool empty() const
+		{
+			const cell& e = cells[c.head & mask];
+
+			return e.seq.load(std::memory_order_acquire) != c.head + 1;
+		}
+
+		/// Any thread. Returns false if the queue is full.
+		template<class U>
+		bool push(U&& u)
+		{
+			size_t tail = p.tail.load(std::memory_order_relaxed);
+
+			while (true) {
+				cell& e = cells[tail & mask];
+				size_t seq = e.seq.load(std::memory_order_acquire);
+				auto diff = static_cast<ptrdiff_t>(seq - tail);
+				if (0 == diff) {
+					if (p.tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+						new (e.slot.get()) T(std::forward<U>(u));
+						e.seq.store(tail + 1, std::memory_order_release);
+
+						return true;
+					}
+				}
+				else if (diff < 0) {
+					return false; // full
+				}
+				else {
+					tail = p.tail.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/// Consumer only. Returns false if the queue is empty.
+		bool pop(T& t)
+		{
+			cell& e = cells[c.head & mask];
+			if (e.seq.load(std::memory_order_acquire) != c.head + 1) {
+				return false;
+			}
+			T* u = e.slot.get();
+			t = std::move(*u);
+			u->~T();
+			e.seq.store(c.head + mask + 1, std::memory_order_release);
+			++c.head;
+
+			return true;
+		}
+		std::optional<T> pop()
+		{
+			cell& e = cells[c.head & mask];
+			if (e.seq.load(std::memory_order_acquire) != c.head + 1) {
+				return std::nullopt;
+			}
+			T* u = e.slot.get();
+			std::optional<T> t(std::move(*u));
+			u->~T();
+			e.seq.store(c.head + mask + 1, std::memory_order_release);
+			++c.head;
+
+			return t;
+		}
+	};
+
+#pragma warning(pop)
+
+	/// <summary>
+	/// Wake a consumer blocked in WSAPoll or <c>wait</c>, like a Linux eventfd.
+	/// </summary>
+	/// <remarks>
+	/// A UDP socket on the loopback address connected to itself. Add it to an
+	/// <c>event_loop</c> for POLLRDNORM. A consumer calls <c>arm</c> then checks its
+	/// queues once more before it blocks. Producers call <c>notify</c> after pushing and only
+	/// pay for a send when the consumer is armed.
+	/// </remarks>
+	class wakeup {
+		winsock::socket<> s;
+		std::atomic<bool> armed;
+	public:
+		wakeup()
+			: s(SOCK::DGRAM, IPPROTO::UDP), armed(false)
+		{
+			winsock::sockaddr<> sa(inaddr<>::loopback, 0);
+			if (0 != s.bind(sa) || 0 != ::getsockname(s, &sa, &sa.len) || 0 != s.connect(sa)) {
+				throw std::runtime_error("wakeup socket failed");
+			}
+			s.nonblocking();
+		}
+		wakeup(const wakeup&) = delete;
+		wakeup& operator=(const wakeup&) = delete;
+		~wakeup()
+		{ }
+
+		operator ::SOCKET() const
+		{
+			return s;
+		}
+
+		/// Consumer is about to block.
+		void arm()
+		{
+			armed.store(true);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+		}
+		/// Producer made work available.
+		void notify()
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (armed.exchange(false)) {
+				signal();
+			}
+		}
+		/// Wake the consumer even if it is not armed.
+		void signal()
+		{
+			s.send("", 1);
+		}
+		/// Consumer woke up. Discard pending notifications.
+		void drain()
+		{
+			char buf[16];
+
+			armed.store(false);
+			while (0 < s.recv(buf, sizeof(buf))) {
+				;
+			}
+		}
+		/// Block for at most ms milliseconds (-1 for no limit) until notified.
+		/// Returns true if notified.
+		bool wait(int ms = -1)
+		{
+			WSAPOLLFD fd{ s, POLLRDNORM, 0 };
+			bool ret = 0 < ::WSAPoll(&fd, 1, ms);
+			drain();
+
+			return ret;
+		}
+	};
+
+}
@@ -0,0 +1,144 @@
+// winsock_queue.t.cpp - test queues between threads
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+#include "winsock_socket.h"
+#include "winsock_queue.h"
+
+using namespace winsock;
+
+int test_spsc_queue()
+{
+	{
+		spsc_queue<std::string> q(3);
+		assert(4 == q.capacity());
+		assert(q.empty());
+		for (int i = 0; i < 4; ++i) {
+			assert(q.push(std::string(1, static_cast<char>('a' + i))));
+		}
+		assert(!q.push(std::string("e")));
+		assert(4 == q.size());
+
+		std::string s;
+		assert(q.pop(s));
+		assert("a" == s);
+		auto t = q.pop();
+		assert(t && "b" == *t);
+	} // remaining elements destroyed
+	{
+		// move only
+		spsc_queue<winsock::socket<>> q(2);
+		assert(q.push(winsock::socket<>(SOCK::STREAM, IPPROTO::TCP)));
+		auto s = q.pop();
+		assert(s && INVALID_SOCKET != *s);
+		assert(!q.pop());
+	}
+	{
+		const int n = 100000;
+		spsc_queue<int> q(64);
+		std::thread producer([&q]() {
+			for (int i = 0; i < n; ) {
+				if (q.push(i)) {
+					++i;
+				}
+			}
+		});
+		for (int i = 0; i < n; ) {
+			if (auto j = q.pop()) {
+				assert(i == *j);
+				++i;
+			}
+		}
+		producer.join();
+	}
+
+	return 0;
+}
+int test_spsc_queue_ = test_spsc_queue();
+
+int test_mpsc_queue()
+{
+	{
+		mpsc_queue<std::string> q(3);
+		assert(4 == q.capacity());
+		assert(q.empty());
+		for (int i = 0; i < 4; ++i) {
+			assert(q.push(std::string(1, static_cast<char>('a' + i))));
+		}
+		assert(!q.push(std::string("e")));
+		assert(4 == q.size());
+
+		std::string s;
+		assert(q.pop(s));
+		assert("a" == s);
+		assert(q.push(std::string("e"))); // freed slot is reused
+		auto t = q.pop();
+		assert(t && "b" == *t);
+	}
+	{
+		mpsc_queue<winsock::socket<>> q(2);
+		assert(q.push(winsock::socket<>(SOCK::STREAM, IPPROTO::TCP)));
+		auto s = q.pop();
+		assert(s && INVALID_SOCKET != *s);
+		assert(!q.pop());
+	}
+	{
+		// items from each producer arrive in order
+		const int producers = 4, n = 20000;
+		mpsc_queue<std::pair<int, int>> q(64);
+		std::vector<std::thread> threads;
+		for (int p = 0; p < producers; ++p) {
+			threads.emplace_back([&q, p]() {
+				for (int i = 0; i < n; ) {
+					if (q.push(std::make_pair(p, i))) {
+						++i;
+					}
+				}
+			});
+		}
+		std::vector<int> next(producers, 0);
+		for (int m = 0; m < producers * n; ) {
+			if (auto e = q.pop()) {
+				assert(next[e->first] == e->second);
+				++next[e->first];
+				++m;
+			}
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+		assert(q.empty());
+	}
+
+	return 0;
+}
+int test_mpsc_queue_ = test_mpsc_queue();
+
+int test_wakeup()
+{
+	wakeup w;
+	mpsc_queue<int> q(16);
+
+	assert(!w.wait(0));
+
+	w.notify(); // not armed, nothing sent
+	assert(!w.wait(0));
+
+	w.arm();
+	std::thread producer([&]() {
+		q.push(1);
+		w.notify();
+	});
+	assert(w.wait(5000));
+	producer.join();
+	assert(q.pop());
+
+	w.signal();
+	w.signal();
+	assert(w.wait(0));
+	assert(!w.wait(0)); // drained
+
+	return 0;
+}
+int test_wakeup_ = test_wakeup();
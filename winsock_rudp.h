@@ -0,0 +1,649 @@
+// winsock_rudp.h - reliable datagrams with selective acknowledgement over udp
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <random>
+#include <string_view>
+#include <vector>
+#include "winsock_loop.h"
+#include "winsock_wire.h"
+
+namespace winsock::rudp {
+
+	using clock = std::chrono::steady_clock;
+
+	enum class TYPE : uint8_t {
+		DATA = 1, // pn, pn - lowest unacked, stream, stream sequence, payload
+		ACK = 2,  // all below, ack delay us, blocks of [start, end) above it
+	};
+
+	struct options {
+		size_t max_message = 1200;            // largest message payload
+		size_t initial_window = 10 * 1240;    // bytes in flight before the first ack
+		size_t max_window = 16 << 20;
+		size_t send_buffer = 4 << 20;         // unacknowledged bytes before send fails
+		clock::duration initial_rto = std::chrono::milliseconds(100);
+		clock::duration min_rto = std::chrono::milliseconds(5);
+		clock::duration max_rto = std::chrono::seconds(2);
+	};
+
+	/// <summary>
+	/// Reliable message transport state for one peer, without I/O.
+	/// </summary>
+	/// <remarks>
+	/// Messages are sent on independent streams. Each stream delivers in order, but a lost
+	/// packet only holds back later messages on its own stream.
+	/// Every transmission gets a new packet number so acknowledgements never confuse a
+	/// retransmission with the original and every ack gives an RTT sample. The receiver
+	/// acknowledges a cumulative packet number and up to 32 blocks received above it.
+	/// A packet is lost when a later one has been acknowledged and it is older than 5/4 of
+	/// the RTT, as in RACK, so reordering within that window causes no retransmissions.
+	/// Lost messages are retransmitted under a new packet number. The retransmission timeout
+	/// is computed from the RTT as in RFC 6298 and the congestion window is NewReno:
+	/// slow start, additive increase, halved once per round trip with losses, and
+	/// two packets after a timeout.
+	/// Feed received datagrams to <c>input</c> and call <c>output</c> to get the datagrams
+	/// to send, at the latest by <c>deadline</c>.
+	/// </remarks>
+	class connection {
+		static constexpr size_t header = 40;     // DATA header bound
+		static constexpr size_t max_blocks = 32;
+		static constexpr clock::duration granularity = std::chrono::milliseconds(1);
+
+		struct message {
+			uint16_t stream;
+			uint64_t sseq;
+			std::vector<char> data;
+		};
+		struct packet {
+			message msg;
+			clock::time_point at;
+			size_t size;
+		};
+		struct rx_stream {
+			uint64_t next = 0;
+			std::map<uint64_t, std::vector<char>> held; // arrived ahead of next
+		};
+
+		options opt;
+		// sender
+		std::map<uint16_t, uint64_t> tx_seq;
+		std::deque<message> queued, lost_;
+		std::map<uint64_t, packet> sent; // in flight by packet number
+		uint64_t next_pn, largest_acked, recovery_start;
+		size_t cwnd_, ssthresh, in_flight_, buffered;
+		clock::duration srtt_, rttvar, rto_, latest_rtt;
+		bool sampled;
+		clock::time_point rto_at, loss_at;
+		// receiver
+		uint64_t cum; // every packet number below has been received
+		std::map<uint64_t, uint64_t> ranges; // [start, end) received above cum
+		uint64_t largest_rx;
+		clock::time_point largest_rx_at;
+		bool ack_pending;
+		std::map<uint16_t, rx_stream> streams;
+		std::vector<char> out;
+
+		size_t min_window() const
+		{
+			return 2 * (opt.max_message + header);
+		}
+
+		// absorb ranges that now touch cum
+		void coalesce()
+		{
+			while (!ranges.empty() && ranges.begin()->first <= cum) {
+				cum = std::max(cum, ranges.begin()->second);
+				ranges.erase(ranges.begin());
+			}
+		}
+		// record packet number pn, false if seen before
+		bool receive(uint64_t pn)
+		{
+			if (pn < cum) {
+				return false;
+			}
+			if (pn == cum) {
+				++cum;
+				coalesce();
+
+				return true;
+			}
+			auto i = ranges.upper_bound(pn);
+			if (i != ranges.begin()) {
+				auto p = std::prev(i);
+				if (pn < p->second) {
+					return false;
+				}
+				if (pn == p->second) {
+					p->second = pn + 1;
+					if (i != ranges.end() && i->first == p->second) {
+						p->second = i->second;
+						ranges.erase(i);
+					}
+
+					return true;
+				}
+			}
+			if (i != ranges.end() && i->first == pn + 1) {
+				uint64_t end = i->second;
+				ranges.erase(i);
+				ranges.emplace(pn, end);
+			}
+			else {
+				ranges.emplace(pn, pn + 1);
+			}
+
+			return true;
+		}
+		void on_data(uint64_t pn, uint64_t low, uint16_t stream, uint64_t sseq, std::string_view payload, clock::time_point now)
+		{
+			// the sender will not send anything below low again
+			if (low > cum) {
+				cum = low;
+				coalesce();
+			}
+			receive(pn);
+			ack_pending = true;
+			if (pn >= largest_rx) {
+				largest_rx = pn;
+				largest_rx_at = now;
+			}
+
+			rx_stream& st = streams[stream];
+			if (sseq < st.next || st.held.contains(sseq)) {
+				++duplicates;
+				return;
+			}
+			if (sseq != st.next) {
+				st.held.emplace(sseq, std::vector<char>(payload.begin(), payload.end()));
+				return;
+			}
+			++st.next;
+			++delivered;
+			if (deliver) {
+				deliver(stream, payload);
+			}
+			for (auto i = st.held.begin(); i != st.held.end() && i->first == st.next; i = st.held.erase(i)) {
+				++st.next;
+				++delivered;
+				if (deliver) {
+					deliver(stream, std::string_view(i->second.data(), i->second.size()));
+				}
+			}
+		}
+		void rtt_sample(clock::duration rtt)
+		{
+			latest_rtt = rtt;
+			if (!sampled) {
+				srtt_ = rtt;
+				rttvar = rtt / 2;
+				sampled = true;
+			}
+			else {
+				clock::duration err = srtt_ > rtt ? srtt_ - rtt : rtt - srtt_;
+				rttvar = (3 * rttvar + err) / 4;
+				srtt_ = (7 * srtt_ + rtt) / 8;
+			}
+			rto_ = std::clamp(srtt_ + std::max(4 * rttvar, granularity), opt.min_rto, opt.max_rto);
+		}
+		void congestion()
+		{
+			ssthresh = std::max(cwnd_ / 2, min_window());
+			cwnd_ = ssthresh;
+			recovery_start = next_pn;
+			++congestion_events;
+		}
+		// declare packets sent before the largest acknowledged lost once they are
+		// older than the reordering window, and set loss_at for the rest
+		void detect_loss(clock::time_point now)
+		{
+			clock::duration window = std::max(std::max(srtt_, latest_rtt) * 5 / 4, granularity);
+			bool reduce = false;
+
+			loss_at = clock::time_point::max();
+			for (auto i = sent.begin(); i != sent.end() && i->first < largest_acked; ) {
+				if (now - i->second.at < window) {
+					loss_at = std::min(loss_at, i->second.at + window);
+					++i;
+				}
+				else {
+					reduce = reduce || i->first >= recovery_start;
+					in_flight_ -= i->second.size;
+					++lost;
+					lost_.push_back(std::move(i->second.msg));
+					i = sent.erase(i);
+				}
+			}
+			if (reduce) {
+				congestion();
+			}
+		}
+		void on_ack(wire::net_reader& r, clock::time_point now)
+		{
+			uint64_t acum = r.varint();
+			uint64_t delay = r.varint();
+			uint64_t nblocks = r.varint();
+			if (!r.ok() || nblocks > max_blocks) {
+				return;
+			}
+
+			size_t acked = 0, grow = 0;
+			bool newest = false;
+			uint64_t largest = 0;
+			clock::time_point largest_at;
+			auto take = [&](std::map<uint64_t, packet>::iterator i, std::map<uint64_t, packet>::iterator e) {
+				while (i != e) {
+					acked += i->second.size;
+					if (i->first >= recovery_start) {
+						grow += i->second.size;
+					}
+					if (!newest || i->first > largest) {
+						newest = true;
+						largest = i->first;
+						largest_at = i->second.at;
+					}
+					buffered -= i->second.msg.data.size();
+					i = sent.erase(i);
+				}
+			};
+			take(sent.begin(), sent.lower_bound(acum));
+			for (uint64_t b = 0; b < nblocks; ++b) {
+				uint64_t start = r.varint();
+				uint64_t len = r.varint();
+				if (!r.ok()) {
+					break;
+				}
+				take(sent.lower_bound(start), sent.lower_bound(start + len));
+			}
+			if (!newest) {
+				return;
+			}
+
+			in_flight_ -= acked;
+			if (largest >= largest_acked) {
+				largest_acked = largest;
+				clock::duration rtt = now - largest_at;
+				clock::duration ack_delay = std::chrono::microseconds(delay);
+				rtt_sample(rtt > ack_delay ? rtt - ack_delay : rtt);
+			}
+			if (cwnd_ < ssthresh) {
+				cwnd_ += grow; // slow start
+			}
+			else if (grow) {
+				cwnd_ += std::max<size_t>(1, (opt.max_message + header) * grow / cwnd_);
+			}
+			cwnd_ = std::min(cwnd_, opt.max_window);
+			detect_loss(now);
+			// progress restarts the timer
+			rto_at = now + rto_;
+		}
+		// retransmission timer expired, everything in flight is lost
+		void timeout()
+		{
+			++timeouts;
+			for (auto& [pn, p] : sent) {
+				++lost;
+				lost_.push_back(std::move(p.msg));
+			}
+			sent.clear();
+			in_flight_ = 0;
+			loss_at = clock::time_point::max();
+			ssthresh = std::max(cwnd_ / 2, min_window());
+			cwnd_ = min_window();
+			recovery_start = next_pn;
+			++congestion_events;
+			rto_ = std::min(2 * rto_, opt.max_rto); // back off until an ack arrives
+		}
+	public:
+		std::function<void(uint16_t stream, std::string_view msg)> deliver;
+		// counters for reporting
+		size_t packets, retransmits, lost, timeouts, congestion_events;
+		size_t delivered, duplicates, errors;
+
+		connection(const options& _opt = options{})
+			: opt(_opt), next_pn(0), largest_acked(0), recovery_start(0),
+			  cwnd_(_opt.initial_window), ssthresh(_opt.max_window), in_flight_(0), buffered(0),
+			  srtt_(_opt.initial_rto), rttvar(_opt.initial_rto / 2), rto_(_opt.initial_rto), latest_rtt(0), sampled(false),
+			  loss_at(clock::time_point::max()),
+			  cum(0), largest_rx(0), ack_pending(false), out(_opt.max_message + header + 16 * max_blocks),
+			  packets(0), retransmits(0), lost(0), timeouts(0), congestion_events(0),
+			  delivered(0), duplicates(0), errors(0)
+		{ }
+		connection(const connection&) = delete;
+		connection& operator=(const connection&) = delete;
+
+		/// Queue a message on stream. False if it is too large or the send buffer is full.
+		bool send(uint16_t stream, const char* p, size_t n)
+		{
+			if (n > opt.max_message || buffered + n > opt.send_buffer) {
+				return false;
+			}
+			queued.push_back(message{ stream, tx_seq[stream]++, std::vector<char>(p, p + n) });
+			buffered += n;
+
+			return true;
+		}
+
+		/// Process a datagram from the peer. False if it is malformed.
+		bool input(const char* p, size_t n, clock::time_point now = clock::now())
+		{
+			wire::net_reader r(p, n);
+			TYPE type = static_cast<TYPE>(r.get<uint8_t>());
+
+			if (TYPE::DATA == type) {
+				uint64_t pn = r.varint();
+				uint64_t below = r.varint();
+				uint16_t stream = r.get<uint16_t>();
+				uint64_t sseq = r.varint();
+				if (r.ok() && below <= pn) {
+					on_data(pn, pn - below, stream, sseq, r.bytes(r.remaining()), now);
+					return true;
+				}
+			}
+			else if (TYPE::ACK == type) {
+				on_ack(r, now);
+				if (r.ok()) {
+					return true;
+				}
+			}
+			++errors;
+
+			return false;
+		}
+
+		/// Call emit(const char*, int) with each datagram to send now: an ack if data
+		/// arrived, then retransmissions and new messages as the congestion window allows.
+		template<class F>
+		void output(F&& emit, clock::time_point now = clock::now())
+		{
+			if (now >= loss_at) {
+				detect_loss(now);
+			}
+			if (!sent.empty() && now >= rto_at) {
+				timeout();
+			}
+
+			if (ack_pending) {
+				wire::net_writer w(buffer_view<char>{ out.data(), static_cast<int>(out.size()) });
+				auto delay = std::chrono::duration_cast<std::chrono::microseconds>(now - largest_rx_at);
+				size_t nblocks = std::min(ranges.size(), max_blocks);
+				w.put(static_cast<uint8_t>(TYPE::ACK)).varint(cum).varint(static_cast<uint64_t>(delay.count())).varint(nblocks);
+				// highest first, the oldest gaps are repaired by then
+				auto i = ranges.rbegin();
+				for (size_t b = 0; b < nblocks; ++b, ++i) {
+					w.varint(i->first).varint(i->second - i->first);
+				}
+				emit(out.data(), static_cast<int>(w.size()));
+				ack_pending = false;
+			}
+
+			for (;;) {
+				bool retransmit = !lost_.empty();
+				std::deque<message>& q = retransmit ? lost_ : queued;
+				if (q.empty()) {
+					break;
+				}
+				message& m = q.front();
+				wire::net_writer w(buffer_view<char>{ out.data(), static_cast<int>(out.size()) });
+				uint64_t low = sent.empty() ? next_pn : sent.begin()->first;
+				w.put(static_cast<uint8_t>(TYPE::DATA)).varint(next_pn).varint(next_pn - low)
+					.put(m.stream).varint(m.sseq).bytes(m.data.data(), m.data.size());
+				if (in_flight_ + w.size() > cwnd_) {
+					break;
+				}
+				emit(out.data(), static_cast<int>(w.size()));
+				if (sent.empty()) {
+					rto_at = now + rto_;
+				}
+				in_flight_ += w.size();
+				++packets;
+				if (retransmit) {
+					++retransmits;
+				}
+				sent.emplace(next_pn++, packet{ std::move(m), now, w.size() });
+				q.pop_front();
+			}
+		}
+
+		/// When output must next be called: now if an ack is owed, when a packet leaves
+		/// the reordering window or the retransmission timeout if data is in flight,
+		/// otherwise never.
+		clock::time_point deadline() const
+		{
+			if (ack_pending) {
+				return clock::time_point::min();
+			}
+
+			return sent.empty() ? clock::time_point::max() : std::min(loss_at, rto_at);
+		}
+		/// Everything sent has been acknowledged.
+		bool idle() const
+		{
+			return sent.empty() && queued.empty() && lost_.empty();
+		}
+
+		clock::duration srtt() const
+		{
+			return srtt_;
+		}
+		clock::duration rto() const
+		{
+			return rto_;
+		}
+		size_t cwnd() const
+		{
+			return cwnd_;
+		}
+		size_t in_flight() const
+		{
+			return in_flight_;
+		}
+	};
+
+	/// <summary>
+	/// Drop and delay outgoing datagrams to test on a local network.
+	/// </summary>
+	/// <remarks>
+	/// Each datagram is dropped with probability <c>loss</c>, otherwise sent after
+	/// <c>delay</c> plus a uniform random part of <c>jitter</c>, which also reorders.
+	/// Delayed datagrams are sent by <c>flush</c> once due.
+	/// </remarks>
+	template<AF af = AF::INET>
+	class impairment {
+		double loss;
+		clock::duration delay, jitter;
+		std::mt19937 rng;
+		std::uniform_real_distribution<double> u;
+		std::multimap<clock::time_point, std::pair<sockaddr<af>, std::vector<char>>> held;
+	public:
+		size_t dropped;
+
+		impairment()
+			: loss(0), delay(0), jitter(0), rng(1), u(0, 1), dropped(0)
+		{ }
+
+		void set(double _loss, clock::duration _delay = clock::duration::zero(), clock::duration _jitter = clock::duration::zero(), unsigned seed = 1)
+		{
+			loss = _loss;
+			delay = _delay;
+			jitter = _jitter;
+			rng.seed(seed);
+		}
+
+		/// Send, drop, or hold a datagram. Returns len unless sending fails.
+		int sendto(::SOCKET s, const sockaddr<af>& to, const char* buf, int len, clock::time_point now = clock::now())
+		{
+			if (loss > 0 && u(rng) < loss) {
+				++dropped;
+				return len;
+			}
+			clock::duration d = delay + std::chrono::duration_cast<clock::duration>(jitter * u(rng));
+			if (d <= clock::duration::zero()) {
+				return ::sendto(s, buf, len, 0, &to, to.len);
+			}
+			held.emplace(now + d, std::make_pair(to, std::vector<char>(buf, buf + len)));
+
+			return len;
+		}
+		/// Send held datagrams that are due.
+		void flush(::SOCKET s, clock::time_point now = clock::now())
+		{
+			for (auto i = held.begin(); i != held.end() && i->first <= now; i = held.erase(i)) {
+				const auto& [to, data] = i->second;
+				::sendto(s, data.data(), static_cast<int>(data.size()), 0, &to, to.len);
+			}
+		}
+		clock::time_point deadline() const
+		{
+			return held.empty() ? clock::time_point::max() : held.begin()->first;
+		}
+		bool empty() const
+		{
+			return held.empty();
+		}
+	};
+
+	/// <summary>
+	/// Reliable messages to any number of peers over one non-blocking udp socket.
+	/// </summary>
+	/// <remarks>
+	/// The socket is read on the event loop and a connection is created for each new peer
+	/// address. Acks are sent once per batch of datagrams read and retransmissions are
+	/// driven by a timer on the loop. The socket is not owned.
+	/// </remarks>
+	template<AF af = AF::INET>
+	class endpoint {
+	public:
+		using handler = std::function<void(const sockaddr<af>& from, uint16_t stream, std::string_view msg)>;
+	private:
+		event_loop& loop;
+		::SOCKET s;
+		handler f;
+		options opt;
+		std::map<sockaddr<af>, connection> peers;
+		impairment<af> netem;
+		timer wakeup;
+		std::vector<char> in;
+
+		connection& peer(const sockaddr<af>& sa)
+		{
+			auto i = peers.find(sa);
+			if (i == peers.end()) {
+				i = peers.try_emplace(sa, opt).first;
+				const sockaddr<af>* from = &i->first;
+				i->second.deliver = [this, from](uint16_t stream, std::string_view msg) {
+					if (f) {
+						f(*from, stream, msg);
+					}
+				};
+			}
+
+			return i->second;
+		}
+		void arm()
+		{
+			clock::time_point next = netem.deadline();
+			for (const auto& [sa, c] : peers) {
+				next = std::min(next, c.deadline());
+			}
+			clock::time_point now = clock::now();
+			if (clock::time_point::max() == next) {
+				wakeup.cancel();
+			}
+			else {
+				loop.timers().schedule(wakeup, next > now ? next - now : clock::duration::zero());
+			}
+		}
+		void read()
+		{
+			clock::time_point now = clock::now();
+
+			for (int i = 0; i < 64; ++i) {
+				sockaddr<af> from;
+				int n = ::recvfrom(s, in.data(), static_cast<int>(in.size()), 0, &from, &from.len);
+				if (SOCKET_ERROR == n) {
+					// port unreachable from an earlier send
+					if (WSAECONNRESET == ::WSAGetLastError()) {
+						continue;
+					}
+					break;
+				}
+				peer(from).input(in.data(), static_cast<size_t>(n), now);
+			}
+			flush(now);
+		}
+	public:
+		endpoint(event_loop& _loop, ::SOCKET _s, handler _f, const options& _opt = options{})
+			: loop(_loop), s(_s), f(std::move(_f)), opt(_opt), in(64 * 1024)
+		{
+			wakeup.expire = [this](timer&) {
+				flush();
+			};
+			loop.add(s, POLLRDNORM, [this](SHORT) {
+				read();
+			});
+		}
+		endpoint(const endpoint&) = delete;
+		endpoint& operator=(const endpoint&) = delete;
+		~endpoint()
+		{
+			loop.remove(s);
+		}
+
+		/// Queue a message to to on stream and send what the window allows.
+		bool send(const sockaddr<af>& to, uint16_t stream, const char* p, size_t n)
+		{
+			if (!peer(to).send(stream, p, n)) {
+				return false;
+			}
+			flush();
+
+			return true;
+		}
+		/// Send acks, retransmissions, queued messages, and due delayed datagrams.
+		void flush(clock::time_point now = clock::now())
+		{
+			for (auto& p : peers) {
+				const sockaddr<af>& to = p.first;
+				p.second.output([this, &to, now](const char* buf, int len) {
+					netem.sendto(s, to, buf, len, now);
+				}, now);
+			}
+			netem.flush(s, now);
+			arm();
+		}
+
+		// connection to sa if there has been traffic
+		connection* find(const sockaddr<af>& sa)
+		{
+			auto i = peers.find(sa);
+
+			return i == peers.end() ? nullptr : &i->second;
+		}
+		/// Forget a peer and anything not yet acknowledged.
+		void erase(const sockaddr<af>& sa)
+		{
+			peers.erase(sa);
+		}
+		size_t size() const
+		{
+			return peers.size();
+		}
+		/// Everything sent to every peer has been acknowledged.
+		bool idle() const
+		{
+			return netem.empty() && std::all_of(peers.begin(), peers.end(), [](const auto& p) { return p.second.idle(); });
+		}
+		/// Loss and delay applied to everything this endpoint sends.
+		impairment<af>& impair()
+		{
+			return netem;
+		}
+	};
+
+}
@@ -0,0 +1,119 @@
+// winsock_rudp.t.cpp - test reliable datagrams with selective acknowledgement
+#include <cassert>
+#include <string>
+#include <vector>
+#include "winsock_rudp.h"
+
+using namespace winsock;
+
+int test_rudp_connection()
+{
+	using namespace std::chrono_literals;
+	using packets = std::vector<std::string>;
+
+	rudp::connection a, b;
+	std::vector<std::pair<uint16_t, std::string>> got;
+	b.deliver = [&got](uint16_t stream, std::string_view msg) {
+		got.emplace_back(stream, msg);
+	};
+	auto collect = [](rudp::connection& c, rudp::clock::time_point now) {
+		packets p;
+		c.output([&p](const char* buf, int len) { p.emplace_back(buf, len); }, now);
+		return p;
+	};
+	auto t = rudp::clock::now();
+
+	assert(a.send(1, "a0", 2) && a.send(1, "a1", 2) && a.send(2, "b0", 2));
+	packets p = collect(a, t);
+	assert(3 == p.size() && 3 == a.packets);
+
+	// first packet lost, stream 2 is not held back by stream 1
+	assert(b.input(p[1].data(), p[1].size(), t + 1ms));
+	assert(b.input(p[2].data(), p[2].size(), t + 1ms));
+	assert(1 == got.size() && 2 == got[0].first && "b0" == got[0].second);
+	assert(b.input(p[2].data(), p[2].size(), t + 1ms));
+	assert(1 == b.duplicates);
+
+	// selective ack of 1 and 2, 0 is lost once it leaves the reordering window
+	packets ack = collect(b, t + 1ms);
+	assert(1 == ack.size());
+	assert(a.input(ack[0].data(), ack[0].size(), t + 2ms));
+	assert(2ms == a.srtt());
+	assert(0 == a.lost && t + 2500us == a.deadline());
+	p = collect(a, t + 2500us);
+	assert(1 == a.lost && 1 == a.retransmits && 1 == p.size());
+
+	assert(b.input(p[0].data(), p[0].size(), t + 3500us));
+	assert(3 == got.size() && "a0" == got[1].second && "a1" == got[2].second);
+	ack = collect(b, t + 3500us);
+	assert(a.input(ack[0].data(), ack[0].size(), t + 4500us));
+	assert(a.idle() && 0 == a.in_flight());
+	assert(rudp::clock::time_point::max() == a.deadline());
+
+	// retransmission timeout
+	assert(a.send(2, "b1", 2));
+	p = collect(a, t + 5ms);
+	auto rto = a.rto();
+	assert(a.deadline() == t + 5ms + rto);
+	p = collect(a, t + 5ms + rto);
+	assert(1 == a.timeouts && 1 == p.size() && a.rto() == 2 * rto);
+	assert(b.input(p[0].data(), p[0].size(), t + 6ms + rto));
+	assert("b1" == got.back().second);
+
+	assert(!a.input("\x07", 1));
+	assert(1 == a.errors);
+	std::string big(2000, 'x');
+	assert(!a.send(0, big.data(), big.size()));
+
+	return 0;
+}
+int test_rudp_connection_ = test_rudp_connection();
+
+int test_rudp_endpoint()
+{
+	using namespace std::chrono_literals;
+	const size_t n = 2000;
+	const uint16_t streams = 4;
+
+	winsock::sockaddr<> sa(inaddr<>::loopback, 6811), sb(inaddr<>::loopback, 6812);
+	udp::server::socket<> ua(sa), ub(sb);
+	ua.nonblocking();
+	ub.nonblocking();
+
+	event_loop loop;
+	std::vector<std::vector<std::string>> got(streams);
+	rudp::endpoint<> a(loop, ua, nullptr);
+	rudp::endpoint<> b(loop, ub, [&got, &sa](const winsock::sockaddr<>& from, uint16_t stream, std::string_view msg) {
+		assert(from == sa);
+		got[stream].emplace_back(msg);
+	});
+	a.impair().set(0.05, 1ms, 500us);
+	b.impair().set(0.05, 1ms, 500us, 2); // acks are lost too
+
+	for (size_t i = 0; i < n; ++i) {
+		std::string msg = std::to_string(i);
+		assert(a.send(sb, static_cast<uint16_t>(i % streams), msg.data(), msg.size()));
+	}
+	size_t received = 0;
+	for (int i = 0; i < 5000 && (received < n || !a.idle()); ++i) {
+		loop.run_once(10);
+		received = 0;
+		for (const auto& s : got) {
+			received += s.size();
+		}
+	}
+
+	assert(n == received);
+	for (size_t s = 0; s < streams; ++s) {
+		for (size_t i = 0; i < got[s].size(); ++i) {
+			assert(std::to_string(i * streams + s) == got[s][i]);
+		}
+	}
+	rudp::connection* c = a.find(sb);
+	assert(c && c->idle());
+	assert(0 < c->retransmits && 0 < a.impair().dropped);
+	assert(1 == a.size() && 1 == b.size());
+
+	return 0;
+}
+int test_rudp_endpoint_ = test_rudp_endpoint();
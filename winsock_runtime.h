@@ -0,0 +1,248 @@
+// winsock_runtime.h - thread per core shared nothing server runtime
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "winsock_loop.h"
+#include "winsock_queue.h"
+
+namespace winsock {
+
+	/// <summary>
+	/// Thread per core server runtime where each worker owns its connections end to end.
+	/// </summary>
+	/// <remarks>
+	/// Every worker is pinned to one processor and has its own listening socket, event loop,
+	/// and buffer pool allocated on its NUMA node. Workers talk to each other only through
+	/// a lock-free multiple producer single consumer inbox each, so nothing is locked and
+	/// memory for queues grows with the number of workers, not its square.
+	/// A worker with nothing to do blocks in WSAPoll and is woken by a <c>wakeup</c>.
+	/// Windows has no SO_REUSEPORT so each worker listens on a duplicate of the same
+	/// underlying socket and the stack hands each connection to one of the waiting workers.
+	/// Duplicates share the non-blocking mode of the socket, so the listener passed in,
+	/// and any other handle to it, is non-blocking once the runtime is constructed.
+	/// In place of SO_INCOMING_CPU, <c>steer</c> queries SIO_QUERY_RSS_PROCESSOR_INFO
+	/// on accepted sockets and posts them to the worker on the processor that RSS delivers
+	/// their packets to.
+	/// </remarks>
+	template<AF af = AF::INET>
+	class runtime {
+	public:
+		class worker;
+		using accept_handler = std::function<void(worker&, winsock::socket<af>&&, const sockaddr<af>&)>;
+
+		struct options {
+			size_t workers = 0;       // 0 for one per active processor
+			size_t queue = 1024;      // capacity of each worker's inbox
+			size_t buffers = 1024;    // blocks in each worker buffer pool
+			bool steer = false;       // move connections to their RSS processor
+			int poll = -1;            // longest wait in WSAPoll in milliseconds, -1 for no limit
+			map_policy memory;        // buffer pool pages, node defaults to the worker's node
+		};
+	private:
+		// message between workers, a connection or a function to run
+		struct message {
+			std::optional<winsock::socket<af>> s;
+			sockaddr<af> sa;
+			std::function<void(worker&)> f;
+		};
+	public:
+		class worker {
+			friend class runtime;
+			runtime& rt;
+			size_t id;
+			winsock::socket<af> listener;
+			event_loop loop_;
+			buffer_pool<> pool_;
+			mpsc_queue<message> inbox;
+			wakeup wake;
+			std::thread thread;
+			std::atomic<bool> pinned_;
+
+			worker(runtime& _rt, size_t _id, winsock::socket<af>&& _listener)
+				: rt(_rt), id(_id), listener(std::move(_listener)), pool_(_rt.opts.buffers, policy(_rt.opts.memory, _id)),
+				inbox(_rt.opts.queue), pinned_(false)
+			{
+				listener.nonblocking(); // workers race to accept
+			}
+
+			// allocate buffers on the NUMA node of the processor the worker is pinned to
+			static map_policy policy(map_policy p, size_t id)
+			{
+				if (NUMA_NO_PREFERRED_NODE == p.node) {
+					p.node = processor_node(id);
+				}
+
+				return p;
+			}
+
+			bool pin()
+			{
+				const PROCESSOR_NUMBER& pn = processors()[id % processors().size()];
+				GROUP_AFFINITY ga;
+				memset(&ga, 0, sizeof(ga));
+				ga.Group = pn.Group;
+				ga.Mask = KAFFINITY(1) << pn.Number;
+
+				return ::SetThreadGroupAffinity(::GetCurrentThread(), &ga, nullptr);
+			}
+			// worker that RSS delivers packets of s to
+			size_t home(const winsock::socket<af>& s) const
+			{
+				PROCESSOR_NUMBER pn;
+				DWORD len = 0;
+				if (SOCKET_ERROR == ::WSAIoctl(s, SIO_QUERY_RSS_PROCESSOR_INFO, nullptr, 0, &pn, sizeof(pn), &len, nullptr, nullptr)) {
+					return id;
+				}
+
+				size_t i = processor_index(pn);
+
+				return SIZE_MAX == i ? id : i % rt.size();
+			}
+			void accept()
+			{
+				while (true) {
+					sockaddr<af> sa;
+					winsock::socket<af> s = listener.accept(sa);
+					if (INVALID_SOCKET == s) {
+						break; // WSAEWOULDBLOCK or error
+					}
+					if (rt.opts.steer) {
+						if (size_t to = home(s); to != id) {
+							message m{ std::move(s), sa, nullptr };
+							if (rt[to].inbox.push(std::move(m))) {
+								rt[to].wake.notify();
+								continue;
+							}
+							s = std::move(*m.s); // queue full, keep it
+						}
+					}
+					rt.on_accept(*this, std::move(s), sa);
+				}
+			}
+			void drain()
+			{
+				while (auto m = inbox.pop()) {
+					if (m->s) {
+						rt.on_accept(*this, std::move(*m->s), m->sa);
+					}
+					else if (m->f) {
+						m->f(*this);
+					}
+				}
+			}
+			void run()
+			{
+				pinned_ = pin();
+				loop_.add(listener, POLLRDNORM, [this](SHORT) { accept(); });
+				loop_.add(wake, POLLRDNORM, [this](SHORT) { wake.drain(); });
+				loop_.idle([this]() {
+					wake.arm(); // then look at the queues once more before blocking
+					drain();
+				});
+				while (!rt.stopping.load(std::memory_order_relaxed)) {
+					if (SOCKET_ERROR == loop_.run_once(rt.opts.poll)) {
+						break;
+					}
+				}
+				loop_.remove(wake);
+				loop_.remove(listener);
+			}
+		public:
+			worker(const worker&) = delete;
+			worker& operator=(const worker&) = delete;
+
+			size_t index() const
+			{
+				return id;
+			}
+			// false until the worker runs, or if it could not be bound to its processor
+			bool pinned() const
+			{
+				return pinned_;
+			}
+			event_loop& loop()
+			{
+				return loop_;
+			}
+			buffer_pool<>& pool()
+			{
+				return pool_;
+			}
+			/// Run f on worker to. Returns false if its inbox is full.
+			bool post(size_t to, std::function<void(worker&)> f)
+			{
+				if (to == id) {
+					f(*this);
+
+					return true;
+				}
+
+				if (!rt[to].inbox.push(message{ std::nullopt, sockaddr<af>{}, std::move(f) })) {
+					return false;
+				}
+				rt[to].wake.notify();
+
+				return true;
+			}
+		};
+	private:
+		options opts;
+		accept_handler on_accept;
+		std::vector<std::unique_ptr<worker>> workers;
+		std::atomic<bool> stopping;
+	public:
+		/// Workers accept from duplicates of listener, which must already be listening.
+		/// This makes listener non-blocking.
+		runtime(const tcp::server::socket<af>& listener, accept_handler f, options o = options{})
+			: opts(o), on_accept(std::move(f)), stopping(false)
+		{
+			size_t n = opts.workers ? opts.workers : processors().size();
+
+			for (size_t i = 0; i < n; ++i) {
+				workers.emplace_back(new worker(*this, i, listener.duplicate()));
+			}
+		}
+		runtime(const runtime&) = delete;
+		runtime& operator=(const runtime&) = delete;
+		~runtime()
+		{
+			stop();
+		}
+
+		size_t size() const
+		{
+			return workers.size();
+		}
+		worker& operator[](size_t i)
+		{
+			return *workers[i];
+		}
+
+		void start()
+		{
+			stopping = false;
+			for (auto& w : workers) {
+				w->thread = std::thread([p = w.get()]() { p->run(); });
+			}
+		}
+		/// Signal workers to stop and wait for them.
+		void stop()
+		{
+			stopping = true;
+			for (auto& w : workers) {
+				w->wake.signal();
+			}
+			for (auto& w : workers) {
+				if (w->thread.joinable()) {
+					w->thread.join();
+				}
+			}
+		}
+	};
+
+}
@@ -0,0 +1,54 @@
+// winsock_runtime.t.cpp - test thread per core runtime
+#include <cassert>
+#include <atomic>
+#include "winsock_runtime.h"
+
+using namespace winsock;
+
+int test_runtime()
+{
+	tcp::server::socket<> srv("localhost", "6795");
+	srv.listen();
+
+	std::vector<std::vector<winsock::socket<>>> conns(2); // owned by each worker
+	std::atomic<int> posted = -1;
+	runtime<>::options o;
+	o.workers = 2;
+
+	runtime<> rt(srv, [&](runtime<>::worker& w, winsock::socket<>&& s, const winsock::sockaddr<>&) {
+		::SOCKET h = s;
+		w.loop().add(h, POLLRDNORM, [&w, h](SHORT) {
+			char buf[64];
+			int n = ::recv(h, buf, sizeof(buf), 0);
+			if (n > 0) {
+				::send(h, buf, n, 0);
+			}
+			else {
+				w.loop().remove(h);
+			}
+		});
+		conns[w.index()].push_back(std::move(s));
+		// messages only go through the queues
+		w.post(1 - w.index(), [&posted](runtime<>::worker& v) { posted = static_cast<int>(v.index()); });
+	}, o);
+	assert(2 == rt.size());
+	rt.start();
+
+	{
+		tcp::client::socket<> s("localhost", "6795");
+		char buf[8];
+		assert(3 == s.send("abc", 3));
+		assert(3 == s.recv(buf, 3, RCV_MSG::WAITALL));
+		assert(0 == strncmp("abc", buf, 3));
+	}
+	while (-1 == posted) {
+		std::this_thread::yield();
+	}
+	assert(rt[0].pinned() && rt[1].pinned()); // both have run
+	rt.stop();
+	assert(1 == conns[0].size() + conns[1].size());
+	assert(conns[posted].empty());
+
+	return 0;
+}
+int test_runtime_ = test_runtime();
@@ -0,0 +1,311 @@
+// winsock_seqpacket.h - reliable ordered messages with preserved boundaries
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include "winsock_crc.h"
+#include "winsock_socket.h"
+
+namespace winsock::seqpacket {
+
+	/// <summary>
+	/// Connected socket that sends and receives whole messages.
+	/// </summary>
+	/// <remarks>
+	/// The socket is SOCK_SEQPACKET when the provider supports it. Windows AF_UNIX only
+	/// supports SOCK_STREAM so there each message is sent with a 4 byte length prefix in
+	/// the same call and received with the prefix stripped, so callers see the same
+	/// boundaries either way. <c>framed</c> tells which one is in use.
+	/// Sockets must be blocking since a partial send would split a framed message.
+	/// With <c>integrity</c> on, both peers add and check a CRC-32C trailer on every message.
+	/// </remarks>
+	template<AF af = AF::UNIX>
+	class socket : private winsock::socket<af> {
+		using header = uint32_t; // length prefix of framed messages
+		bool framed_;
+		bool integrity_;
+
+		// receive exactly n bytes, adding them to the trailer as they arrive
+		bool recv_exact(char* p, int n, crc32c_trailer& t) const
+		{
+			if (!integrity_) {
+				return n == winsock::socket<af>::recv(p, n, RCV_MSG::WAITALL);
+			}
+			while (n > 0) {
+				int ret = winsock::socket<af>::recv(p, n);
+				if (ret <= 0) {
+					return false;
+				}
+				t.update(p, ret);
+				p += ret;
+				n -= ret;
+			}
+
+			return true;
+		}
+		// discard the rest of a message that did not fit
+		bool skip(int n, crc32c_trailer& t) const
+		{
+			char scratch[0x1000];
+
+			while (n > 0) {
+				int m = std::min(n, static_cast<int>(sizeof(scratch)));
+				if (!recv_exact(scratch, m, t)) {
+					return false;
+				}
+				n -= m;
+			}
+
+			return true;
+		}
+		// trailer did not match
+		static int corrupt()
+		{
+			::WSASetLastError(ERROR_CRC);
+
+			return SOCKET_ERROR;
+		}
+		int recv_framed(buffer_view<char>& buf, DWORD& flags) const
+		{
+			header n;
+			int ret = winsock::socket<af>::recv(reinterpret_cast<char*>(&n), sizeof(n), RCV_MSG::WAITALL);
+			if (ret <= 0) {
+				return ret; // closed or error
+			}
+			if (ret != sizeof(n)) {
+				return SOCKET_ERROR;
+			}
+			int m = static_cast<int>(std::min<header>(n, static_cast<header>(buf.len)));
+			crc32c_trailer t;
+			if (!recv_exact(buf.buf, m, t)) {
+				return SOCKET_ERROR;
+			}
+			if (static_cast<header>(m) < n) {
+				flags |= MSG_TRUNC;
+				if (!skip(static_cast<int>(n - m), t)) {
+					return SOCKET_ERROR;
+				}
+			}
+			if (integrity_) {
+				char trailer[crc32c_trailer::size];
+				if (crc32c_trailer::size != winsock::socket<af>::recv(trailer, crc32c_trailer::size, RCV_MSG::WAITALL)) {
+					return SOCKET_ERROR;
+				}
+				if (!t.check(trailer)) {
+					return corrupt();
+				}
+			}
+			buf.len = m;
+
+			return m;
+		}
+		int recv_packet(buffer_view<char>& buf, DWORD& flags) const
+		{
+			WSABUF data{ static_cast<ULONG>(buf.len), buf.buf };
+			DWORD n = 0, f = 0;
+
+			if (SOCKET_ERROR == ::WSARecv(*this, &data, 1, &n, &f, nullptr, nullptr)) {
+				if (WSAEMSGSIZE != ::WSAGetLastError()) {
+					return SOCKET_ERROR;
+				}
+				flags |= MSG_TRUNC; // provider discarded the rest
+				return buf.len;
+			}
+			buf.len = static_cast<int>(n);
+			// providers supporting partial messages return the rest in following calls
+			while (f & MSG_PARTIAL) {
+				char scratch[0x1000];
+				data = WSABUF{ sizeof(scratch), scratch };
+				f = 0;
+				if (SOCKET_ERROR == ::WSARecv(*this, &data, 1, &n, &f, nullptr, nullptr)) {
+					return SOCKET_ERROR;
+				}
+				flags |= MSG_TRUNC;
+			}
+			// a truncated message can not be checked
+			if (integrity_ && !(flags & MSG_TRUNC)) {
+				int len = crc32c_trailer::open(buf.buf, buf.len);
+				if (len < 0) {
+					return corrupt();
+				}
+				buf.len = len;
+			}
+
+			return buf.len;
+		}
+	protected:
+		using winsock::socket<af>::bind;
+		using winsock::socket<af>::connect;
+		using winsock::socket<af>::listen;
+
+		// SOCK_SEQPACKET if supported, otherwise SOCK_STREAM
+		static winsock::socket<af> open()
+		{
+			winsock::socket<af> s(SOCK::SEQPACKET, IPPROTO::DEFAULT);
+			if (INVALID_SOCKET == s) {
+				return winsock::socket<af>(SOCK::STREAM, IPPROTO::DEFAULT);
+			}
+
+			return s;
+		}
+	public:
+		using winsock::socket<af>::operator ::SOCKET;
+		using winsock::socket<af>::sockname;
+		using winsock::socket<af>::peername;
+
+		socket(winsock::socket<af>&& s)
+			: winsock::socket<af>(std::move(s)), framed_(SOCK_STREAM == winsock::socket<af>::hints().ai_socktype),
+			  integrity_(false)
+		{ }
+
+		// messages are length prefixed on a stream socket
+		bool framed() const
+		{
+			return framed_;
+		}
+		/// <summary>
+		/// Add and check a CRC-32C trailer on each message. Both peers must agree.
+		/// </summary>
+		/// A message that fails the check is an error with ERROR_CRC. Framed messages are
+		/// checked piece by piece as they are received. On a SOCK_SEQPACKET socket the trailer
+		/// is part of the message, so leave 4 bytes spare in the receive buffer.
+		void integrity(bool on)
+		{
+			integrity_ = on;
+		}
+		bool integrity() const
+		{
+			return integrity_;
+		}
+
+		/// Accept a connection on a listening socket.
+		socket accept() const
+		{
+			return socket(winsock::socket<af>::accept());
+		}
+
+		/// <summary>
+		/// Send one message.
+		/// </summary>
+		/// <returns>len or SOCKET_ERROR</returns>
+		int send(const char* buf, int len) const
+		{
+			if (!framed_ && !integrity_) {
+				return winsock::socket<af>::send(buf, len);
+			}
+
+			header n = static_cast<header>(len);
+			char trailer[crc32c_trailer::size];
+			if (integrity_) {
+				crc32c_trailer t;
+				t.update(buf, len);
+				t.store(trailer);
+			}
+			WSABUF data[3] = {
+				{ sizeof(n), reinterpret_cast<char*>(&n) },
+				{ static_cast<ULONG>(len), const_cast<char*>(buf) },
+				{ sizeof(trailer), trailer },
+			};
+			// the trailer is part of the message on a SOCK_SEQPACKET socket
+			WSABUF* first = framed_ ? data : data + 1;
+			DWORD count = (framed_ ? 2 : 1) + (integrity_ ? 1 : 0);
+			DWORD sent = 0;
+			if (SOCKET_ERROR == ::WSASend(*this, first, count, &sent, 0, nullptr, nullptr)) {
+				return SOCKET_ERROR;
+			}
+
+			return len;
+		}
+		int send(const buffer_view<const char>& buf) const
+		{
+			return send(buf.buf, buf.len);
+		}
+
+		/// <summary>
+		/// Receive one message into buf.
+		/// </summary>
+		/// <returns>bytes received, 0 when the peer has closed, or SOCKET_ERROR</returns>
+		/// <remarks>
+		/// <c>buf.len</c> is set to the bytes received. Like recvmsg on Linux, if the message
+		/// does not fit the rest is discarded and MSG_TRUNC is set in <c>flags</c>.
+		/// As with SOCK_SEQPACKET an empty message can not be told from the peer closing,
+		/// so do not send them.
+		/// </remarks>
+		int recv(buffer_view<char>& buf, DWORD& flags) const
+		{
+			flags = 0;
+
+			return framed_ ? recv_framed(buf, flags) : recv_packet(buf, flags);
+		}
+		int recv(buffer_view<char>& buf) const
+		{
+			DWORD flags;
+
+			return recv(buf, flags);
+		}
+
+		/// <summary>
+		/// Receive up to bufs.size() messages with one wait.
+		/// </summary>
+		/// <returns>number of messages received, each buffer's len is set to its size</returns>
+		/// <remarks>
+		/// Blocks for the first message then takes messages as long as data is queued.
+		/// MSG_TRUNC is set in <c>flags</c> if any message was truncated.
+		/// </remarks>
+		size_t recv(std::span<buffer_view<char>> bufs, DWORD& flags) const
+		{
+			size_t i = 0;
+
+			flags = 0;
+			while (i < bufs.size()) {
+				if (i > 0) {
+					u_long queued = 0;
+					if (0 != ::ioctlsocket(*this, FIONREAD, &queued) || queued < (framed_ ? sizeof(header) : 1)) {
+						break;
+					}
+				}
+				DWORD f;
+				if (0 >= recv(bufs[i], f)) {
+					break; // closed or error
+				}
+				flags |= f;
+				++i;
+			}
+
+			return i;
+		}
+	};
+
+	namespace client {
+		template<AF af = AF::UNIX>
+		class socket : public seqpacket::socket<af> {
+		public:
+			// create and connect socket
+			socket(const sockaddr<af>& sa)
+				: seqpacket::socket<af>(seqpacket::socket<af>::open())
+			{
+				if (0 != seqpacket::socket<af>::connect(sa)) {
+					throw std::runtime_error("winsock::seqpacket::client connect failed");
+				}
+			}
+		};
+	}
+	namespace server {
+		template<AF af = AF::UNIX>
+		class socket : public seqpacket::socket<af> {
+		public:
+			// create socket, bind, and listen
+			socket(const sockaddr<af>& sa, int backlog = SOMAXCONN)
+				: seqpacket::socket<af>(seqpacket::socket<af>::open())
+			{
+				if constexpr (AF::UNIX == af) {
+					::DeleteFileA(sa.in().sun_path); // left over from a previous run
+				}
+				if (0 != seqpacket::socket<af>::bind(sa) || 0 != seqpacket::socket<af>::listen(backlog)) {
+					throw std::runtime_error("winsock::seqpacket::server bind failed");
+				}
+			}
+		};
+	}
+
+}
@@ -0,0 +1,80 @@
+// winsock_seqpacket.t.cpp - test message boundary sockets
+#include <cassert>
+#include <string>
+#include "winsock_seqpacket.h"
+
+using namespace winsock;
+
+int test_seqpacket()
+{
+	std::string path = temp_path("winsock_seqpacket.t.sock");
+	sockaddr<AF::UNIX> sa = unix_addr(path.c_str());
+
+	{
+		seqpacket::server::socket<> srv(sa);
+		seqpacket::client::socket<> cli(sa);
+		auto s = srv.accept();
+		assert(INVALID_SOCKET != s);
+		assert(cli.framed() == s.framed());
+
+		// boundaries are preserved even when sent back to back
+		assert(3 == cli.send("abc", 3));
+		assert(5 == cli.send("defgh", 5));
+		char buf[16];
+		buffer_view<char> msg{ buf, sizeof(buf) };
+		DWORD flags;
+		assert(3 == s.recv(msg, flags));
+		assert(3 == msg.len && 0 == memcmp(buf, "abc", 3) && 0 == flags);
+		msg = buffer_view<char>{ buf, sizeof(buf) };
+		assert(5 == s.recv(msg, flags));
+		assert(0 == memcmp(buf, "defgh", 5));
+
+		// truncated message is reported and the rest discarded
+		assert(8 == cli.send("01234567", 8));
+		assert(2 == cli.send("xy", 2));
+		msg = buffer_view<char>{ buf, 4 };
+		assert(4 == s.recv(msg, flags));
+		assert(MSG_TRUNC == (flags & MSG_TRUNC));
+		assert(0 == memcmp(buf, "0123", 4));
+		msg = buffer_view<char>{ buf, sizeof(buf) };
+		assert(2 == s.recv(msg, flags));
+		assert(0 == flags && 0 == memcmp(buf, "xy", 2));
+
+		// batch receive takes what is queued
+		for (int i = 0; i < 3; ++i) {
+			assert(1 == cli.send(std::to_string(i).c_str(), 1));
+		}
+		::Sleep(50);
+		char bufs[4][8];
+		buffer_view<char> views[4];
+		for (int i = 0; i < 4; ++i) {
+			views[i] = buffer_view<char>{ bufs[i], sizeof(bufs[i]) };
+		}
+		assert(3 == s.recv(views, flags));
+		assert(1 == views[2].len && '2' == bufs[2][0]);
+
+		// integrity trailer
+		cli.integrity(true);
+		s.integrity(true);
+		assert(5 == cli.send("hello", 5));
+		msg = buffer_view<char>{ buf, sizeof(buf) };
+		assert(5 == s.recv(msg) && 0 == memcmp(buf, "hello", 5));
+		if (cli.framed()) {
+			// length, payload, and a bad trailer
+			const char frame[] = { 3, 0, 0, 0, 'a', 'b', 'c', 0, 0, 0, 0 };
+			assert(static_cast<int>(sizeof(frame)) == ::send(cli, frame, sizeof(frame), 0));
+			msg = buffer_view<char>{ buf, sizeof(buf) };
+			assert(SOCKET_ERROR == s.recv(msg));
+			assert(ERROR_CRC == ::WSAGetLastError());
+		}
+
+		// peer closed
+		::shutdown(cli, SD_SEND);
+		msg = buffer_view<char>{ buf, sizeof(buf) };
+		assert(0 == s.recv(msg));
+	}
+	::DeleteFileA(path.c_str());
+
+	return 0;
+}
+int test_seqpacket_ = test_seqpacket();
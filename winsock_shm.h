@@ -0,0 +1,363 @@
+// winsock_shm.h - shared memory byte streams with the socket send and recv interface
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "winsock_socket.h"
+
+namespace winsock::shm {
+
+	// one direction of a channel, the writer and reader each own a cache line
+	struct ring_state {
+		alignas(64) std::atomic<uint64_t> tail; // bytes written
+		std::atomic<uint32_t> writer_closed;
+		std::atomic<uint32_t> writer_waiting;   // for space
+		alignas(64) std::atomic<uint64_t> head; // bytes read
+		std::atomic<uint32_t> reader_closed;
+		std::atomic<uint32_t> reader_waiting;   // for data
+	};
+	// start of the mapping, followed by the data of ring 0 (server to client) and ring 1
+	struct control {
+		static constexpr uint32_t valid = 0x6D687377; // "wshm"
+		std::atomic<uint32_t> magic;
+		uint32_t capacity;
+		std::atomic<uint32_t> client; // FREE, ATTACHED, or DETACHED
+		ring_state ring[2];
+		enum : uint32_t { FREE, ATTACHED, DETACHED };
+	};
+
+	/// <summary>
+	/// Byte stream between processes over single producer single consumer rings in
+	/// a named shared mapping.
+	/// </summary>
+	/// <remarks>
+	/// Data is copied into the ring and out again with no system call. A side that finds the
+	/// ring empty, or full, spins for the <c>busy_poll</c> budget then sleeps on a named event.
+	/// The other side only signals the event if its peer said it is sleeping, so a busy stream
+	/// never enters the kernel. Windows has no futex that works across processes,
+	/// <c>WaitOnAddress</c> is limited to one process, hence the events.
+	/// <c>send</c> and <c>recv</c> behave like they do on a TCP socket: <c>send</c> blocks
+	/// until everything is copied, <c>recv</c> returns what is available and 0 once the peer
+	/// has closed, so code can switch between this and <c>tcp</c> sockets by type.
+	/// Like an accepted connection, each server serves exactly one client. A second client,
+	/// at the same time or after the first has closed, is refused, since two writers on a
+	/// single producer ring would corrupt the stream.
+	/// </remarks>
+	class socket {
+		struct pipe {
+			ring_state* state;
+			char* data;
+			uint64_t mask;
+			uint64_t peer; // last seen head of the writer or tail of the reader
+			handle ready; // data for the reader
+			handle space; // space for the writer
+		};
+
+		iobuffer<char> map;
+		control* ctl;
+		bool owner;
+		size_t cap;
+		pipe tx, rx;
+		busy_poll spin_;
+		bool nonblocking_;
+
+		static uint32_t round_up(size_t n)
+		{
+			uint32_t c = 4096;
+			while (c < n) {
+				c <<= 1;
+			}
+
+			return c;
+		}
+		static size_t header()
+		{
+			return (sizeof(control) + 63) & ~size_t(63);
+		}
+		static std::basic_string<TCHAR> tname(const char* name)
+		{
+			return std::basic_string<TCHAR>(name, name + strlen(name));
+		}
+		static HANDLE event(const std::string& name, char role, size_t i)
+		{
+			return ::CreateEventA(nullptr, FALSE, FALSE, (name + '.' + role + std::to_string(i)).c_str());
+		}
+		void attach(pipe& p, const char* name, size_t i)
+		{
+			p.state = &ctl->ring[i];
+			p.data = map.buf + header() + i * cap;
+			p.mask = cap - 1;
+			p.peer = 0;
+			p.ready = handle(event(name, 'r', i));
+			p.space = handle(event(name, 's', i));
+		}
+		// peer sleeps on e, wake it
+		static void notify(std::atomic<uint32_t>& waiting, HANDLE e)
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (waiting.load(std::memory_order_relaxed)) {
+				::SetEvent(e);
+			}
+		}
+		// spin then sleep on e until ready() is true
+		template<class F>
+		void wait(F ready, std::atomic<uint32_t>& waiting, HANDLE e) const
+		{
+			using clock = std::chrono::steady_clock;
+			// spinning on one processor only delays the peer
+			static const bool alone = std::thread::hardware_concurrency() < 2;
+			auto end = alone ? clock::now() : clock::now() + spin_.budget;
+
+			while (!ready()) {
+				if (clock::now() < end) {
+					YieldProcessor();
+					continue;
+				}
+				waiting.store(1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (!ready()) {
+					// a peer that died without closing never signals
+					::WaitForSingleObject(e, 100);
+				}
+				waiting.store(0, std::memory_order_relaxed);
+			}
+		}
+		// free space, the reader's head is only loaded when the last one seen leaves too little
+		size_t writable(size_t want = 1)
+		{
+			uint64_t tail = tx.state->tail.load(std::memory_order_relaxed);
+			if (cap - (tail - tx.peer) < want) {
+				tx.peer = tx.state->head.load(std::memory_order_acquire);
+			}
+
+			return cap - static_cast<size_t>(tail - tx.peer);
+		}
+		// bytes available, the writer's tail is only loaded when the last one seen is used up
+		size_t readable()
+		{
+			uint64_t head = rx.state->head.load(std::memory_order_relaxed);
+			if (head == rx.peer) {
+				rx.peer = rx.state->tail.load(std::memory_order_acquire);
+			}
+
+			return static_cast<size_t>(rx.peer - head);
+		}
+		size_t write_some(const char* p, size_t n)
+		{
+			n = std::min(n, writable(n));
+			if (n) {
+				uint64_t tail = tx.state->tail.load(std::memory_order_relaxed);
+				size_t off = static_cast<size_t>(tail & tx.mask);
+				size_t first = std::min(n, cap - off);
+				memcpy(tx.data + off, p, first);
+				memcpy(tx.data, p + first, n - first);
+				tx.state->tail.store(tail + n, std::memory_order_release);
+				notify(tx.state->reader_waiting, tx.ready);
+			}
+
+			return n;
+		}
+		size_t read_some(char* p, size_t n)
+		{
+			n = std::min(n, readable());
+			if (n) {
+				uint64_t head = rx.state->head.load(std::memory_order_relaxed);
+				size_t off = static_cast<size_t>(head & rx.mask);
+				size_t first = std::min(n, cap - off);
+				memcpy(p, rx.data + off, first);
+				memcpy(p + first, rx.data, n - first);
+				rx.state->head.store(head + n, std::memory_order_release);
+				notify(rx.state->writer_waiting, rx.space);
+			}
+
+			return n;
+		}
+	protected:
+		// create or open the mapping name with rings of at least capacity bytes
+		socket(const char* name, size_t capacity, bool create)
+			: map(INVALID_HANDLE_VALUE, PAGE_READWRITE, 0, static_cast<DWORD>(header() + 2 * size_t(round_up(capacity))), tname(name).c_str()),
+			  ctl(reinterpret_cast<control*>(map.buf)), owner(create), cap(round_up(capacity)), tx{}, rx{}, nonblocking_(false)
+		{
+			if (!ctl) {
+				throw std::runtime_error("winsock::shm::socket mapping failed");
+			}
+			if (create) {
+				if (control::valid == ctl->magic.load(std::memory_order_acquire)) {
+					throw std::runtime_error("winsock::shm::server name in use");
+				}
+				new (ctl) control{};
+				ctl->capacity = static_cast<uint32_t>(cap);
+			}
+			else if (control::valid != ctl->magic.load(std::memory_order_acquire)) {
+				throw std::runtime_error("winsock::shm::client no server");
+			}
+			else if (cap != ctl->capacity) {
+				throw std::runtime_error("winsock::shm::client capacity mismatch");
+			}
+			else if (uint32_t expected = control::FREE; !ctl->client.compare_exchange_strong(expected, control::ATTACHED)) {
+				throw std::runtime_error("winsock::shm::client server already has a client");
+			}
+			attach(tx, name, create ? 0 : 1);
+			attach(rx, name, create ? 1 : 0);
+			if (create) {
+				ctl->magic.store(control::valid, std::memory_order_release);
+			}
+		}
+	public:
+		socket(const socket&) = delete;
+		socket& operator=(const socket&) = delete;
+		~socket()
+		{
+			if (ctl) {
+				shutdown();
+				rx.state->reader_closed.store(1, std::memory_order_release);
+				::SetEvent(rx.space);
+				if (owner) {
+					ctl->magic.store(0, std::memory_order_release);
+				}
+				else {
+					ctl->client.store(control::DETACHED, std::memory_order_release);
+				}
+			}
+		}
+
+		// bytes each ring holds
+		size_t capacity() const
+		{
+			return cap;
+		}
+		// fail with WSAEWOULDBLOCK instead of waiting
+		void nonblocking(bool on = true)
+		{
+			nonblocking_ = on;
+		}
+		// how long to spin before sleeping
+		void spin(const busy_poll& _spin)
+		{
+			spin_ = _spin;
+		}
+		/// No more sends, the peer receives 0 once it has read everything.
+		void shutdown()
+		{
+			tx.state->writer_closed.store(1, std::memory_order_release);
+			::SetEvent(tx.ready);
+		}
+
+		/// Copy len bytes into the ring, waiting for space unless non-blocking.
+		/// Returns bytes sent or SOCKET_ERROR.
+		int send(const char* buf, int len, SND_MSG = SND_MSG::DEFAULT)
+		{
+			size_t n = static_cast<size_t>(len), sent = 0;
+
+			while (sent < n) {
+				if (tx.state->reader_closed.load(std::memory_order_acquire)) {
+					::WSASetLastError(WSAECONNRESET);
+					return SOCKET_ERROR;
+				}
+				sent += write_some(buf + sent, n - sent);
+				if (sent == n) {
+					break;
+				}
+				if (nonblocking_) {
+					if (sent) {
+						break;
+					}
+					::WSASetLastError(WSAEWOULDBLOCK);
+					return SOCKET_ERROR;
+				}
+				wait([this]() { return writable() || tx.state->reader_closed.load(std::memory_order_acquire); },
+					tx.state->writer_waiting, tx.space);
+			}
+
+			return static_cast<int>(sent);
+		}
+		// Send data in chunks and return total characters sent.
+		template<class T>
+		int send(buffer<T>& buf, SND_MSG flags = SND_MSG::DEFAULT)
+		{
+			int len = 0;
+
+			while (const auto snd = buf(cap)) {
+				int ret = send(snd.buf, snd.len, flags);
+				if (SOCKET_ERROR == ret) {
+					return ret;
+				}
+				len += ret;
+			}
+
+			return len;
+		}
+
+		/// Copy up to len bytes out of the ring, all of them with RCV_MSG::WAITALL.
+		/// Returns bytes received, 0 if the peer closed, or SOCKET_ERROR.
+		int recv(char* buf, int len, RCV_MSG flags = RCV_MSG::DEFAULT)
+		{
+			size_t n = static_cast<size_t>(len), got = 0;
+			bool all = RCV_MSG::WAITALL == (flags & RCV_MSG::WAITALL);
+
+			while (got < n) {
+				got += read_some(buf + got, n - got);
+				if (got == n || (got && !all)) {
+					break;
+				}
+				if (rx.state->writer_closed.load(std::memory_order_acquire) && !readable()) {
+					break;
+				}
+				if (nonblocking_) {
+					if (got) {
+						break;
+					}
+					::WSASetLastError(WSAEWOULDBLOCK);
+					return SOCKET_ERROR;
+				}
+				wait([this]() { return readable() || rx.state->writer_closed.load(std::memory_order_acquire); },
+					rx.state->reader_waiting, rx.ready);
+			}
+
+			return static_cast<int>(got);
+		}
+		int recv(buffer<char>& buf, RCV_MSG flags = RCV_MSG::DEFAULT)
+		{
+			int len = 0;
+
+			while (auto rcv = buf(cap)) {
+				int ret = recv(rcv.buf, rcv.len, flags);
+				if (SOCKET_ERROR == ret) {
+					return ret;
+				}
+				len += ret;
+				if (ret < rcv.len) {
+					break;
+				}
+			}
+
+			return len;
+		}
+	};
+
+	namespace server {
+		class socket : public shm::socket {
+		public:
+			// create the shared mapping name
+			socket(const char* name, size_t capacity = 1 << 20)
+				: shm::socket(name, capacity, true)
+			{ }
+		};
+	}
+	namespace client {
+		class socket : public shm::socket {
+		public:
+			// open the mapping created by a server with the same capacity
+			socket(const char* name, size_t capacity = 1 << 20)
+				: shm::socket(name, capacity, false)
+			{ }
+		};
+	}
+
+}
@@ -0,0 +1,105 @@
+// winsock_shm.t.cpp - test shared memory byte streams
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+#include "winsock_shm.h"
+
+using namespace winsock;
+
+int test_shm()
+{
+	const char* name = "winsock_shm.t";
+
+	// no server
+	try {
+		shm::client::socket c(name);
+		assert(false);
+	}
+	catch (const std::runtime_error&) { }
+
+	{
+		shm::server::socket srv(name, 4096);
+		shm::client::socket cli(name, 4096);
+		assert(4096 == srv.capacity());
+
+		// one client per server
+		try {
+			shm::client::socket c(name, 4096);
+			assert(false);
+		}
+		catch (const std::runtime_error&) { }
+
+		// both directions
+		assert(5 == cli.send("hello", 5));
+		char buf[8192];
+		assert(5 == srv.recv(buf, sizeof(buf)) && 0 == memcmp(buf, "hello", 5));
+		assert(3 == srv.send("abc", 3));
+		assert(3 == cli.recv(buf, 3) && 0 == memcmp(buf, "abc", 3));
+
+		// non-blocking
+		srv.nonblocking();
+		assert(SOCKET_ERROR == srv.recv(buf, sizeof(buf)));
+		assert(WSAEWOULDBLOCK == ::WSAGetLastError());
+		std::vector<char> big(8192, 'x');
+		assert(4096 == srv.send(big.data(), static_cast<int>(big.size()))); // ring is full
+		assert(SOCKET_ERROR == srv.send("y", 1));
+		assert(WSAEWOULDBLOCK == ::WSAGetLastError());
+		assert(4096 == cli.recv(buf, 4096, RCV_MSG::WAITALL));
+		srv.nonblocking(false);
+
+		// many times the ring size, wrapping around
+		const size_t n = 1 << 20;
+		std::thread writer([&cli, n]() {
+			std::vector<char> out(n);
+			for (size_t i = 0; i < n; ++i) {
+				out[i] = static_cast<char>(i * 7);
+			}
+			obuffer b(out.data(), out.size());
+			assert(static_cast<int>(n) == cli.send(b));
+			cli.shutdown();
+		});
+		std::vector<char> in;
+		int m;
+		while (0 < (m = srv.recv(buf, 1000))) {
+			in.insert(in.end(), buf, buf + m);
+		}
+		writer.join();
+		assert(n == in.size());
+		for (size_t i = 0; i < n; ++i) {
+			assert(static_cast<char>(i * 7) == in[i]);
+		}
+
+		// the name is taken while the server lives
+		try {
+			shm::server::socket s(name, 4096);
+			assert(false);
+		}
+		catch (const std::runtime_error&) { }
+	}
+
+	{
+		shm::server::socket srv(name, 4096);
+		try {
+			shm::client::socket c(name, 8192);
+			assert(false);
+		}
+		catch (const std::runtime_error&) { }
+		{
+			shm::client::socket cli(name, 4096);
+		}
+		// peer gone
+		char buf[16];
+		assert(0 == srv.recv(buf, sizeof(buf)));
+		assert(SOCKET_ERROR == srv.send("x", 1));
+		// and the server does not take another
+		try {
+			shm::client::socket c(name, 4096);
+			assert(false);
+		}
+		catch (const std::runtime_error&) { }
+	}
+
+	return 0;
+}
+int test_shm_ = test_shm();
@@ -4,7 +4,11 @@
 #pragma once
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <mstcpip.h>
+#include <mswsock.h>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <compare>
 #include <cstring>
 #include <iostream>
@@ -17,6 +21,7 @@
 #include <vector>
 #include "winsock_addr.h"
 #include "winsock_buffer.h"
+#include "winsock_trace.h"
 
 #pragma comment(lib, "Ws2_32.lib")
 
@@ -41,6 +46,43 @@ namespace winsock {
 	};
 	static inline const WSA wsa;
 
+	/// <summary>
+	/// Opt-in busy polling for latency critical receives.
+	/// </summary>
+	/// <remarks>
+	/// Windows has no SO_BUSY_POLL or SO_PREFER_BUSY_POLL so the socket spins on non-blocking
+	/// <c>recv</c> for up to <c>budget</c> before falling back to waiting in <c>WSAPoll</c>.
+	/// This trades a core for not paying a scheduler wakeup per message.
+	/// The socket must be in non-blocking mode.
+	/// </remarks>
+	struct busy_poll {
+		std::chrono::nanoseconds budget = std::chrono::microseconds(50);
+	};
+
+	/// <summary>
+	/// Receive a datagram with control data such as IP_PKTINFO or SO_TIMESTAMP.
+	/// </summary>
+	/// <returns>bytes received or SOCKET_ERROR</returns>
+	/// WSARecvMsg is an extension function that is looked up once.
+	inline int recvmsg(::SOCKET s, WSAMSG& msg)
+	{
+		static const LPFN_WSARECVMSG wsarecvmsg = [](::SOCKET _s) {
+			LPFN_WSARECVMSG f = nullptr;
+			GUID guid = WSAID_WSARECVMSG;
+			DWORD len = 0;
+			::WSAIoctl(_s, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid), &f, sizeof(f), &len, nullptr, nullptr);
+
+			return f;
+		}(s);
+		DWORD len = 0;
+
+		if (!wsarecvmsg || SOCKET_ERROR == wsarecvmsg(s, &msg, &len, nullptr, nullptr)) {
+			return SOCKET_ERROR;
+		}
+
+		return static_cast<int>(len);
+	}
+
 	/// <summary>
 	/// Sockets parameterized by address family.
 	/// </summary>
@@ -57,6 +99,11 @@ namespace winsock {
 		{
 			s = ::socket(static_cast<int>(af), static_cast<int>(type), static_cast<int>(proto));
 		}
+		/// Create a socket from protocol info returned by WSADuplicateSocket.
+		explicit socket(const WSAPROTOCOL_INFO& info)
+			: s(::WSASocket(FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO,
+				const_cast<WSAPROTOCOL_INFO*>(&info), 0, WSA_FLAG_NO_HANDLE_INHERIT))
+		{ }
 		socket(const socket&) = delete;
 		socket& operator=(const socket&) = delete;
 		socket(socket&& _s) noexcept
@@ -107,6 +154,33 @@ namespace winsock {
 			return ai;
 		}
 
+		/// <summary>
+		/// Protocol info used to create a duplicate of the socket in process pid.
+		/// </summary>
+		/// The underlying socket stays open until every duplicate is closed.
+		WSAPROTOCOL_INFO protocol_info(DWORD pid = ::GetCurrentProcessId()) const
+		{
+			WSAPROTOCOL_INFO info;
+
+			memset(&info, 0, sizeof(info));
+			::WSADuplicateSocket(s, pid, &info);
+
+			return info;
+		}
+		/// Another socket in this process sharing the same underlying socket.
+		socket duplicate() const
+		{
+			return socket(protocol_info());
+		}
+
+		/// Set non-blocking mode for use with an event loop.
+		int nonblocking(bool on = true) const
+		{
+			u_long mode = on ? 1 : 0;
+
+			return ::ioctlsocket(s, FIONBIO, &mode);
+		}
+
 		/// <summary>
 		/// Retrieves the local name for a socket.
 		/// </summary>
@@ -116,7 +190,9 @@ namespace winsock {
 		{
 			sockaddr<af> sa;
 
-			ensure (0 == ::getsockname(s, &sa, &sa.len));
+			if (0 != ::getsockname(s, &sa, &sa.len)) {
+				throw std::runtime_error("getsockname failed");
+			}
 
 			return sa;
 		}
@@ -177,16 +253,18 @@ namespace winsock {
 		// Return socket on connection queue and fill in who connected.
 		::SOCKET accept(::sockaddr* addr, int* len) const
 		{
-			return ::accept(s, addr, len);
+			trace::span t(trace::OP::ACCEPT, s);
+
+			return t(::accept(s, addr, len));
 		}
 		socket accept(sockaddr<af>& sa) const
 		{
-			return socket(::accept(s, &sa, &sa.len));
+			return socket(accept(&sa, &sa.len));
 		}
 		// Ignore who connected.
 		socket accept() const
 		{
-			return socket(::accept(s, 0, 0));
+			return socket(accept(nullptr, nullptr));
 		}
 
 		//
@@ -194,11 +272,13 @@ namespace winsock {
 		//
 		int connect(const ::sockaddr* addr, int len) const
 		{
-			return ::connect(s, addr, len);
+			trace::span t(trace::OP::CONNECT, s);
+
+			return t(::connect(s, addr, len));
 		}
 		int connect(const sockaddr<af>& sa) const
 		{
-			return ::connect(s, &sa, sa.len);
+			return connect(&sa, sa.len);
 		}
 		int connect(const addrinfo<af>& ai) const
 		{
@@ -226,8 +306,9 @@ namespace winsock {
 			if (0 == len) {
 				len = static_cast<int>(strlen(msg));
 			}
+			trace::span t(trace::OP::SEND, s);
 
-			return ::send(s, msg, len, static_cast<int>(flags));
+			return t(::send(s, msg, len, static_cast<int>(flags)));
 		}
 		// Send data in chunks of sndbuf and return total characters sent.
 		template<class T>
@@ -249,57 +330,35 @@ namespace winsock {
 
 			return len;
 		}
-		/*
-		socket& operator<<(std::istream& msg)
+		//
+		// recv
+		//
+		int recv(char* buf, int len, RCV_MSG flags = RCV_MSG::DEFAULT) const
 		{
-			if (SOCKET_ERROR == send(msg)) {
-				throw std::runtime_error("winsock::socket::opertor<< failed");
-			}
+			trace::span t(trace::OP::RECV, s);
 
-			return *this;
+			return t(::recv(s, buf, len, static_cast<int>(flags)));
 		}
+		// Spin on a non-blocking socket for the busy poll budget then block until readable.
+		int recv(char* buf, int len, const busy_poll& spin, RCV_MSG flags = RCV_MSG::DEFAULT) const
+		{
+			using clock = std::chrono::steady_clock;
+			auto end = clock::now() + spin.budget;
 
-		// istream proxy
-		class istream_proxy {
-			SND_MSG flags;
-		public:
-			istream_proxy(const SND_MSG& flags)
-				: flags(flags)
-			{ }
-			class send {
-				const socket<af>& s;
-				istream_proxy flags;
-			public:
-				send(const socket<af>& s, istream_proxy flags)
-					: s(s), flags(flags)
-				{ }
+			do {
+				int ret = recv(buf, len, flags);
+				if (SOCKET_ERROR != ret || WSAEWOULDBLOCK != ::WSAGetLastError()) {
+					return ret;
+				}
+				YieldProcessor();
+			} while (clock::now() < end);
 
-				template<class B>
-				send& operator<<(B msg)
-				{
-					s.send(msg, flags.flags);
+			WSAPOLLFD fd{ s, POLLRDNORM, 0 };
+			if (SOCKET_ERROR == ::WSAPoll(&fd, 1, -1)) {
+				return SOCKET_ERROR;
+			}
 
-					return *this;
-				}
-			};
-		};
-		// s << flags(SND_MSG::XXX) << is ...
-		static istream_proxy flags(const SND_MSG& flags)
-		{
-			return istream_proxy(flags);
-		}
-		//!! static istream_proxy sndbuf(int)
-		typename istream_proxy::send operator<<(const istream_proxy& flags)
-		{
-			return istream_proxy::send(*this, flags);
-		}	
-		*/
-		//
-		// recv
-		//
-		int recv(char* buf, int len, RCV_MSG flags = RCV_MSG::DEFAULT) const
-		{
-			return ::recv(s, buf, len, static_cast<int>(flags));
+			return recv(buf, len, flags);
 		}
 		int recv(buffer<char>& buf, RCV_MSG flags = RCV_MSG::DEFAULT, int rcvbuf = 0) const
 		{
@@ -325,61 +384,13 @@ namespace winsock {
 
 			return len;
   		}
-		/*
-		template<class B>
-		socket& operator>>(obuffer<B>& buf)
-		{
-			int ret = recv(buf);
-			if (SOCKET_ERROR == ret) {
-				throw std::runtime_error("winsock::socket::opertor<< failed");
-			}
-
-			return *this;
-		}
-		socket& operator>>(std::ostream& os)
-		{
-			obuffer buf(std::ref(os));
+		// iostreams over sockets are socket_stream in winsock_stream.h
 
-			return operator>>(buf);
-		}
-		
-
-		// ostream proxy
-		class ostream_proxy {
-			RCV_MSG flags;
-		public:
-			ostream_proxy(const RCV_MSG& flags)
-				: flags(flags)
-			{ }
-			class recv {
-				const socket<af>& s;
-				ostream_proxy flags;
-			public:
-				recv(const socket<af>& s, ostream_proxy flags)
-					: s(s), flags(flags)
-				{ }
-				template<class B>
-				recv& operator>>(B& buf)
-				{
-					s.recv(obuffer(buf), flags.flags);
-
-					return *this;
-				}
-			};
-		};
-		// s >> flags(RCV_MSG::XXX) >> os ...
-		static ostream_proxy flags(const RCV_MSG& flags)
-		{
-			return ostream_proxy(flags);
-		}
-		typename ostream_proxy::recv operator<<(const ostream_proxy& flags)
-		{
-			return ostream_proxy::recv(*this, flags);
-		}
-		*/
 		int sendto(const char* buf, int len, SND_MSG flags, const ::sockaddr* to, int tolen)  const
 		{
-			return ::sendto(s, buf, len, static_cast<int>(flags), to, tolen);
+			trace::span t(trace::OP::SENDTO, s);
+
+			return t(::sendto(s, buf, len, static_cast<int>(flags), to, tolen));
 		}
 		int sendto(const sockaddr<af>& to, const char* buf, int len, SND_MSG flags = SND_MSG::DEFAULT)  const//???MSG::CONFIRM
 		{
@@ -388,18 +399,157 @@ namespace winsock {
 
 		int recvfrom(char* buf, int len, RCV_MSG flags, ::sockaddr* from, int* fromlen) const
 		{
-			return ::recvfrom(s, buf, len, static_cast<int>(flags), from, fromlen);
+			trace::span t(trace::OP::RECVFROM, s);
+
+			return t(::recvfrom(s, buf, len, static_cast<int>(flags), from, fromlen));
 		}
 		int recvfrom(sockaddr<af>& from, char* buf, int len, RCV_MSG flags = RCV_MSG::DEFAULT) const
 		{
 			return recvfrom(buf, len, flags, &from, &from.len);
 		}
 
+		/// Receive a datagram with control data such as IP_PKTINFO.
+		int recvmsg(WSAMSG& msg) const
+		{
+			return winsock::recvmsg(s, msg);
+		}
+
 	};
 	static_assert(sizeof(winsock::socket<>) == sizeof(::SOCKET));
 
+	/// <summary>
+	/// Snapshot of the stack's state for a TCP connection from SIO_TCP_INFO.
+	/// </summary>
+	/// <remarks>
+	/// Windows versions with only TCP_INFO_v0 leave <c>v1</c> false and the time limited
+	/// by the receive window, congestion window, and send buffer zero.
+	/// </remarks>
+	struct tcp_info {
+		TCPSTATE state;
+		ULONG mss;
+		std::chrono::milliseconds age;       // since the connection was made
+		bool timestamps;
+		std::chrono::microseconds rtt;       // smoothed round trip time
+		std::chrono::microseconds min_rtt;
+		ULONG unacked;                       // bytes in flight
+		ULONG cwnd, snd_wnd, rcv_wnd, rcv_buf; // bytes
+		ULONG64 bytes_out, bytes_in;
+		ULONG bytes_reordered, bytes_retrans;
+		ULONG fast_retrans, dup_acks_in, timeouts;
+		UCHAR syn_retrans;
+		bool v1;
+		std::chrono::milliseconds rwnd_limited;   // sender waiting for the peer's receive window
+		std::chrono::milliseconds cwnd_limited;   // sender waiting for the congestion window
+		std::chrono::milliseconds sndbuf_limited; // sender waiting for the application
+	};
+
 	// Specialize default values for constructor and member functions.
 	namespace tcp {
+
+		/// Named sets of socket options.
+		enum class PROFILE {
+			LOW_LATENCY,     // no Nagle, acknowledge every segment
+			BULK_THROUGHPUT, // Nagle, large socket buffers
+		};
+
+		/// <summary>
+		/// Apply the options of a profile and read them back.
+		/// </summary>
+		/// <returns>0 if every option took effect, otherwise SOCKET_ERROR</returns>
+		/// <remarks>
+		/// Windows has no TCP_QUICKACK so <c>LOW_LATENCY</c> sets SIO_TCP_SET_ACK_FREQUENCY to 1
+		/// to disable delayed acknowledgements. Call on a listening socket before <c>listen</c>
+		/// and accepted sockets inherit the options.
+		/// </remarks>
+		inline int tune(::SOCKET s, PROFILE profile)
+		{
+			int ret = 0;
+			auto check = [&ret](bool ok) {
+				if (!ok) {
+					ret = SOCKET_ERROR;
+				}
+			};
+
+			switch (profile) {
+			case PROFILE::LOW_LATENCY: {
+				check(0 == sockopt<TCP_OPT::NODELAY>(s, TRUE));
+				check(TRUE == sockopt<TCP_OPT::NODELAY>(s));
+				int freq = 1;
+				DWORD len = 0;
+				check(0 == ::WSAIoctl(s, SIO_TCP_SET_ACK_FREQUENCY, &freq, sizeof(freq), nullptr, 0, &len, nullptr, nullptr));
+				break;
+			}
+			case PROFILE::BULK_THROUGHPUT: {
+				const int size = 4 << 20;
+				check(0 == sockopt<TCP_OPT::NODELAY>(s, FALSE));
+				check(FALSE == sockopt<TCP_OPT::NODELAY>(s));
+				check(0 == sockopt<SET_SO::SNDBUF>(s, size));
+				check(size == sockopt<GET_SO::SNDBUF>(s));
+				check(0 == sockopt<SET_SO::RCVBUF>(s, size));
+				check(size == sockopt<GET_SO::RCVBUF>(s));
+				break;
+			}
+			default:
+				ret = SOCKET_ERROR;
+			}
+
+			return ret;
+		}
+
+		/// <summary>
+		/// Fill i with the state of the connected socket s.
+		/// </summary>
+		/// <returns>0 on success, otherwise SOCKET_ERROR</returns>
+		/// <remarks>
+		/// Version 1 is asked for until the stack refuses it once, then version 0.
+		/// The call does not touch the network and costs about as much as a <c>getsockopt</c>.
+		/// </remarks>
+		inline int info(::SOCKET s, tcp_info& i)
+		{
+			static std::atomic<DWORD> supported = 1;
+			DWORD version = supported.load(std::memory_order_relaxed);
+			TCP_INFO_v1 ti{}; // starts with the fields of TCP_INFO_v0
+			DWORD len = 0;
+
+			int ret = ::WSAIoctl(s, SIO_TCP_INFO, &version, sizeof(version), &ti, static_cast<DWORD>(version ? sizeof(TCP_INFO_v1) : sizeof(TCP_INFO_v0)), &len, nullptr, nullptr);
+			if (SOCKET_ERROR == ret && 1 == version) {
+				version = 0;
+				ret = ::WSAIoctl(s, SIO_TCP_INFO, &version, sizeof(version), &ti, sizeof(TCP_INFO_v0), &len, nullptr, nullptr);
+				if (0 == ret) {
+					supported.store(0, std::memory_order_relaxed);
+				}
+			}
+			if (0 != ret) {
+				return SOCKET_ERROR;
+			}
+
+			i.state = ti.State;
+			i.mss = ti.Mss;
+			i.age = std::chrono::milliseconds(ti.ConnectionTimeMs);
+			i.timestamps = FALSE != ti.TimestampsEnabled;
+			i.rtt = std::chrono::microseconds(ti.RttUs);
+			i.min_rtt = std::chrono::microseconds(ti.MinRttUs);
+			i.unacked = ti.BytesInFlight;
+			i.cwnd = ti.Cwnd;
+			i.snd_wnd = ti.SndWnd;
+			i.rcv_wnd = ti.RcvWnd;
+			i.rcv_buf = ti.RcvBuf;
+			i.bytes_out = ti.BytesOut;
+			i.bytes_in = ti.BytesIn;
+			i.bytes_reordered = ti.BytesReordered;
+			i.bytes_retrans = ti.BytesRetrans;
+			i.fast_retrans = ti.FastRetrans;
+			i.dup_acks_in = ti.DupAcksIn;
+			i.timeouts = ti.TimeoutEpisodes;
+			i.syn_retrans = ti.SynRetrans;
+			i.v1 = 1 == version;
+			i.rwnd_limited = std::chrono::milliseconds(ti.SndLimTimeRwin);
+			i.cwnd_limited = std::chrono::milliseconds(ti.SndLimTimeCwnd);
+			i.sndbuf_limited = std::chrono::milliseconds(ti.SndLimTimeRSnd);
+
+			return 0;
+		}
+
 		namespace client {
 			template<AF af = AF::INET>
 			class socket : private winsock::socket<af> {
@@ -408,11 +558,21 @@ namespace winsock {
 				using winsock::socket<af>::operator ::SOCKET;
 				using winsock::socket<af>::sockname;
 				using winsock::socket<af>::peername;
+				using winsock::socket<af>::nonblocking;
 				using winsock::socket<af>::connect;
 				using winsock::socket<af>::send;
 				using winsock::socket<af>::recv;
-				//using winsock::socket<af>::operator<<;
-				//using winsock::socket<af>::operator>>;
+
+				// apply a named set of options
+				int tune(PROFILE profile) const
+				{
+					return tcp::tune(*this, profile);
+				}
+				// snapshot of the connection state
+				int info(tcp_info& i) const
+				{
+					return tcp::info(*this, i);
+				}
 
 				// create and connect socket
 				socket(const char* host, const char* port)
@@ -435,13 +595,19 @@ namespace winsock {
 				using winsock::socket<af>::operator ::SOCKET;
 				using winsock::socket<af>::sockname;
 				using winsock::socket<af>::peername;
+				using winsock::socket<af>::nonblocking;
+				using winsock::socket<af>::duplicate;
 				using winsock::socket<af>::bind;
 				using winsock::socket<af>::listen;
 				using winsock::socket<af>::accept;
 				using winsock::socket<af>::send;
 				using winsock::socket<af>::recv;
-				//using winsock::socket<af>::operator<<;
-				//using winsock::socket<af>::operator>>;
+
+				// apply a named set of options inherited by accepted sockets
+				int tune(PROFILE profile) const
+				{
+					return tcp::tune(*this, profile);
+				}
 
 				// create socket and bind
 				socket(const char* host, const char* port, AI flags = AI::PASSIVE)
@@ -464,6 +630,7 @@ namespace winsock {
 			public:
 				using winsock::socket<af>::socket;
 				using winsock::socket<af>::operator ::SOCKET;
+				using winsock::socket<af>::nonblocking;
 				using winsock::socket<af>::sendto;
 				using winsock::socket<af>::recvfrom;
 				socket()
@@ -476,6 +643,7 @@ namespace winsock {
 			class socket : private winsock::socket<af> {
 			public:
 				using winsock::socket<af>::operator ::SOCKET;
+				using winsock::socket<af>::nonblocking;
 				using winsock::socket<af>::sendto;
 				using winsock::socket<af>::recvfrom;
 
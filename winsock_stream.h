@@ -0,0 +1,224 @@
+// winsock_stream.h - iostreams over sockets
+#pragma once
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <optional>
+#include <streambuf>
+#include "winsock_socket.h"
+
+namespace winsock {
+
+	/// <summary>
+	/// Stream buffer whose put and get areas are the socket send and receive buffers.
+	/// </summary>
+	/// <remarks>
+	/// Formatted output is written straight into the put area and sent with one
+	/// <c>send</c> each time it fills or the stream is flushed. The get area is refilled
+	/// with one <c>recv</c>. Writes and reads at least as large as the area bypass it
+	/// and go directly to and from the caller's memory.
+	/// The areas are halves of an anonymous <c>iobuffer</c> unless the caller provides them.
+	/// The socket is not owned.
+	/// </remarks>
+	class socket_streambuf : public std::streambuf {
+		::SOCKET s;
+		std::optional<iobuffer<char>> region;
+		buffer_view<char> put, get;
+		SND_MSG snd;
+		RCV_MSG rcv;
+
+		// send [p, p + n) completely
+		bool send_all(const char* p, std::streamsize n)
+		{
+			while (n > 0) {
+				int len = static_cast<int>(std::min<std::streamsize>(n, INT_MAX));
+				int ret = ::send(s, p, len, static_cast<int>(snd));
+				if (SOCKET_ERROR == ret) {
+					return false;
+				}
+				++sends;
+				p += ret;
+				n -= ret;
+			}
+
+			return true;
+		}
+		bool flush()
+		{
+			bool ret = send_all(pbase(), pptr() - pbase());
+			setp(put.buf, put.buf + put.len);
+
+			return ret;
+		}
+	public:
+		// counters for measuring system calls
+		size_t sends, recvs;
+
+		/// Use caller provided put and get areas.
+		socket_streambuf(::SOCKET _s, buffer_view<char> _put, buffer_view<char> _get)
+			: s(_s), put(_put), get(_get), snd(SND_MSG::DEFAULT), rcv(RCV_MSG::DEFAULT), sends(0), recvs(0)
+		{
+			setp(put.buf, put.buf + put.len);
+			setg(get.buf, get.buf, get.buf); // empty
+		}
+		/// Put and get areas of size bytes each.
+		socket_streambuf(::SOCKET _s, DWORD size = 0x10000)
+			: socket_streambuf(_s, buffer_view<char>{}, buffer_view<char>{})
+		{
+			region.emplace(2 * size);
+			if (!region->buf) {
+				throw std::runtime_error("winsock::socket_streambuf: iobuffer failed");
+			}
+			put = buffer_view<char>{ region->buf, static_cast<int>(size) };
+			get = buffer_view<char>{ region->buf + size, static_cast<int>(size) };
+			setp(put.buf, put.buf + put.len);
+			setg(get.buf, get.buf, get.buf);
+		}
+		socket_streambuf(const socket_streambuf&) = delete;
+		socket_streambuf& operator=(const socket_streambuf&) = delete;
+		~socket_streambuf()
+		{
+			sync();
+		}
+
+		/// Flags for following sends. Pending output is sent with the old flags.
+		void flags(SND_MSG _snd)
+		{
+			sync();
+			snd = _snd;
+		}
+		/// Flags for following receives.
+		void flags(RCV_MSG _rcv)
+		{
+			rcv = _rcv;
+		}
+	protected:
+		int_type overflow(int_type c) override
+		{
+			if (!flush()) {
+				return traits_type::eof();
+			}
+			if (!traits_type::eq_int_type(c, traits_type::eof())) {
+				*pptr() = traits_type::to_char_type(c);
+				pbump(1);
+			}
+
+			return traits_type::not_eof(c);
+		}
+		int sync() override
+		{
+			return pptr() == pbase() || flush() ? 0 : -1;
+		}
+		std::streamsize xsputn(const char* p, std::streamsize n) override
+		{
+			if (n < put.len) {
+				return std::streambuf::xsputn(p, n);
+			}
+			// large write, no copy
+			if (!flush() || !send_all(p, n)) {
+				return 0;
+			}
+
+			return n;
+		}
+
+		int_type underflow() override
+		{
+			if (gptr() < egptr()) {
+				return traits_type::to_int_type(*gptr());
+			}
+			int ret = ::recv(s, get.buf, get.len, static_cast<int>(rcv));
+			++recvs;
+			if (ret <= 0) {
+				return traits_type::eof();
+			}
+			setg(get.buf, get.buf, get.buf + ret);
+
+			return traits_type::to_int_type(*gptr());
+		}
+		std::streamsize xsgetn(char* p, std::streamsize n) override
+		{
+			// buffered bytes first
+			std::streamsize m = std::min<std::streamsize>(n, egptr() - gptr());
+			std::copy(gptr(), gptr() + m, p);
+			gbump(static_cast<int>(m));
+			if (n - m < get.len) {
+				return m + std::streambuf::xsgetn(p + m, n - m);
+			}
+			// large read, no copy
+			while (m < n) {
+				int len = static_cast<int>(std::min<std::streamsize>(n - m, INT_MAX));
+				int ret = ::recv(s, p + m, len, static_cast<int>(rcv));
+				++recvs;
+				if (ret <= 0) {
+					break;
+				}
+				m += ret;
+			}
+
+			return m;
+		}
+	};
+
+	/// <summary>
+	/// Formatted input and output on a connected socket.
+	/// </summary>
+	/// <remarks>
+	/// <c>s &lt;&lt; flags(SND_MSG::DONTROUTE) &lt;&lt; ...</c> sets the flags of following sends.
+	/// Output is sent when the put area fills or the stream is flushed, e.g. by <c>std::flush</c>.
+	/// </remarks>
+	class socket_stream : public std::iostream {
+		socket_streambuf sb;
+	public:
+		socket_stream(::SOCKET s, DWORD size = 0x10000)
+			: std::iostream(nullptr), sb(s, size)
+		{
+			rdbuf(&sb);
+		}
+		socket_stream(::SOCKET s, buffer_view<char> put, buffer_view<char> get)
+			: std::iostream(nullptr), sb(s, put, get)
+		{
+			rdbuf(&sb);
+		}
+		socket_stream(const socket_stream&) = delete;
+		socket_stream& operator=(const socket_stream&) = delete;
+		~socket_stream()
+		{ }
+
+		socket_streambuf& streambuf()
+		{
+			return sb;
+		}
+	};
+
+	// stream manipulators
+	template<class MSG>
+	struct msg_flags {
+		MSG flags;
+	};
+	inline msg_flags<SND_MSG> flags(SND_MSG f)
+	{
+		return msg_flags<SND_MSG>{ f };
+	}
+	inline msg_flags<RCV_MSG> flags(RCV_MSG f)
+	{
+		return msg_flags<RCV_MSG>{ f };
+	}
+	inline std::ostream& operator<<(std::ostream& os, msg_flags<SND_MSG> f)
+	{
+		if (auto sb = dynamic_cast<socket_streambuf*>(os.rdbuf())) {
+			sb->flags(f.flags);
+		}
+
+		return os;
+	}
+	inline std::istream& operator>>(std::istream& is, msg_flags<RCV_MSG> f)
+	{
+		if (auto sb = dynamic_cast<socket_streambuf*>(is.rdbuf())) {
+			sb->flags(f.flags);
+		}
+
+		return is;
+	}
+
+}
@@ -0,0 +1,63 @@
+// winsock_stream.t.cpp - test iostreams over sockets
+#include <cassert>
+#include <string>
+#include <vector>
+#include "winsock_stream.h"
+
+using namespace winsock;
+
+int test_socket_stream()
+{
+	tcp::server::socket<> srv("localhost", "6798");
+	srv.listen();
+	tcp::client::socket<> cli("localhost", "6798");
+	winsock::socket<> t = srv.accept();
+
+	{
+		socket_stream os(cli, 0x1000);
+		socket_stream is(t, 0x1000);
+
+		// formatted output is buffered until flushed
+		for (int i = 0; i < 100; ++i) {
+			os << i << ' ';
+		}
+		assert(0 == os.streambuf().sends);
+		os << "end\n" << std::flush;
+		assert(1 == os.streambuf().sends);
+
+		int j;
+		for (int i = 0; i < 100; ++i) {
+			is >> j;
+			assert(i == j);
+		}
+		std::string s;
+		is >> s;
+		assert("end" == s);
+		is.ignore(1); // newline
+
+		// larger than the put and get areas, sent and received without copying
+		std::vector<char> big(0x2000, 'x'), got(big.size());
+		os.write(big.data(), big.size());
+		os.flush();
+		is.read(got.data(), got.size());
+		assert(is.gcount() == static_cast<std::streamsize>(got.size()));
+		assert(big == got);
+
+		os << flags(SND_MSG::DONTROUTE) << "flags" << std::endl;
+		is >> flags(RCV_MSG::DEFAULT) >> s;
+		assert("flags" == s);
+	}
+	{
+		// caller provided areas
+		char put[2][16], get[2][16];
+		socket_stream os(cli, buffer_view<char>{ put[0], 16 }, buffer_view<char>{ get[0], 16 });
+		socket_stream is(t, buffer_view<char>{ put[1], 16 }, buffer_view<char>{ get[1], 16 });
+		os << "0123456789abcdef" << "xyz\n" << std::flush;
+		std::string s;
+		is >> s;
+		assert("0123456789abcdefxyz" == s);
+	}
+
+	return 0;
+}
+int test_socket_stream_ = test_socket_stream();
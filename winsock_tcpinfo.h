@@ -0,0 +1,211 @@
+// winsock_tcpinfo.h - sample TCP_INFO across connections to spot slow peers and bufferbloat
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "winsock_timer.h"
+#include "winsock_socket.h"
+
+namespace winsock::tcp {
+
+	// what a sample says is wrong with a connection
+	enum class HEALTH {
+		OK = 0,
+		QUEUEING = 1, // rtt well above the minimum, a queue is building on the path
+		RECEIVER = 2, // waiting for the peer's receive window, the peer is not reading
+		LOSS = 4,     // retransmitting more than the limit
+	};
+	DEFINE_ENUM_FLAG_OPERATORS(HEALTH);
+
+	// when a connection is unhealthy
+	struct limits {
+		std::chrono::microseconds queueing = std::chrono::milliseconds(20); // rtt above min rtt
+		double receiver = 0.5; // fraction of the interval limited by the receive window
+		double loss = 0.02;    // bytes retransmitted per byte sent in the interval
+	};
+
+	/// <summary>
+	/// Latest snapshot of a connection and what changed since the one before.
+	/// </summary>
+	struct stats {
+		tcp_info info;
+		uint64_t samples;
+		std::chrono::microseconds rtt_max; // over all samples
+		// between the last two samples
+		timer_wheel::clock::duration interval;
+		uint64_t bytes_out;
+		ULONG bytes_retrans;
+		ULONG timeouts;
+		std::chrono::milliseconds rwnd_limited;
+		HEALTH health;
+
+		// delay added by queues, rtt less the smallest seen
+		std::chrono::microseconds queueing() const
+		{
+			return info.rtt - info.min_rtt;
+		}
+	};
+
+	/// <summary>
+	/// Per connection statistics from periodic TCP_INFO snapshots.
+	/// </summary>
+	/// <remarks>
+	/// Each <c>sample(n)</c> takes a snapshot of the next n connections in turn, so the cost of a
+	/// tick is bounded however many connections there are and every one is seen every
+	/// <c>size() / n</c> ticks. <c>every</c> does that on a timer. A connection that crosses one
+	/// of the <c>limits</c> is passed to the <c>alert</c> handler after the sample, where it may
+	/// be removed. Connections whose snapshot fails, e.g. because they were closed, are skipped.
+	/// Sockets are not owned.
+	/// </remarks>
+	class monitor {
+	public:
+		using handler = std::function<void(::SOCKET, const stats&)>;
+		using clock = timer_wheel::clock;
+	private:
+		struct entry {
+			::SOCKET s;
+			clock::time_point at; // of the last sample
+			stats st;
+		};
+
+		handler alert;
+		limits lim;
+		std::vector<entry> entries;
+		std::unordered_map<::SOCKET, size_t> index;
+		size_t cursor;
+		std::vector<std::pair<::SOCKET, stats>> unhealthy; // copies, the handler may remove connections
+		timer tick;
+
+		HEALTH judge(const stats& st) const
+		{
+			HEALTH h = HEALTH::OK;
+
+			if (st.queueing() > lim.queueing) {
+				h |= HEALTH::QUEUEING;
+			}
+			// a zero window means the peer's receive buffer is full
+			if (0 == st.info.snd_wnd ||
+				(st.interval > clock::duration::zero() && st.rwnd_limited > st.interval * lim.receiver)) {
+				h |= HEALTH::RECEIVER;
+			}
+			if (st.bytes_out && static_cast<double>(st.bytes_retrans) > lim.loss * static_cast<double>(st.bytes_out)) {
+				h |= HEALTH::LOSS;
+			}
+
+			return h;
+		}
+		bool snapshot(entry& e, clock::time_point now)
+		{
+			tcp_info i;
+			if (SOCKET_ERROR == tcp::info(e.s, i)) {
+				return false;
+			}
+
+			stats& st = e.st;
+			if (st.samples) {
+				st.interval = now - e.at;
+				st.bytes_out = i.bytes_out - st.info.bytes_out;
+				st.bytes_retrans = i.bytes_retrans - st.info.bytes_retrans;
+				st.timeouts = i.timeouts - st.info.timeouts;
+				st.rwnd_limited = std::max(i.rwnd_limited - st.info.rwnd_limited, std::chrono::milliseconds::zero());
+			}
+			e.at = now;
+			st.info = i;
+			++st.samples;
+			st.rtt_max = std::max(st.rtt_max, i.rtt);
+			st.health = judge(st);
+
+			return true;
+		}
+	public:
+		monitor(handler _alert = nullptr, const limits& _lim = limits{})
+			: alert(std::move(_alert)), lim(_lim), cursor(0)
+		{ }
+		monitor(const monitor&) = delete;
+		monitor& operator=(const monitor&) = delete;
+		~monitor()
+		{ }
+
+		/// Watch the connected socket s.
+		void add(::SOCKET s)
+		{
+			if (!index.contains(s)) {
+				index[s] = entries.size();
+				entries.push_back(entry{ s, clock::time_point{}, stats{} });
+			}
+		}
+		void remove(::SOCKET s)
+		{
+			auto i = index.find(s);
+			if (i != index.end()) {
+				size_t k = i->second;
+				index.erase(i);
+				if (k + 1 != entries.size()) {
+					entries[k] = entries.back();
+					index[entries[k].s] = k;
+				}
+				entries.pop_back();
+				if (cursor > k) {
+					--cursor;
+				}
+			}
+		}
+		size_t size() const
+		{
+			return entries.size();
+		}
+		// latest statistics of s or nullptr
+		const stats* find(::SOCKET s) const
+		{
+			auto i = index.find(s);
+
+			return i == index.end() ? nullptr : &entries[i->second].st;
+		}
+
+		/// Snapshot the next n connections in turn and alert on unhealthy ones.
+		/// Returns the number sampled.
+		size_t sample(size_t n = SIZE_MAX)
+		{
+			auto now = clock::now();
+			size_t m = 0;
+
+			unhealthy.clear();
+			n = std::min(n, entries.size());
+			for (size_t k = 0; k < n; ++k) {
+				if (cursor >= entries.size()) {
+					cursor = 0;
+				}
+				entry& e = entries[cursor++];
+				if (snapshot(e, now)) {
+					++m;
+					if (alert && HEALTH::OK != e.st.health) {
+						unhealthy.emplace_back(e.s, e.st);
+					}
+				}
+			}
+			for (const auto& [s, st] : unhealthy) {
+				alert(s, st);
+			}
+
+			return m;
+		}
+
+		/// Sample n connections every period on the wheel of an event loop.
+		void every(timer_wheel& wheel, clock::duration period, size_t n = 64)
+		{
+			tick.expire = [this, &wheel, period, n](timer&) {
+				sample(n);
+				wheel.schedule(tick, period);
+			};
+			wheel.schedule(tick, period);
+		}
+		void stop()
+		{
+			tick.cancel();
+		}
+	};
+
+}
@@ -0,0 +1,83 @@
+// winsock_tcpinfo.t.cpp - test TCP_INFO snapshots and connection health
+#include <cassert>
+#include <vector>
+#include "winsock_tcpinfo.h"
+
+using namespace winsock;
+
+int test_tcp_info()
+{
+	tcp::server::socket<> srv("localhost", "6823");
+	srv.listen();
+	tcp::client::socket<> cli("localhost", "6823");
+	winsock::socket<> s = srv.accept();
+
+	std::vector<char> buf(64 * 1024, 'x');
+	assert(static_cast<int>(buf.size()) == cli.send(buf.data(), static_cast<int>(buf.size())));
+	assert(static_cast<int>(buf.size()) == s.recv(buf.data(), static_cast<int>(buf.size()), RCV_MSG::WAITALL));
+
+	tcp_info i;
+	assert(0 == cli.info(i));
+	assert(TCPSTATE_ESTABLISHED == i.state);
+	assert(0 < i.mss);
+	assert(buf.size() <= i.bytes_out);
+	assert(0 == tcp::info(s, i));
+	assert(buf.size() <= i.bytes_in);
+
+	// not connected
+	tcp::client::socket<> none(SOCK::STREAM, IPPROTO::TCP);
+	assert(SOCKET_ERROR == tcp::info(none, i));
+	assert(SOCKET_ERROR == tcp::info(INVALID_SOCKET, i));
+
+	{
+		std::vector<::SOCKET> alerts;
+		tcp::monitor m([&alerts](::SOCKET a, const tcp::stats& st) {
+			assert(tcp::HEALTH::OK != st.health);
+			alerts.push_back(a);
+		});
+		m.add(cli);
+		m.add(s);
+		m.add(cli);
+		assert(2 == m.size());
+
+		// round robin
+		assert(1 == m.sample(1));
+		assert(1 == m.find(cli)->samples && 0 == m.find(s)->samples);
+		assert(1 == m.sample(1));
+		assert(1 == m.find(s)->samples);
+		assert(2 == m.sample());
+
+		assert(static_cast<int>(buf.size()) == cli.send(buf.data(), static_cast<int>(buf.size())));
+		assert(static_cast<int>(buf.size()) == s.recv(buf.data(), static_cast<int>(buf.size()), RCV_MSG::WAITALL));
+		assert(2 == m.sample());
+		const tcp::stats* st = m.find(cli);
+		assert(3 == st->samples);
+		assert(buf.size() <= st->bytes_out);
+		assert(st->info.rtt <= st->rtt_max);
+		assert(alerts.empty());
+
+		m.remove(cli);
+		assert(1 == m.size() && nullptr == m.find(cli));
+	}
+
+	{
+		// every rtt is over a negative limit, the handler may remove what it is given
+		tcp::limits lim;
+		lim.queueing = std::chrono::microseconds(-1);
+		size_t alerts = 0;
+		tcp::monitor* pm = nullptr;
+		tcp::monitor m([&pm, &alerts](::SOCKET a, const tcp::stats& st) {
+			assert(tcp::HEALTH::QUEUEING == (st.health & tcp::HEALTH::QUEUEING));
+			++alerts;
+			pm->remove(a);
+		}, lim);
+		pm = &m;
+		m.add(cli);
+		m.add(s);
+		assert(2 == m.sample());
+		assert(2 == alerts && 0 == m.size());
+	}
+
+	return 0;
+}
+int test_tcp_info_ = test_tcp_info();
@@ -0,0 +1,383 @@
+// winsock_timer.h - hierarchical timing wheel for connection deadlines
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace winsock {
+
+	class timer_wheel;
+
+	// doubly linked list hook, slots are sentinels so unlinking never needs the list head
+	struct timer_link {
+		timer_link* prev;
+		timer_link* next;
+
+		timer_link()
+			: prev(this), next(this)
+		{ }
+		timer_link(const timer_link&) = delete;
+		timer_link& operator=(const timer_link&) = delete;
+
+		bool empty() const
+		{
+			return next == this;
+		}
+		void unlink()
+		{
+			prev->next = next;
+			next->prev = prev;
+			prev = next = this;
+		}
+		// insert t before this
+		void push_back(timer_link& t)
+		{
+			t.prev = prev;
+			t.next = this;
+			prev->next = &t;
+			prev = &t;
+		}
+		// move all nodes to the empty list l
+		void splice(timer_link& l)
+		{
+			if (!empty()) {
+				l.next = next;
+				l.prev = prev;
+				next->prev = &l;
+				prev->next = &l;
+				prev = next = this;
+			}
+		}
+	};
+
+	/// <summary>
+	/// Intrusive timer owned by the caller.
+	/// </summary>
+	/// <remarks>
+	/// A timer is in at most one wheel at a time. Arming, re-arming, and cancelling are O(1)
+	/// and never allocate. The destructor cancels an armed timer.
+	/// </remarks>
+	class timer : private timer_link {
+		friend class timer_wheel;
+		timer_wheel* wheel;
+		uint64_t expires; // absolute tick
+		unsigned char level, slot;
+	public:
+		std::function<void(timer&)> expire;
+
+		timer(std::function<void(timer&)> f = nullptr)
+			: wheel(nullptr), expires(0), level(0), slot(0), expire(std::move(f))
+		{ }
+		timer(const timer&) = delete;
+		timer& operator=(const timer&) = delete;
+		~timer()
+		{
+			cancel();
+		}
+
+		bool armed() const
+		{
+			return wheel != nullptr;
+		}
+		// tick the timer expires
+		uint64_t when() const
+		{
+			return expires;
+		}
+
+		inline void cancel();
+	};
+
+	/// <summary>
+	/// Hierarchical timing wheel.
+	/// </summary>
+	/// <remarks>
+	/// Each level has 64 slots and each level covers 64 times the range of the level below,
+	/// so six levels cover 2^36 ticks. Timers beyond that are parked in the last slot and
+	/// rescheduled when they get there. Insert and cancel are O(1). Timers on higher levels
+	/// cascade down one level every 64^level ticks so expiry is amortized O(1).
+	/// Occupancy bitmaps let <c>advance</c> skip empty slots and <c>timeout</c> report
+	/// how long a poll loop can sleep.
+	/// </remarks>
+	class timer_wheel {
+	public:
+		using clock = std::chrono::steady_clock;
+		static constexpr unsigned bits = 6;
+		static constexpr unsigned slots = 1u << bits;
+		static constexpr unsigned levels = 6;
+		static constexpr uint64_t range = uint64_t(1) << (bits * levels);
+	private:
+		friend class timer;
+		static constexpr uint64_t mask = slots - 1;
+
+		timer_link wheel[levels][slots];
+		uint64_t occupied[levels]; // bit i set if slot i may be nonempty
+		uint64_t cur;   // next tick to process
+		size_t count;   // armed timers
+		clock::duration resolution;
+		clock::time_point epoch;
+
+		void link(timer& t)
+		{
+			uint64_t when = std::max(t.expires, cur);
+			uint64_t d = when - cur;
+			if (d >= range) {
+				d = range - 1;
+				when = cur + d;
+			}
+			unsigned level = d < slots ? 0 : static_cast<unsigned>(std::bit_width(d) - 1) / bits;
+			unsigned slot = static_cast<unsigned>((when >> (bits * level)) & mask);
+
+			t.level = static_cast<unsigned char>(level);
+			t.slot = static_cast<unsigned char>(slot);
+			wheel[level][slot].push_back(t);
+			occupied[level] |= uint64_t(1) << slot;
+		}
+		void unlink(timer& t)
+		{
+			t.timer_link::unlink();
+			if (wheel[t.level][t.slot].empty()) {
+				occupied[t.level] &= ~(uint64_t(1) << t.slot);
+			}
+			t.wheel = nullptr;
+			--count;
+		}
+		// move timers in the current slot of level down the wheel
+		void cascade(unsigned level)
+		{
+			unsigned slot = static_cast<unsigned>((cur >> (bits * level)) & mask);
+			timer_link l;
+
+			wheel[level][slot].splice(l);
+			occupied[level] &= ~(uint64_t(1) << slot);
+			while (!l.empty()) {
+				timer& t = static_cast<timer&>(*l.next);
+				t.timer_link::unlink();
+				link(t);
+			}
+			if (level + 1 < levels && slot == 0) {
+				cascade(level + 1);
+			}
+		}
+		// first tick after cur where a cascade can bring timers down to level 0
+		uint64_t next_cascade() const
+		{
+			uint64_t when = UINT64_MAX;
+
+			if (0 == occupied[0]) {
+				for (unsigned level = 1; level < levels; ++level) {
+					if (occupied[level]) {
+						// the current slot was cascaded when cur entered it, so it is a full turn away
+						unsigned shift = bits * level;
+						uint64_t r = std::rotr(occupied[level], static_cast<int>((cur >> shift) & mask)) & ~uint64_t(1);
+						uint64_t k = r ? static_cast<uint64_t>(std::countr_zero(r)) : slots;
+						when = std::min(when, ((cur >> shift) + k) << shift);
+					}
+				}
+			}
+
+			return when == UINT64_MAX ? (cur | mask) + 1 : when;
+		}
+		// fire the level 0 slot for the current tick and move to the next tick
+		size_t expire()
+		{
+			size_t n = 0;
+			uint64_t now = cur++; // callbacks that re-arm in the past get the next tick
+			unsigned slot = static_cast<unsigned>(now & mask);
+			timer_link l;
+
+			wheel[0][slot].splice(l);
+			occupied[0] &= ~(uint64_t(1) << slot);
+			while (!l.empty()) {
+				timer& t = static_cast<timer&>(*l.next);
+				t.timer_link::unlink();
+				if (t.expires > now) {
+					// parked beyond range
+					link(t);
+					continue;
+				}
+				t.wheel = nullptr;
+				--count;
+				++n;
+				if (t.expire) {
+					t.expire(t); // may re-arm t or cancel other timers
+				}
+			}
+
+			return n;
+		}
+	public:
+		timer_wheel(clock::duration _resolution = std::chrono::milliseconds(1), clock::time_point _epoch = clock::now())
+			: occupied{}, cur(0), count(0), resolution(_resolution), epoch(_epoch)
+		{ }
+		timer_wheel(const timer_wheel&) = delete;
+		timer_wheel& operator=(const timer_wheel&) = delete;
+		~timer_wheel()
+		{
+			for (auto& level : wheel) {
+				for (auto& slot : level) {
+					while (!slot.empty()) {
+						static_cast<timer&>(*slot.next).cancel();
+					}
+				}
+			}
+		}
+
+		// number of armed timers
+		size_t size() const
+		{
+			return count;
+		}
+		// next tick to be processed
+		uint64_t tick() const
+		{
+			return cur;
+		}
+		// tick containing time point
+		uint64_t tick(clock::time_point tp) const
+		{
+			return tp <= epoch ? 0 : static_cast<uint64_t>((tp - epoch) / resolution);
+		}
+
+		/// Arm t to expire at absolute tick when. Ticks in the past expire on the next advance.
+		void schedule(timer& t, uint64_t when)
+		{
+			if (t.wheel) {
+				t.wheel->unlink(t);
+			}
+			t.wheel = this;
+			t.expires = std::max(when, cur);
+			++count;
+			link(t);
+		}
+		/// Arm t to expire no sooner than d from now.
+		void schedule(timer& t, clock::duration d)
+		{
+			schedule(t, tick(clock::now()) + static_cast<uint64_t>((d + resolution - clock::duration(1)) / resolution));
+		}
+
+		/// Process all ticks up to and including now and return the number of timers fired.
+		size_t advance(uint64_t now)
+		{
+			size_t n = 0;
+
+			while (cur <= now) {
+				if (0 == count) {
+					cur = now + 1;
+					break;
+				}
+				if (0 == (cur & mask)) {
+					cascade(1);
+				}
+				uint64_t pending = occupied[0] >> (cur & mask);
+				if (0 == pending) {
+					// nothing left in level 0, jump to the next cascade of an occupied slot
+					cur = std::min(now + 1, next_cascade());
+					continue;
+				}
+				uint64_t next = cur + std::countr_zero(pending);
+				if (next > now) {
+					cur = now + 1;
+					break;
+				}
+				cur = next;
+				n += expire();
+			}
+
+			return n;
+		}
+		size_t advance()
+		{
+			return advance(tick(clock::now()));
+		}
+
+		/// Time until the next timer might expire, or clock::duration::max() if none are armed.
+		/// Conservative: may be early when the next timer lives on a higher level.
+		clock::duration next() const
+		{
+			if (0 == count) {
+				return clock::duration::max();
+			}
+
+			uint64_t pending = occupied[0] >> (cur & mask);
+			uint64_t when = pending ? cur + std::countr_zero(pending) : next_cascade();
+			auto tp = epoch + resolution * static_cast<clock::rep>(when);
+			auto now = clock::now();
+
+			return tp > now ? tp - now : clock::duration::zero();
+		}
+		/// Milliseconds until the next timer might expire suitable for WSAPoll, -1 if none.
+		int timeout() const
+		{
+			auto d = next();
+			if (d == clock::duration::max()) {
+				return -1;
+			}
+			auto ms = std::chrono::ceil<std::chrono::milliseconds>(d).count();
+
+			return static_cast<int>(std::min<decltype(ms)>(ms, INT32_MAX));
+		}
+	};
+
+	inline void timer::cancel()
+	{
+		if (wheel) {
+			wheel->unlink(*this);
+		}
+	}
+
+	/// <summary>
+	/// Idle, read, write, and keepalive deadlines for one connection.
+	/// </summary>
+	/// <remarks>
+	/// A zero timeout disables the deadline. Call <c>activity</c> whenever bytes move to push
+	/// back the idle deadline and the next keepalive ping. Arm <c>read</c> and <c>write</c>
+	/// when an operation is started and cancel them when it completes.
+	/// </remarks>
+	class deadlines {
+		timer_wheel& wheel;
+	public:
+		using duration = timer_wheel::clock::duration;
+		struct timeouts {
+			duration idle{}, read{}, write{}, keepalive{};
+		} to;
+		timer idle, read, write, keepalive;
+
+		deadlines(timer_wheel& _wheel, const timeouts& _to)
+			: wheel(_wheel), to(_to)
+		{ }
+		deadlines(const deadlines&) = delete;
+		deadlines& operator=(const deadlines&) = delete;
+
+		void activity()
+		{
+			arm(idle, to.idle);
+			arm(keepalive, to.keepalive);
+		}
+		void reading()
+		{
+			arm(read, to.read);
+		}
+		void writing()
+		{
+			arm(write, to.write);
+		}
+		void cancel()
+		{
+			idle.cancel();
+			read.cancel();
+			write.cancel();
+			keepalive.cancel();
+		}
+	private:
+		void arm(timer& t, duration d)
+		{
+			if (d != duration::zero()) {
+				wheel.schedule(t, d);
+			}
+		}
+	};
+
+}
@@ -0,0 +1,149 @@
+// winsock_timer.t.cpp - test timer wheel and event loop
+#include <cassert>
+#include <vector>
+#include "winsock_loop.h"
+
+using namespace winsock;
+
+int test_timer_wheel()
+{
+	{
+		timer_wheel w;
+		std::vector<uint64_t> fired;
+		timer a([&](timer& t) { fired.push_back(t.when()); });
+		timer b([&](timer& t) { fired.push_back(t.when()); });
+		timer c([&](timer& t) { fired.push_back(t.when()); });
+
+		w.schedule(a, uint64_t(5));
+		w.schedule(b, uint64_t(100));   // level 1
+		w.schedule(c, uint64_t(70000)); // level 2
+		assert(3 == w.size());
+		assert(a.armed() && b.armed() && c.armed());
+
+		assert(0 == w.advance(4));
+		assert(1 == w.advance(5));
+		assert(!a.armed());
+		assert(1 == w.advance(100));
+		assert(1 == w.advance(1000000));
+		assert(0 == w.size());
+		assert((fired == std::vector<uint64_t>{ 5, 100, 70000 }));
+	}
+	{
+		timer_wheel w;
+		int n = 0;
+		timer a([&](timer&) { ++n; });
+
+		w.schedule(a, uint64_t(10));
+		a.cancel();
+		assert(!a.armed());
+		assert(0 == w.size());
+		assert(0 == w.advance(20));
+		assert(0 == n);
+
+		// re-arm moves the deadline
+		w.schedule(a, uint64_t(30));
+		w.schedule(a, uint64_t(40));
+		assert(1 == w.size());
+		assert(0 == w.advance(39));
+		assert(1 == w.advance(40));
+	}
+	{
+		// re-arm from the callback
+		timer_wheel w;
+		int n = 0;
+		timer a([&](timer& t) {
+			if (++n < 3) {
+				w.schedule(t, w.tick() + 10);
+			}
+		});
+
+		w.schedule(a, uint64_t(1));
+		w.advance(1000);
+		assert(3 == n);
+	}
+	{
+		// beyond the range of the wheel
+		timer_wheel w;
+		int n = 0;
+		timer a([&](timer&) { ++n; });
+
+		w.schedule(a, timer_wheel::range + 7);
+		assert(0 == w.advance(timer_wheel::range));
+		assert(0 == n);
+		assert(1 == w.advance(timer_wheel::range + 7));
+		assert(1 == n);
+	}
+	{
+		// destroying an armed timer unlinks it
+		timer_wheel w;
+		{
+			timer a;
+			w.schedule(a, uint64_t(3));
+			assert(1 == w.size());
+		}
+		assert(0 == w.size());
+	}
+
+	return 0;
+}
+int test_timer_wheel_ = test_timer_wheel();
+
+int test_deadlines()
+{
+	timer_wheel w;
+	deadlines::timeouts to;
+	to.idle = std::chrono::seconds(30);
+	to.keepalive = std::chrono::seconds(10);
+	deadlines d(w, to);
+
+	d.activity();
+	assert(d.idle.armed());
+	assert(d.keepalive.armed());
+	assert(!d.read.armed()); // disabled
+	d.reading();
+	assert(!d.read.armed());
+	d.cancel();
+	assert(0 == w.size());
+
+	return 0;
+}
+int test_deadlines_ = test_deadlines();
+
+int test_event_loop()
+{
+	{
+		event_loop loop;
+		int n = 0;
+		timer t([&](timer&) { ++n; });
+
+		loop.timers().schedule(t, std::chrono::milliseconds(5));
+		while (0 == n) {
+			loop.run_once(100);
+		}
+		assert(1 == n);
+	}
+	{
+		winsock::sockaddr<> sa(inaddr<>::loopback, 6790);
+		udp::server::socket<> srv(sa);
+		udp::client::socket<> cli;
+		event_loop loop;
+		int len = 0;
+
+		assert(0 == srv.nonblocking());
+		loop.add(srv, POLLRDNORM, [&](SHORT revents) {
+			char buf[16];
+			winsock::sockaddr<> from;
+			assert(revents & POLLRDNORM);
+			len = srv.recvfrom(from, buf, sizeof(buf));
+			loop.remove(srv);
+		});
+		assert(1 == loop.size());
+		assert(2 == cli.sendto(sa, "hi", 2));
+		assert(1 == loop.run_once(1000));
+		assert(2 == len);
+		assert(0 == loop.size());
+	}
+
+	return 0;
+}
+int test_event_loop_ = test_event_loop();
@@ -0,0 +1,227 @@
+// winsock_timestamp.h - receive and transmit timestamps for latency measurement
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include "winsock_socket.h"
+
+namespace winsock::timestamp {
+
+	/// <summary>
+	/// Timestamps are QueryPerformanceCounter ticks, the clock the stack stamps packets with.
+	/// </summary>
+	inline uint64_t now()
+	{
+		LARGE_INTEGER t;
+		::QueryPerformanceCounter(&t);
+
+		return static_cast<uint64_t>(t.QuadPart);
+	}
+	inline uint64_t frequency()
+	{
+		static const uint64_t f = []() {
+			LARGE_INTEGER t;
+			::QueryPerformanceFrequency(&t);
+
+			return static_cast<uint64_t>(t.QuadPart);
+		}();
+
+		return f;
+	}
+	// ticks to nanoseconds
+	inline double ns(uint64_t ticks)
+	{
+		return static_cast<double>(ticks) * 1e9 / static_cast<double>(frequency());
+	}
+
+	/// <summary>
+	/// Turn on receive and transmit timestamps with SIO_TIMESTAMPING.
+	/// </summary>
+	/// <remarks>
+	/// Windows timestamps UDP datagrams in the NIC when it supports it, otherwise in the stack.
+	/// This is the equivalent of SO_TIMESTAMPING. <c>tx</c> is how many transmit timestamps
+	/// the stack keeps until they are read with <c>sent</c>.
+	/// </remarks>
+	inline int enable(::SOCKET s, bool rx = true, USHORT tx = 0)
+	{
+		TIMESTAMPING_CONFIG config{};
+		DWORD len = 0;
+
+		config.Flags = (rx ? TIMESTAMPING_FLAG_RX : 0) | (tx ? TIMESTAMPING_FLAG_TX : 0);
+		config.TxTimestampsBuffered = tx;
+
+		return ::WSAIoctl(s, SIO_TIMESTAMPING, &config, sizeof(config), nullptr, 0, &len, nullptr, nullptr);
+	}
+
+	/// <summary>
+	/// Receive a datagram into buf and the time it arrived.
+	/// </summary>
+	/// <returns>bytes received or SOCKET_ERROR</returns>
+	/// <c>buf.len</c> is set to the bytes received. <c>rx</c> is 0 if the datagram was not stamped.
+	template<AF af>
+	inline int recvfrom(::SOCKET s, buffer_view<char>& buf, sockaddr<af>& from, uint64_t& rx)
+	{
+		char control[WSA_CMSG_SPACE(sizeof(UINT64))];
+		WSABUF data{ static_cast<ULONG>(buf.len), buf.buf };
+		WSAMSG msg;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.name = &from;
+		msg.namelen = from.len;
+		msg.lpBuffers = &data;
+		msg.dwBufferCount = 1;
+		msg.Control = WSABUF{ sizeof(control), control };
+
+		rx = 0;
+		int ret = winsock::recvmsg(s, msg);
+		if (SOCKET_ERROR == ret) {
+			return ret;
+		}
+		buf.len = ret;
+		for (WSACMSGHDR* c = WSA_CMSG_FIRSTHDR(&msg); c; c = WSA_CMSG_NXTHDR(&msg, c)) {
+			if (SOL_SOCKET == c->cmsg_level && SO_TIMESTAMP == c->cmsg_type) {
+				memcpy(&rx, WSA_CMSG_DATA(c), sizeof(rx));
+			}
+		}
+
+		return ret;
+	}
+
+	/// Send a datagram tagged with id to look up its transmit timestamp with <c>sent</c>.
+	template<AF af>
+	inline int sendto(::SOCKET s, const sockaddr<af>& to, const char* buf, int len, UINT32 id)
+	{
+		char control[WSA_CMSG_SPACE(sizeof(UINT32))] = {};
+		WSABUF data{ static_cast<ULONG>(len), const_cast<char*>(buf) };
+		WSAMSG msg;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.name = const_cast<::sockaddr*>(&to);
+		msg.namelen = to.len;
+		msg.lpBuffers = &data;
+		msg.dwBufferCount = 1;
+		msg.Control = WSABUF{ sizeof(control), control };
+
+		WSACMSGHDR* c = WSA_CMSG_FIRSTHDR(&msg);
+		c->cmsg_len = WSA_CMSG_LEN(sizeof(id));
+		c->cmsg_level = SOL_SOCKET;
+		c->cmsg_type = SO_TIMESTAMP_ID;
+		memcpy(WSA_CMSG_DATA(c), &id, sizeof(id));
+
+		DWORD sent = 0;
+		if (SOCKET_ERROR == ::WSASendMsg(s, &msg, 0, &sent, nullptr, nullptr)) {
+			return SOCKET_ERROR;
+		}
+
+		return static_cast<int>(sent);
+	}
+	/// Transmit timestamp of the datagram sent with id. Fails with WSAEWOULDBLOCK until it is available.
+	inline int sent(::SOCKET s, UINT32 id, uint64_t& tx)
+	{
+		DWORD len = 0;
+
+		return ::WSAIoctl(s, SIO_GET_TX_TIMESTAMP, &id, sizeof(id), &tx, sizeof(tx), &len, nullptr, nullptr);
+	}
+
+	/// <summary>
+	/// Histogram of delays in nanoseconds with 8 linear buckets per power of two.
+	/// </summary>
+	/// <remarks>
+	/// Relative error is under 12.5% and recording is a few instructions so it can run
+	/// on every datagram. Feed it <c>ns(now() - rx)</c> to see kernel to user delay.
+	/// </remarks>
+	class histogram {
+		static constexpr unsigned sub = 3; // log2 of buckets per power of two
+		static constexpr unsigned buckets = (64 - sub) << sub;
+		uint64_t counts[buckets + (1 << sub)];
+		uint64_t total, max_;
+
+		static unsigned bucket(uint64_t v)
+		{
+			if (v < (1u << sub)) {
+				return static_cast<unsigned>(v);
+			}
+			unsigned e = static_cast<unsigned>(std::bit_width(v)) - 1; // v in [2^e, 2^(e+1))
+			unsigned m = static_cast<unsigned>(v >> (e - sub)) & ((1u << sub) - 1);
+
+			return ((e - sub + 1) << sub) + m;
+		}
+		// smallest value in bucket b
+		static uint64_t lower(unsigned b)
+		{
+			if (b < (1u << sub)) {
+				return b;
+			}
+			unsigned e = (b >> sub) + sub - 1;
+			uint64_t m = b & ((1u << sub) - 1);
+
+			return (uint64_t(1) << e) + (m << (e - sub));
+		}
+	public:
+		histogram()
+			: counts{}, total(0), max_(0)
+		{ }
+
+		void add(uint64_t ns)
+		{
+			++counts[bucket(ns)];
+			++total;
+			if (ns > max_) {
+				max_ = ns;
+			}
+		}
+		void add(double ns)
+		{
+			add(ns > 0 ? static_cast<uint64_t>(ns) : uint64_t(0));
+		}
+		// combine with a histogram recorded elsewhere, e.g. on another thread
+		histogram& operator+=(const histogram& h)
+		{
+			for (unsigned b = 0; b < sizeof(counts) / sizeof(counts[0]); ++b) {
+				counts[b] += h.counts[b];
+			}
+			total += h.total;
+			if (h.max_ > max_) {
+				max_ = h.max_;
+			}
+
+			return *this;
+		}
+
+		uint64_t count() const
+		{
+			return total;
+		}
+		uint64_t max() const
+		{
+			return max_;
+		}
+		/// Lower bound of the bucket holding quantile q.
+		uint64_t quantile(double q) const
+		{
+			uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total));
+			uint64_t n = 0;
+
+			for (unsigned b = 0; b < sizeof(counts) / sizeof(counts[0]); ++b) {
+				n += counts[b];
+				if (n > rank) {
+					return lower(b);
+				}
+			}
+
+			return max_;
+		}
+		/// Print quantiles and the nonempty buckets.
+		void print(const char* name, FILE* out = stdout) const
+		{
+			fprintf(out, "%s: %llu samples p50 %llu p99 %llu p99.9 %llu max %llu ns\n", name,
+				total, quantile(0.5), quantile(0.99), quantile(0.999), max_);
+			for (unsigned b = 0; b < sizeof(counts) / sizeof(counts[0]); ++b) {
+				if (counts[b]) {
+					fprintf(out, "%12llu ns %12llu\n", lower(b), counts[b]);
+				}
+			}
+		}
+	};
+
+}
@@ -0,0 +1,65 @@
+// winsock_timestamp.t.cpp - test packet timestamps and the delay histogram
+#include <cassert>
+#include "winsock_timestamp.h"
+
+using namespace winsock;
+
+int test_histogram()
+{
+	timestamp::histogram h;
+	assert(0 == h.count());
+
+	for (uint64_t v = 0; v < 1000; ++v) {
+		h.add(v);
+	}
+	assert(1000 == h.count());
+	assert(999 == h.max());
+	uint64_t p50 = h.quantile(0.5);
+	assert(p50 <= 500 && p50 >= 500 - 500 / 8);
+
+	// bucket lower bound within 1/8 of the value
+	for (uint64_t v = 1; v < (uint64_t(1) << 40); v = 3 * v + 1) {
+		timestamp::histogram k;
+		k.add(v);
+		assert(k.quantile(0) <= v && v - k.quantile(0) <= v / 8);
+	}
+
+	return 0;
+}
+int test_histogram_ = test_histogram();
+
+int test_timestamp()
+{
+	winsock::sockaddr<> sa(inaddr<>::loopback, 6802);
+	udp::server::socket<> r(sa);
+	udp::client::socket<> s;
+
+	// software timestamps on loopback where the stack supports them
+	bool rx = 0 == timestamp::enable(r, true);
+	bool tx = 0 == timestamp::enable(s, false, 4);
+
+	uint64_t t0 = timestamp::now();
+	assert(3 == timestamp::sendto(s, sa, "abc", 3, 1));
+
+	char buf[16];
+	buffer_view<char> b{ buf, sizeof(buf) };
+	winsock::sockaddr<> from;
+	uint64_t stamp;
+	assert(3 == timestamp::recvfrom(r, b, from, stamp));
+	assert(3 == b.len && 0 == strncmp(buf, "abc", 3));
+	uint64_t t1 = timestamp::now();
+	if (rx && stamp) {
+		assert(t0 <= stamp && stamp <= t1);
+		timestamp::histogram h;
+		h.add(timestamp::ns(t1 - stamp));
+		assert(1 == h.count());
+	}
+
+	uint64_t sent = 0;
+	if (tx && 0 == timestamp::sent(s, 1, sent)) {
+		assert(t0 <= sent && sent <= t1);
+	}
+
+	return 0;
+}
+int test_timestamp_ = test_timestamp();
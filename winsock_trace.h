@@ -0,0 +1,232 @@
+// winsock_trace.h - socket call tracing with Chrome trace export
+#pragma once
+#include <winsock2.h>
+#include <intrin.h>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace winsock::trace {
+
+	/// Traced socket calls.
+	enum class OP : uint8_t {
+		ACCEPT,
+		CONNECT,
+		SEND,
+		RECV,
+		SENDTO,
+		RECVFROM,
+	};
+	inline const char* name(OP op)
+	{
+		static const char* names[] = { "accept", "connect", "send", "recv", "sendto", "recvfrom" };
+
+		return names[static_cast<size_t>(op)];
+	}
+
+	// one completed call
+	struct event {
+		uint64_t begin, end; // TSC
+		uint64_t socket;
+		int64_t result;      // bytes, new socket, or SOCKET_ERROR
+		OP op;
+		DWORD tid;           // set by the ring, fits in what would be padding
+	};
+
+	/// <summary>
+	/// Fixed size ring of events written by one thread.
+	/// </summary>
+	/// <remarks>
+	/// Only the owning thread writes so recording is a store and a release increment.
+	/// Events are stamped with the owner's thread id, so a ring handed on to another thread
+	/// keeps the history of the one before until it is overwritten.
+	/// When the ring is full the oldest events are overwritten. Events being overwritten
+	/// while a dump reads them can be torn, so dump when the threads are quiet.
+	/// </remarks>
+	class ring {
+	public:
+		static constexpr size_t capacity = 1 << 16;
+	private:
+		std::unique_ptr<event[]> events;
+		std::atomic<uint64_t> head; // events ever recorded
+	public:
+		DWORD tid; // owner
+
+		ring()
+			: events(new event[capacity]), head(0), tid(::GetCurrentThreadId())
+		{ }
+		ring(const ring&) = delete;
+		ring& operator=(const ring&) = delete;
+
+		void push(const event& e)
+		{
+			uint64_t h = head.load(std::memory_order_relaxed);
+			event& x = events[h & (capacity - 1)];
+			x = e;
+			x.tid = tid;
+			head.store(h + 1, std::memory_order_release);
+		}
+		// call f on the retained events, oldest first
+		template<class F>
+		void for_each(F f) const
+		{
+			uint64_t h = head.load(std::memory_order_acquire);
+			for (uint64_t i = h > capacity ? h - capacity : 0; i < h; ++i) {
+				f(events[i & (capacity - 1)]);
+			}
+		}
+		uint64_t size() const
+		{
+			return head.load(std::memory_order_acquire);
+		}
+	};
+
+	/// <summary>
+	/// All thread rings. Threads register once on their first event.
+	/// </summary>
+	/// <remarks>
+	/// A thread's ring goes on a free list when it exits and the next new thread records
+	/// into it, so with a thread per connection there are only as many rings as threads
+	/// running at once.
+	/// </remarks>
+	class registry {
+		std::mutex lock;
+		std::vector<std::unique_ptr<ring>> rings;
+		std::vector<ring*> unused; // of threads that have exited
+		uint64_t tsc0;
+		LARGE_INTEGER qpc0;
+	public:
+		registry()
+			: tsc0(__rdtsc())
+		{
+			::QueryPerformanceCounter(&qpc0);
+		}
+		static registry& instance()
+		{
+			static registry r;
+
+			return r;
+		}
+
+		ring& local()
+		{
+			// gives the ring back when the thread exits
+			struct owner {
+				registry* reg = nullptr;
+				ring* r = nullptr;
+				~owner()
+				{
+					if (r) {
+						std::lock_guard<std::mutex> guard(reg->lock);
+						reg->unused.push_back(r);
+					}
+				}
+			};
+			thread_local owner o;
+
+			if (!o.r) {
+				std::lock_guard<std::mutex> guard(lock);
+				if (unused.empty()) {
+					rings.emplace_back(new ring);
+					o.r = rings.back().get();
+				}
+				else {
+					o.r = unused.back();
+					unused.pop_back();
+					o.r->tid = ::GetCurrentThreadId();
+				}
+				o.reg = this;
+			}
+
+			return *o.r;
+		}
+
+		/// <summary>
+		/// Write all retained events in Chrome trace event format.
+		/// </summary>
+		/// Load the file in chrome://tracing or https://ui.perfetto.dev.
+		void write(std::ostream& os)
+		{
+			// calibrate TSC ticks against the performance counter since startup
+			LARGE_INTEGER qpc1, freq;
+			uint64_t tsc1 = __rdtsc();
+			::QueryPerformanceCounter(&qpc1);
+			::QueryPerformanceFrequency(&freq);
+			double secs = static_cast<double>(qpc1.QuadPart - qpc0.QuadPart) / static_cast<double>(freq.QuadPart);
+			double us_per_tick = tsc1 > tsc0 && secs > 0 ? secs * 1e6 / static_cast<double>(tsc1 - tsc0) : 0;
+			DWORD pid = ::GetCurrentProcessId();
+			bool first = true;
+
+			std::lock_guard<std::mutex> guard(lock);
+			os << "{\"traceEvents\":[";
+			for (const auto& r : rings) {
+				r->for_each([&](const event& e) {
+					os << (first ? "\n" : ",\n");
+					first = false;
+					os << "{\"name\":\"" << name(e.op) << "\",\"cat\":\"socket\",\"ph\":\"X\""
+						<< ",\"ts\":" << static_cast<double>(e.begin > tsc0 ? e.begin - tsc0 : 0) * us_per_tick
+						<< ",\"dur\":" << static_cast<double>(e.end - e.begin) * us_per_tick
+						<< ",\"pid\":" << pid << ",\"tid\":" << e.tid
+						<< ",\"args\":{\"socket\":" << e.socket << ",\"result\":" << e.result << "}}";
+				});
+			}
+			os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+		}
+		bool dump(const char* path)
+		{
+			std::ofstream os(path);
+			write(os);
+
+			return static_cast<bool>(os);
+		}
+	};
+
+	/// Record the duration and result of one call.
+	class recording_span {
+		uint64_t begin;
+		uint64_t socket;
+		OP op;
+	public:
+		recording_span(OP _op, ::SOCKET s)
+			: begin(0), socket(static_cast<uint64_t>(s)), op(_op)
+		{
+			registry::instance(); // the first span must not start before tsc0
+			begin = __rdtsc();
+		}
+		template<class R>
+		R operator()(R result)
+		{
+			int err = ::WSAGetLastError(); // callers check it after the call
+			registry::instance().local().push(event{ begin, __rdtsc(), socket, static_cast<int64_t>(result), op });
+			::WSASetLastError(err);
+
+			return result;
+		}
+	};
+	/// Compiled out.
+	struct null_span {
+		null_span(OP, ::SOCKET)
+		{ }
+		template<class R>
+		R operator()(R result)
+		{
+			return result;
+		}
+	};
+
+	/// <summary>
+	/// What <c>socket</c> uses to trace its calls.
+	/// </summary>
+	/// Define WINSOCK_TRACE for the whole project to record every accept, connect, send,
+	/// and recv. It must be the same in every translation unit.
+#ifdef WINSOCK_TRACE
+	using span = recording_span;
+#else
+	using span = null_span;
+#endif
+
+}
@@ -0,0 +1,59 @@
+// winsock_trace.t.cpp - test socket call tracing
+#include <cassert>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "winsock_trace.h"
+
+using namespace winsock;
+
+int test_trace()
+{
+	auto& r = trace::registry::instance();
+	uint64_t n = r.local().size();
+
+	trace::recording_span t(trace::OP::SEND, 42);
+	assert(3 == t(3));
+	assert(n + 1 == r.local().size());
+
+	// another thread gets its own ring
+	trace::ring* used = nullptr;
+	std::thread([&used, &r]() {
+		trace::recording_span u(trace::OP::RECV, 43);
+		u(SOCKET_ERROR);
+		used = &r.local();
+	}).join();
+	assert(used != &r.local());
+	// which the next thread reuses once it has exited
+	std::thread([&used, &r]() {
+		assert(used == &r.local());
+	}).join();
+
+	std::ostringstream os;
+	r.write(os);
+	std::string json = os.str();
+	assert(0 == json.find("{\"traceEvents\":["));
+	assert(std::string::npos != json.find("\"name\":\"send\""));
+	assert(std::string::npos != json.find("\"args\":{\"socket\":42,\"result\":3}"));
+	assert(std::string::npos != json.find("\"args\":{\"socket\":43,\"result\":-1}"));
+
+	// compiled out
+	trace::null_span z(trace::OP::ACCEPT, 44);
+	assert(5 == z(5));
+
+	// oldest events are overwritten
+	trace::ring ring;
+	for (uint64_t i = 0; i < trace::ring::capacity + 10; ++i) {
+		ring.push(trace::event{ i, i, 0, 0, trace::OP::SEND });
+	}
+	uint64_t first = ~0ull, count = 0;
+	ring.for_each([&](const trace::event& e) {
+		if (0 == count++) {
+			first = e.begin;
+		}
+	});
+	assert(10 == first && trace::ring::capacity == count);
+
+	return 0;
+}
+int test_trace_ = test_trace();
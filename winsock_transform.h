@@ -0,0 +1,469 @@
+// winsock_transform.h - compress and checksum stages between buffers and sockets
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "winsock_crc.h"
+#include "winsock_socket.h"
+
+namespace winsock::transform {
+
+	/// <summary>
+	/// One step of a pipeline mapping a chunk to another chunk.
+	/// </summary>
+	/// <remarks>
+	/// <c>decode</c> is the inverse of <c>encode</c>. Both return the bytes written to
+	/// <c>out</c> or -1 if the input can not be transformed, e.g. a bad checksum.
+	/// <c>bound</c> is the largest encoding of <c>len</c> bytes.
+	/// </remarks>
+	struct stage {
+		virtual ~stage()
+		{ }
+		virtual int bound(int len) const = 0;
+		virtual int encode(buffer_view<const char> in, buffer_view<char> out) = 0;
+		virtual int decode(buffer_view<const char> in, buffer_view<char> out) = 0;
+	};
+
+	/// <summary>
+	/// Stages applied in order to each chunk sent and in reverse to each chunk received.
+	/// </summary>
+	/// <remarks>
+	/// Chunks are at most <c>chunk</c> bytes. Each stage writes into one of two scratch
+	/// buffers so a chunk is never copied other than by the stages themselves.
+	/// The views returned are valid until the next call.
+	/// </remarks>
+	class pipeline {
+		std::vector<std::unique_ptr<stage>> stages;
+		std::vector<char> scratch[3]; // two for stages, one for received frames
+		int chunk_;
+		int size; // bound of a chunk through every stage
+
+		buffer_view<char> other(const char* p)
+		{
+			char* q = scratch[0].data();
+
+			return buffer_view<char>{ p == q ? scratch[1].data() : q, size };
+		}
+	public:
+		pipeline(int chunk = 0x10000)
+			: chunk_(chunk), size(chunk)
+		{
+			for (auto& b : scratch) {
+				b.resize(size);
+			}
+		}
+		pipeline(const pipeline&) = delete;
+		pipeline& operator=(const pipeline&) = delete;
+
+		/// Append a stage and return it, e.g. to read its counters.
+		template<class S, class... Args>
+		S& add(Args&&... args)
+		{
+			S* s = new S(std::forward<Args>(args)...);
+			stages.emplace_back(s);
+			size = s->bound(size);
+			for (auto& b : scratch) {
+				b.resize(size);
+			}
+
+			return *s;
+		}
+
+		// largest chunk accepted by encode
+		int chunk() const
+		{
+			return chunk_;
+		}
+		// largest chunk produced by encode
+		int bound() const
+		{
+			return size;
+		}
+
+		/// Encode a chunk of at most chunk() bytes. Returns out.len or -1.
+		int encode(buffer_view<const char> in, buffer_view<const char>& out)
+		{
+			out = in;
+			for (auto& s : stages) {
+				buffer_view<char> dst = other(out.buf);
+				int n = s->encode(out, dst);
+				if (n < 0) {
+					return -1;
+				}
+				out = buffer_view<const char>{ dst.buf, n };
+			}
+
+			return out.len;
+		}
+		/// Decode a chunk produced by encode. Returns out.len or -1.
+		int decode(buffer_view<const char> in, buffer_view<const char>& out)
+		{
+			out = in;
+			for (auto i = stages.rbegin(); i != stages.rend(); ++i) {
+				buffer_view<char> dst = other(out.buf);
+				int n = (*i)->decode(out, dst);
+				if (n < 0) {
+					return -1;
+				}
+				out = buffer_view<const char>{ dst.buf, n };
+			}
+
+			return out.len;
+		}
+
+		/// Buffer of len bytes to receive an encoded chunk into, len at most bound().
+		buffer_view<char> input(int len)
+		{
+			return buffer_view<char>{ scratch[2].data(), len };
+		}
+	};
+
+	/// <summary>
+	/// Send len bytes through the pipeline as frames of at most p.chunk() bytes.
+	/// </summary>
+	/// <returns>len or SOCKET_ERROR</returns>
+	/// Each frame is a 4 byte length followed by the encoded chunk, sent with one call.
+	inline int send(::SOCKET s, pipeline& p, const char* buf, int len)
+	{
+		for (int off = 0; off < len; ) {
+			int n = std::min(len - off, p.chunk());
+			buffer_view<const char> out;
+			if (p.encode(buffer_view<const char>{ buf + off, n }, out) < 0) {
+				::WSASetLastError(WSAEINVAL);
+				return SOCKET_ERROR;
+			}
+			uint32_t m = static_cast<uint32_t>(out.len);
+			WSABUF data[2] = {
+				{ sizeof(m), reinterpret_cast<char*>(&m) },
+				{ static_cast<ULONG>(out.len), const_cast<char*>(out.buf) },
+			};
+			DWORD sent = 0;
+			if (SOCKET_ERROR == ::WSASend(s, data, 2, &sent, 0, nullptr, nullptr)) {
+				return SOCKET_ERROR;
+			}
+			off += n;
+		}
+
+		return len;
+	}
+	/// <summary>
+	/// Receive and decode one frame.
+	/// </summary>
+	/// <returns>decoded bytes, 0 when the peer has closed, or SOCKET_ERROR</returns>
+	/// A frame that fails to decode is an error with WSAEINVAL.
+	inline int recv(::SOCKET s, pipeline& p, buffer_view<const char>& out)
+	{
+		uint32_t m;
+		int ret = ::recv(s, reinterpret_cast<char*>(&m), sizeof(m), MSG_WAITALL);
+		if (ret <= 0) {
+			return ret;
+		}
+		if (ret != sizeof(m) || m > static_cast<uint32_t>(p.bound())) {
+			::WSASetLastError(WSAEINVAL);
+			return SOCKET_ERROR;
+		}
+		buffer_view<char> in = p.input(static_cast<int>(m));
+		if (in.len > 0 && in.len != (ret = ::recv(s, in.buf, in.len, MSG_WAITALL))) {
+			// closed in the middle of a frame
+			if (ret != SOCKET_ERROR) {
+				::WSASetLastError(WSAECONNRESET);
+			}
+			return SOCKET_ERROR;
+		}
+		if (p.decode(buffer_view<const char>{ in.buf, in.len }, out) < 0) {
+			::WSASetLastError(WSAEINVAL);
+			return SOCKET_ERROR;
+		}
+
+		return out.len;
+	}
+
+	/// <summary>
+	/// Fast LZ77 compression in the style of LZ4 with no external dependency.
+	/// </summary>
+	/// <remarks>
+	/// Sequences are a token with 4 bit literal and match lengths, the literals, and a
+	/// 2 byte offset of a match of at least 4 bytes. The last sequence has only literals.
+	/// Positions are found with a 4096 entry hash table of 4 byte prefixes and the search
+	/// steps faster through data that does not match.
+	/// </remarks>
+	namespace lz {
+
+		constexpr int min_match = 4;
+		constexpr int max_offset = 0xFFFF;
+
+		// worst case size of len incompressible bytes
+		constexpr int bound(int len)
+		{
+			return len + len / 255 + 16;
+		}
+
+		inline uint32_t read32(const uint8_t* p)
+		{
+			uint32_t v;
+			memcpy(&v, p, sizeof(v));
+
+			return v;
+		}
+
+		/// <summary>
+		/// Compress [src, src + n) into dst.
+		/// </summary>
+		/// <returns>compressed size or -1 if it would not fit in cap bytes</returns>
+		inline int compress(const char* _src, int n, char* _dst, int cap)
+		{
+			constexpr int hash_bits = 12;
+			int table[1 << hash_bits];
+			const uint8_t* src = reinterpret_cast<const uint8_t*>(_src);
+			uint8_t* dst = reinterpret_cast<uint8_t*>(_dst);
+			int ip = 0, anchor = 0, op = 0;
+			unsigned misses = 0;
+
+			// token, extended lengths, literals, and offset must fit
+			auto emit = [&](int lit, int off, int mlen) {
+				if (op + 1 + lit + lit / 255 + 1 + 2 + mlen / 255 + 1 > cap) {
+					return false;
+				}
+				uint8_t* token = dst + op++;
+				auto length = [&](int len, int shift) {
+					if (len >= 15) {
+						*token |= static_cast<uint8_t>(15 << shift);
+						for (len -= 15; len >= 255; len -= 255) {
+							dst[op++] = 255;
+						}
+						dst[op++] = static_cast<uint8_t>(len);
+					}
+					else {
+						*token |= static_cast<uint8_t>(len << shift);
+					}
+				};
+				*token = 0;
+				length(lit, 4);
+				memcpy(dst + op, src + anchor, lit);
+				op += lit;
+				if (mlen) {
+					dst[op++] = static_cast<uint8_t>(off);
+					dst[op++] = static_cast<uint8_t>(off >> 8);
+					length(mlen - min_match, 0);
+				}
+
+				return true;
+			};
+
+			for (auto& t : table) {
+				t = -1;
+			}
+			while (ip + min_match <= n) {
+				uint32_t v = read32(src + ip);
+				uint32_t h = (v * 2654435761u) >> (32 - hash_bits);
+				int ref = table[h];
+				table[h] = ip;
+				if (ref >= 0 && ip - ref <= max_offset && read32(src + ref) == v) {
+					int mlen = min_match;
+					while (ip + mlen < n && src[ref + mlen] == src[ip + mlen]) {
+						++mlen;
+					}
+					if (!emit(ip - anchor, ip - ref, mlen)) {
+						return -1;
+					}
+					ip += mlen;
+					anchor = ip;
+					misses = 0;
+				}
+				else {
+					ip += 1 + static_cast<int>(misses++ >> 5); // skip ahead in data that does not compress
+				}
+			}
+			if (!emit(n - anchor, 0, 0)) {
+				return -1;
+			}
+
+			return op;
+		}
+
+		/// <summary>
+		/// Decompress [src, src + n) into dst.
+		/// </summary>
+		/// <returns>decompressed size or -1 if the input is malformed or does not fit in cap bytes</returns>
+		inline int decompress(const char* _src, int n, char* _dst, int cap)
+		{
+			const uint8_t* src = reinterpret_cast<const uint8_t*>(_src);
+			uint8_t* dst = reinterpret_cast<uint8_t*>(_dst);
+			int ip = 0, op = 0;
+
+			auto length = [&](int len) {
+				if (len == 15) {
+					uint8_t b;
+					do {
+						if (ip >= n) {
+							return -1;
+						}
+						b = src[ip++];
+						len += b;
+					} while (b == 255);
+				}
+
+				return len;
+			};
+
+			while (ip < n) {
+				uint8_t token = src[ip++];
+				int lit = length(token >> 4);
+				if (lit < 0 || lit > n - ip || lit > cap - op) {
+					return -1;
+				}
+				memcpy(dst + op, src + ip, lit);
+				ip += lit;
+				op += lit;
+				if (ip == n) {
+					break; // last sequence
+				}
+				if (n - ip < 2) {
+					return -1;
+				}
+				int off = src[ip] | (src[ip + 1] << 8);
+				ip += 2;
+				int mlen = length(token & 15);
+				if (mlen < 0 || off == 0 || off > op || mlen + min_match > cap - op) {
+					return -1;
+				}
+				mlen += min_match;
+				const uint8_t* ref = dst + op - off;
+				if (off >= mlen) {
+					memcpy(dst + op, ref, mlen);
+				}
+				else {
+					for (int i = 0; i < mlen; ++i) {
+						dst[op + i] = ref[i]; // overlapping copy repeats the pattern
+					}
+				}
+				op += mlen;
+			}
+
+			return op;
+		}
+	}
+
+	/// <summary>
+	/// Compression stage that stores chunks that do not compress.
+	/// </summary>
+	/// <remarks>
+	/// Each chunk starts with a byte telling if it is compressed. A chunk is stored when
+	/// compressing it would save less than 1/32 of its size. After <c>probe</c> stored
+	/// chunks in a row compression is not tried for a while, starting at <c>probe</c>
+	/// chunks and doubling up to 64 times that while the data stays incompressible,
+	/// so encrypted or already compressed data costs little more than a copy.
+	/// </remarks>
+	class compress : public stage {
+		unsigned probe;
+		unsigned stored;  // incompressible chunks in a row
+		unsigned skip;    // chunks left to store without trying
+		unsigned backoff;
+	public:
+		// counters for reporting the ratio
+		uint64_t bytes_in, bytes_out, skipped;
+
+		compress(unsigned _probe = 4)
+			: probe(_probe), stored(0), skip(0), backoff(_probe), bytes_in(0), bytes_out(0), skipped(0)
+		{ }
+
+		double ratio() const
+		{
+			return bytes_out ? static_cast<double>(bytes_in) / static_cast<double>(bytes_out) : 1;
+		}
+
+		int bound(int len) const override
+		{
+			return 1 + lz::bound(len);
+		}
+		int encode(buffer_view<const char> in, buffer_view<char> out) override
+		{
+			int n = -1;
+
+			if (skip) {
+				--skip;
+				++skipped;
+			}
+			else {
+				n = lz::compress(in.buf, in.len, out.buf + 1, in.len - in.len / 32);
+				if (n < 0 && ++stored >= probe) {
+					skip = backoff;
+					backoff = std::min(2 * backoff, 64 * probe);
+					stored = 0;
+				}
+				else if (n >= 0) {
+					stored = 0;
+					backoff = probe;
+				}
+			}
+			if (n < 0) {
+				out.buf[0] = 0;
+				memcpy(out.buf + 1, in.buf, in.len);
+				n = in.len;
+			}
+			else {
+				out.buf[0] = 1;
+			}
+			bytes_in += in.len;
+			bytes_out += 1 + n;
+
+			return 1 + n;
+		}
+		int decode(buffer_view<const char> in, buffer_view<char> out) override
+		{
+			if (in.len < 1) {
+				return -1;
+			}
+			if (0 == in.buf[0]) {
+				if (in.len - 1 > out.len) {
+					return -1;
+				}
+				memcpy(out.buf, in.buf + 1, in.len - 1);
+
+				return in.len - 1;
+			}
+
+			return lz::decompress(in.buf + 1, in.len - 1, out.buf, out.len);
+		}
+	};
+
+	/// Stage appending a CRC-32C to each chunk and checking it on the way in.
+	class checksum : public stage {
+	public:
+		// chunks that failed the check
+		uint64_t errors = 0;
+
+		int bound(int len) const override
+		{
+			return len + 4;
+		}
+		int encode(buffer_view<const char> in, buffer_view<char> out) override
+		{
+			uint32_t crc = crc32c(0, in.buf, in.len);
+			memcpy(out.buf, in.buf, in.len);
+			memcpy(out.buf + in.len, &crc, sizeof(crc));
+
+			return in.len + 4;
+		}
+		int decode(buffer_view<const char> in, buffer_view<char> out) override
+		{
+			int n = in.len - 4;
+			uint32_t crc;
+
+			if (n < 0 || n > out.len) {
+				return -1;
+			}
+			memcpy(&crc, in.buf + n, sizeof(crc));
+			if (crc != crc32c(0, in.buf, n)) {
+				++errors;
+				return -1;
+			}
+			memcpy(out.buf, in.buf, n);
+
+			return n;
+		}
+	};
+
+}
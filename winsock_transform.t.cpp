@@ -0,0 +1,111 @@
+// winsock_transform.t.cpp - test compress and checksum stages
+#include <cassert>
+#include <string>
+#include <thread>
+#include "winsock_transform.h"
+
+using namespace winsock;
+
+int test_lz()
+{
+	std::string s;
+	for (int i = 0; i < 1000; ++i) {
+		s += "the quick brown fox ";
+	}
+	int n = static_cast<int>(s.size());
+	std::vector<char> c(transform::lz::bound(n)), d(n);
+
+	int m = transform::lz::compress(s.data(), n, c.data(), static_cast<int>(c.size()));
+	assert(0 < m && m < n / 10);
+	assert(n == transform::lz::decompress(c.data(), m, d.data(), n));
+	assert(0 == memcmp(s.data(), d.data(), n));
+	// does not fit
+	assert(-1 == transform::lz::compress(s.data(), n, c.data(), 8));
+	assert(-1 == transform::lz::decompress(c.data(), m, d.data(), n - 1));
+	// offset before the start
+	const char bad[] = { 0x10, 'a', 0x05, 0x00 };
+	assert(-1 == transform::lz::decompress(bad, sizeof(bad), d.data(), n));
+
+	assert(0xE3069283 == crc32c(0, "123456789", 9));
+
+	return 0;
+}
+int test_lz_ = test_lz();
+
+int test_pipeline()
+{
+	transform::pipeline p(0x1000);
+	auto& z = p.add<transform::compress>(2);
+	auto& ck = p.add<transform::checksum>();
+
+	std::string text(0x1000, 'a');
+	buffer_view<const char> out, back;
+	assert(0 < p.encode(buffer_view<const char>{ text.data(), 0x1000 }, out));
+	assert(out.len < 100);
+	std::string wire(out.buf, out.len);
+	buffer_view<char> in = p.input(out.len);
+	memcpy(in.buf, wire.data(), wire.size());
+	assert(0x1000 == p.decode(buffer_view<const char>{ in.buf, in.len }, back));
+	assert(0 == memcmp(back.buf, text.data(), 0x1000));
+
+	// corrupted chunk fails the checksum
+	wire[3] ^= 1;
+	memcpy(in.buf, wire.data(), wire.size());
+	assert(-1 == p.decode(buffer_view<const char>{ in.buf, in.len }, back));
+	assert(1 == ck.errors);
+
+	// incompressible chunks are stored, then compression is skipped
+	std::string noise(0x1000, 0);
+	uint32_t x = 1;
+	for (auto& c : noise) {
+		x = x * 1664525 + 1013904223;
+		c = static_cast<char>(x >> 24);
+	}
+	for (int i = 0; i < 4; ++i) {
+		assert(0x1000 + 1 + 4 == p.encode(buffer_view<const char>{ noise.data(), 0x1000 }, out));
+	}
+	assert(2 == z.skipped);
+
+	// no stages, frames are received into scratch as they are
+	transform::pipeline none(16);
+	assert(16 == none.bound() && nullptr != none.input(16).buf);
+
+	return 0;
+}
+int test_pipeline_ = test_pipeline();
+
+int test_transform_socket()
+{
+	tcp::server::socket<> srv("localhost", "6806");
+	srv.listen();
+	tcp::client::socket<> cli("localhost", "6806");
+	winsock::socket<> s = srv.accept();
+
+	std::string text;
+	for (int i = 0; i < 10000; ++i) {
+		text += std::to_string(i);
+	}
+	int n = static_cast<int>(text.size());
+
+	std::thread sender([&]() {
+		transform::pipeline p(0x4000);
+		p.add<transform::compress>();
+		p.add<transform::checksum>();
+		assert(n == transform::send(cli, p, text.data(), n));
+		::shutdown(cli, SD_SEND);
+	});
+
+	transform::pipeline p(0x4000);
+	p.add<transform::compress>();
+	p.add<transform::checksum>();
+	std::string got;
+	buffer_view<const char> chunk;
+	while (0 < transform::recv(s, p, chunk)) {
+		got.append(chunk.buf, chunk.len);
+	}
+	sender.join();
+	assert(got == text);
+
+	return 0;
+}
+int test_transform_socket_ = test_transform_socket();
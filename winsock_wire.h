@@ -0,0 +1,286 @@
+// winsock_wire.h - binary message encoding in place in buffer memory
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include "winsock_buffer.h"
+
+namespace winsock::wire {
+
+	// numbers and enums stored as their bytes
+	template<class T>
+	concept scalar = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+	template<size_t N> struct uint_of { };
+	template<> struct uint_of<1> { typedef uint8_t type; };
+	template<> struct uint_of<2> { typedef uint16_t type; };
+	template<> struct uint_of<4> { typedef uint32_t type; };
+	template<> struct uint_of<8> { typedef uint64_t type; };
+
+	/// Store v at p with byte order E. p need not be aligned.
+	template<std::endian E, scalar T>
+	inline void store(char* p, T v)
+	{
+		using U = typename uint_of<sizeof(T)>::type;
+		U u = std::bit_cast<U>(v);
+
+		if constexpr (E != std::endian::native && sizeof(T) > 1) {
+			u = std::byteswap(u);
+		}
+		memcpy(p, &u, sizeof(u));
+	}
+	/// Load a T stored at p with byte order E.
+	template<std::endian E, scalar T>
+	inline T load(const char* p)
+	{
+		using U = typename uint_of<sizeof(T)>::type;
+		U u;
+
+		memcpy(&u, p, sizeof(u));
+		if constexpr (E != std::endian::native && sizeof(T) > 1) {
+			u = std::byteswap(u);
+		}
+
+		return std::bit_cast<T>(u);
+	}
+
+	/// <summary>
+	/// Field of type T at a fixed offset in a message, read and written in place.
+	/// </summary>
+	/// <remarks>
+	/// Describe a fixed layout once and access single fields of a received message
+	/// without decoding the rest:
+	/// <code>
+	/// using id = field&lt;uint64_t, 0&gt;;
+	/// using px = field&lt;double, after&lt;id&gt;&gt;;
+	/// double p = px::get(msg.buf);
+	/// </code>
+	/// The caller checks the message is at least <c>end</c> bytes of the last field.
+	/// </remarks>
+	template<scalar T, size_t Off, std::endian E = std::endian::little>
+	struct field {
+		using type = T;
+		static constexpr size_t offset = Off;
+		static constexpr size_t end = Off + sizeof(T);
+
+		static T get(const char* msg)
+		{
+			return load<E, T>(msg + Off);
+		}
+		static void set(char* msg, T v)
+		{
+			store<E>(msg + Off, v);
+		}
+	};
+	// offset following field F
+	template<class F>
+	constexpr size_t after = F::end;
+
+	/// <summary>
+	/// Encode fields one after another straight into buffer memory.
+	/// </summary>
+	/// <remarks>
+	/// Numbers are stored with byte order E. Strings and byte arrays are prefixed with
+	/// their length as a LEB128 varint. Writing past the end of the buffer writes nothing
+	/// and makes <c>ok</c> false, so a message can be encoded without checking each field.
+	/// </remarks>
+	template<std::endian E = std::endian::little>
+	class writer {
+		char* buf;
+		size_t cap, len;
+		bool overflow;
+
+		char* take(size_t n)
+		{
+			if (overflow || cap - len < n) {
+				overflow = true;
+				return nullptr;
+			}
+			char* p = buf + len;
+			len += n;
+
+			return p;
+		}
+	public:
+		writer(buffer_view<char> b)
+			: buf(b.buf), cap(static_cast<size_t>(b.len)), len(0), overflow(false)
+		{ }
+
+		template<scalar T>
+		writer& put(T v)
+		{
+			if (char* p = take(sizeof(T))) {
+				store<E>(p, v);
+			}
+
+			return *this;
+		}
+		writer& varint(uint64_t v)
+		{
+			char tmp[10];
+			size_t n = 0;
+
+			do {
+				tmp[n++] = static_cast<char>((v & 0x7F) | (v > 0x7F ? 0x80 : 0));
+				v >>= 7;
+			} while (v);
+
+			return bytes(tmp, n);
+		}
+		// raw bytes without a length
+		writer& bytes(const void* p, size_t n)
+		{
+			if (char* q = take(n)) {
+				memcpy(q, p, n);
+			}
+
+			return *this;
+		}
+		// length prefixed bytes
+		writer& string(std::string_view s)
+		{
+			return varint(s.size()).bytes(s.data(), s.size());
+		}
+
+		/// Leave room for a T filled in later with <c>put_at</c>, e.g. a length. Returns its offset.
+		template<scalar T>
+		size_t skip()
+		{
+			size_t off = len;
+			take(sizeof(T));
+
+			return off;
+		}
+		template<scalar T>
+		void put_at(size_t off, T v)
+		{
+			if (off + sizeof(T) <= len) {
+				store<E>(buf + off, v);
+			}
+		}
+
+		bool ok() const
+		{
+			return !overflow;
+		}
+		size_t size() const
+		{
+			return len;
+		}
+		// encoded bytes to send
+		buffer_view<const char> view() const
+		{
+			return buffer_view<const char>{ buf, static_cast<int>(len) };
+		}
+		void reset()
+		{
+			len = 0;
+			overflow = false;
+		}
+	};
+
+	/// <summary>
+	/// Decode fields written by <c>writer</c> in place in a received buffer.
+	/// </summary>
+	/// <remarks>
+	/// Strings are returned as views into the buffer. Reading past the end returns zeros
+	/// and empty strings and makes <c>ok</c> false.
+	/// </remarks>
+	template<std::endian E = std::endian::little>
+	class reader {
+		const char* buf;
+		size_t len, off;
+		bool underflow;
+
+		const char* take(size_t n)
+		{
+			if (underflow || len - off < n) {
+				underflow = true;
+				return nullptr;
+			}
+			const char* p = buf + off;
+			off += n;
+
+			return p;
+		}
+	public:
+		reader(buffer_view<const char> b)
+			: buf(b.buf), len(static_cast<size_t>(b.len)), off(0), underflow(false)
+		{ }
+		reader(const char* b, size_t n)
+			: buf(b), len(n), off(0), underflow(false)
+		{ }
+
+		template<scalar T>
+		T get()
+		{
+			const char* p = take(sizeof(T));
+
+			return p ? load<E, T>(p) : T{};
+		}
+		uint64_t varint()
+		{
+			uint64_t v = 0;
+
+			for (unsigned shift = 0; shift < 64; shift += 7) {
+				const char* p = take(1);
+				if (!p) {
+					return 0;
+				}
+				uint8_t b = static_cast<uint8_t>(*p);
+				v |= static_cast<uint64_t>(b & 0x7F) << shift;
+				if (!(b & 0x80)) {
+					return v;
+				}
+			}
+			underflow = true; // too long
+
+			return 0;
+		}
+		std::string_view bytes(size_t n)
+		{
+			const char* p = take(n);
+
+			return p ? std::string_view(p, n) : std::string_view{};
+		}
+		std::string_view string()
+		{
+			uint64_t n = varint();
+			if (n > len - off) {
+				underflow = true;
+				return {};
+			}
+
+			return bytes(static_cast<size_t>(n));
+		}
+
+		bool ok() const
+		{
+			return !underflow;
+		}
+		size_t offset() const
+		{
+			return off;
+		}
+		size_t remaining() const
+		{
+			return len - off;
+		}
+		void seek(size_t _off)
+		{
+			if (_off > len) {
+				underflow = true;
+			}
+			else {
+				off = _off;
+			}
+		}
+	};
+
+	// network byte order
+	using net_writer = writer<std::endian::big>;
+	using net_reader = reader<std::endian::big>;
+
+}
@@ -0,0 +1,63 @@
+// winsock_wire.t.cpp - test binary message encoding
+#include <cassert>
+#include "winsock_wire.h"
+
+using namespace winsock;
+
+enum class side : uint8_t { buy = 1, sell = 2 };
+
+int test_wire()
+{
+	char buf[64];
+	wire::writer<> w(buffer_view<char>{ buf, sizeof(buf) });
+	size_t len = w.skip<uint16_t>();
+	w.put<uint64_t>(0x0102030405060708).put(1.5).put(side::sell).string("MSFT").varint(300);
+	w.put_at(len, static_cast<uint16_t>(w.size()));
+	assert(w.ok());
+	assert(8 == buf[2]); // little endian
+
+	wire::reader<> r(w.view());
+	assert(w.size() == r.get<uint16_t>());
+	assert(0x0102030405060708 == r.get<uint64_t>());
+	assert(1.5 == r.get<double>());
+	assert(side::sell == r.get<side>());
+	std::string_view symbol = r.string();
+	assert("MSFT" == symbol && buf + 20 == symbol.data()); // in place
+	assert(300 == r.varint());
+	assert(r.ok() && 0 == r.remaining());
+	assert(0 == r.get<uint32_t>() && !r.ok());
+
+	// network byte order
+	wire::net_writer nw(buffer_view<char>{ buf, 4 });
+	nw.put<uint32_t>(0x01020304);
+	assert(1 == buf[0] && 4 == buf[3]);
+	nw.put<uint8_t>(5);
+	assert(!nw.ok() && 4 == nw.size());
+	assert(0x01020304 == wire::net_reader(buf, 4).get<uint32_t>());
+
+	// length larger than the message
+	const char bad[] = { 5, 'a' };
+	wire::reader<> br(bad, sizeof(bad));
+	assert(br.string().empty() && !br.ok());
+
+	return 0;
+}
+int test_wire_ = test_wire();
+
+int test_wire_field()
+{
+	using id = wire::field<uint64_t, 0>;
+	using px = wire::field<double, wire::after<id>>;
+	using qty = wire::field<uint32_t, wire::after<px>, std::endian::big>;
+	static_assert(20 == qty::end);
+
+	char msg[qty::end];
+	id::set(msg, 7);
+	px::set(msg, 2.5);
+	qty::set(msg, 0x0A0B0C0D);
+	assert(7 == id::get(msg) && 2.5 == px::get(msg) && 0x0A0B0C0D == qty::get(msg));
+	assert(0x0A == msg[16]);
+
+	return 0;
+}
+int test_wire_field_ = test_wire_field();
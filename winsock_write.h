@@ -0,0 +1,181 @@
+// winsock_write.h - per connection write queue with userspace corking
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "winsock_socket.h"
+
+namespace winsock {
+
+	/// <summary>
+	/// Outbound queue for one connection that coalesces small writes into one vectored send.
+	/// </summary>
+	/// <remarks>
+	/// Writes are copied into fixed size chunks so many small writes share one chunk.
+	/// Each <c>flush</c> hands up to <c>max_iov</c> chunks to a single <c>WSASend</c>.
+	/// Windows has no TCP_CORK or MSG_MORE so corking is done here: while corked nothing is
+	/// sent and <c>uncork</c> flushes. Uncorked queues are flushed by the owner, typically
+	/// from an <c>event_loop::idle</c> handler, and when the socket becomes writable
+	/// after a partial send.
+	/// <c>full</c> reports when more than <c>high_water</c> bytes are queued so producers
+	/// can stop writing until the queue drains.
+	/// </remarks>
+	class write_queue {
+		struct chunk {
+			std::unique_ptr<char[]> data;
+			size_t cap, head, tail; // [head, tail) not yet sent
+		};
+		::SOCKET s;
+		size_t csize; // chunk size
+		size_t high_water;
+		ULONG max_iov;
+		std::deque<chunk> chunks;
+		std::vector<std::unique_ptr<char[]>> spare;
+		std::vector<WSABUF> iov;
+		size_t queued;
+		int corks;
+	public:
+		// counters for measuring coalescing
+		size_t writes, sends, bytes; // sends only counts WSASend calls that succeeded
+
+		write_queue(::SOCKET _s, size_t chunk_size = 0x4000, size_t _high_water = 1 << 20, ULONG _max_iov = 64)
+			: s(_s), csize(chunk_size), high_water(_high_water), max_iov(_max_iov),
+			  queued(0), corks(0), writes(0), sends(0), bytes(0)
+		{
+			iov.reserve(max_iov);
+		}
+		write_queue(const write_queue&) = delete;
+		write_queue& operator=(const write_queue&) = delete;
+		~write_queue()
+		{ }
+
+		// bytes not yet sent
+		size_t pending() const
+		{
+			return queued;
+		}
+		// above the high water mark
+		bool full() const
+		{
+			return queued >= high_water;
+		}
+		bool corked() const
+		{
+			return corks > 0;
+		}
+
+		/// Copy len bytes to the end of the queue. Returns len.
+		int write(const char* buf, int len)
+		{
+			size_t n = static_cast<size_t>(len);
+
+			if (0 == n) {
+				return 0;
+			}
+			++writes;
+			if (chunks.empty() || chunks.back().cap - chunks.back().tail < n) {
+				if (n >= csize) {
+					// large writes get their own chunk
+					chunks.push_back(chunk{ std::unique_ptr<char[]>(new char[n]), n, 0, 0 });
+				}
+				else {
+					chunks.push_back(chunk{ acquire(), csize, 0, 0 });
+				}
+			}
+			chunk& c = chunks.back();
+			memcpy(c.data.get() + c.tail, buf, n);
+			c.tail += n;
+			queued += n;
+
+			return len;
+		}
+		int write(const char* buf)
+		{
+			return write(buf, static_cast<int>(strlen(buf)));
+		}
+		template<class T>
+		int write(buffer<T>& buf)
+		{
+			int len = 0;
+
+			while (const auto b = buf()) {
+				len += write(b.buf, b.len);
+			}
+
+			return len;
+		}
+
+		/// Hold writes until uncork. Corks nest.
+		void cork()
+		{
+			++corks;
+		}
+		/// Release one cork and flush when the last one is released.
+		int uncork()
+		{
+			if (corks > 0 && 0 == --corks) {
+				return flush();
+			}
+
+			return 0;
+		}
+
+		/// Send queued chunks with one WSASend.
+		/// Returns bytes sent, 0 if corked, empty, or the send would block, or SOCKET_ERROR.
+		int flush()
+		{
+			if (corked() || 0 == queued) {
+				return 0;
+			}
+
+			iov.clear();
+			for (auto& c : chunks) {
+				if (iov.size() == max_iov) {
+					break;
+				}
+				iov.push_back(WSABUF{ static_cast<ULONG>(c.tail - c.head), c.data.get() + c.head });
+			}
+
+			DWORD sent = 0;
+			if (SOCKET_ERROR == ::WSASend(s, iov.data(), static_cast<DWORD>(iov.size()), &sent, 0, nullptr, nullptr)) {
+				return WSAEWOULDBLOCK == ::WSAGetLastError() ? 0 : SOCKET_ERROR;
+			}
+			++sends;
+			consume(sent);
+
+			return static_cast<int>(sent);
+		}
+	private:
+		std::unique_ptr<char[]> acquire()
+		{
+			if (spare.empty()) {
+				return std::unique_ptr<char[]>(new char[csize]);
+			}
+			auto p = std::move(spare.back());
+			spare.pop_back();
+
+			return p;
+		}
+		// drop n sent bytes from the front, recycling standard chunks
+		void consume(size_t n)
+		{
+			bytes += n;
+			queued -= n;
+			while (n) {
+				chunk& c = chunks.front();
+				size_t m = std::min(n, c.tail - c.head);
+				c.head += m;
+				n -= m;
+				if (c.head == c.tail) {
+					if (c.cap == csize) {
+						spare.push_back(std::move(c.data));
+					}
+					chunks.pop_front();
+				}
+			}
+		}
+	};
+
+}
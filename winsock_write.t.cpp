@@ -0,0 +1,71 @@
+// winsock_write.t.cpp - test write queue
+#include <cassert>
+#include "winsock_loop.h"
+#include "winsock_write.h"
+
+using namespace winsock;
+
+int test_write_queue()
+{
+	tcp::server::socket<> srv("localhost", "6791");
+	srv.listen();
+	tcp::client::socket<> cli("localhost", "6791");
+	winsock::socket<> t = srv.accept();
+	char buf[64];
+
+	{
+		write_queue q(cli, 16);
+
+		// small writes coalesce
+		q.write("GET ");
+		q.write("/ ");
+		q.write("HTTP/1.1\r\n");
+		assert(16 == q.pending());
+		assert(16 == q.flush());
+		assert(1 == q.sends);
+		assert(3 == q.writes);
+		assert(0 == q.pending());
+		assert(16 == t.recv(buf, 16, RCV_MSG::WAITALL));
+		assert(0 == strncmp("GET / HTTP/1.1\r\n", buf, 16));
+
+		// large writes get their own chunk, still one send
+		q.write("Host: ");
+		q.write("0123456789abcdefghij");
+		assert(26 == q.flush());
+		assert(2 == q.sends);
+		assert(26 == t.recv(buf, 26, RCV_MSG::WAITALL));
+		assert(0 == strncmp("Host: 0123456789abcdefghij", buf, 26));
+	}
+	{
+		write_queue q(cli, 0x1000, 8);
+
+		q.cork();
+		q.cork();
+		q.write("abcd");
+		assert(0 == q.flush());
+		assert(0 == q.uncork());
+		assert(q.corked());
+		q.write("efgh");
+		assert(q.full());
+		assert(8 == q.uncork());
+		assert(!q.full());
+		assert(1 == q.sends);
+		assert(8 == t.recv(buf, 8, RCV_MSG::WAITALL));
+		assert(0 == strncmp("abcdefgh", buf, 8));
+	}
+	{
+		// flush when the loop goes idle
+		event_loop loop;
+		write_queue q(cli);
+
+		loop.idle([&q]() { q.flush(); });
+		q.write("x");
+		q.write("y");
+		loop.run_once(0);
+		assert(1 == q.sends);
+		assert(2 == t.recv(buf, 2, RCV_MSG::WAITALL));
+	}
+
+	return 0;
+}
+int test_write_queue_ = test_write_queue();